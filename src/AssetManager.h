@@ -0,0 +1,184 @@
+#pragma once
+
+//The app's own images and labels, decoded once at startup and kept for as long as the app runs
+//  - images are decoded and labels rendered on a few background threads, all at once (labels one at a time, see FontLock.h)
+//  - the main thread uploads each one as a texture as soon as it is ready (upload(), once a frame)
+//  - texture() waits for an asset that isn't ready yet, so it can be used any time after start()
+//Each asset's decode and upload time is logged once everything is in.
+//
+//  int pause = mAssets.addImage(getResourcePath("PauseButton.jpg"));
+//  mAssets.start(3);
+//  mAssets.upload();                    //each frame
+//  gl::draw(mAssets.texture(pause));
+
+#include "cinder/Cinder.h"
+#include "cinder/Surface.h"
+#include "cinder/ImageIo.h"
+#include "cinder/Text.h"
+#include "cinder/Font.h"
+#include "cinder/Thread.h"
+#include "cinder/gl/Texture.h"
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "Log.h"
+#include "FontLock.h"
+
+class AssetManager {
+public:
+    AssetManager() : nextToDecode(0), started(0), allUploaded(false), startTime(0.0) {}
+
+    //an image file, decoded as it is
+    int addImage(const std::string &path) {
+        Asset asset;
+        asset.path = path;
+        assets.push_back(asset);
+        return assets.size() - 1;
+    }
+
+    //a line of text rendered in Arial, as the load screen's labels are
+    int addText(const std::string &text, float fontSize, const ci::ColorA &background, const ci::Color &color) {
+        Asset asset;
+        asset.text = text;
+        asset.fontSize = fontSize;
+        asset.background = background;
+        asset.color = color;
+        assets.push_back(asset);
+        return assets.size() - 1;
+    }
+
+    bool isStarted() const {
+        return started != 0;
+    }
+
+    //starts decoding everything added so far on up to threads threads (only the first call does anything)
+    void start(int threads) {
+        if (!__sync_bool_compare_and_swap(&started, 0, 1)){
+            return;
+        }
+        startTime = Log::now();
+        for (int t = 0; t < std::min(threads, (int)assets.size()); t++){
+            std::thread(&AssetManager::decodeLoop, this).detach();
+        }
+    }
+
+    //main thread: uploads the assets that have been decoded since the last call, returns the bytes uploaded
+    size_t upload() {
+        if (allUploaded){
+            return 0;
+        }
+        size_t bytes = 0;
+        bool all = true;
+        for (int i = 0; i < (int)assets.size(); i++){
+            if (!assets[i].texture && assets[i].decoded){
+                bytes += uploadAsset(assets[i]);
+            }
+            all = all && assets[i].texture;
+        }
+        if (all){
+            allUploaded = true;
+            logTimes();
+        }
+        return bytes;
+    }
+
+    //main thread: the asset's texture, waiting for it to be decoded if it hasn't been yet
+    const ci::gl::Texture &texture(int asset) {
+        Asset &a = assets[asset];
+        if (!a.texture){
+            while (!a.decoded){
+                usleep(1000);
+            }
+            uploadAsset(a);
+        }
+        return a.texture;
+    }
+
+    //memory held by the uploaded textures
+    size_t bytes() const {
+        size_t total = 0;
+        for (int i = 0; i < (int)assets.size(); i++){
+            if (assets[i].texture){
+                total += (size_t)assets[i].texture.getWidth() * assets[i].texture.getHeight() * 4;
+            }
+        }
+        return total;
+    }
+
+private:
+    struct Asset {
+        std::string path; //image file, or empty for text
+        std::string text;
+        float fontSize;
+        ci::ColorA background;
+        ci::Color color;
+
+        ci::Surface surface; //decoded, dropped once uploaded
+        ci::gl::Texture texture;
+        volatile int decoded; //set once surface is filled in
+        double decodeSeconds;
+        double uploadSeconds;
+
+        Asset() : fontSize(0.0f), decoded(0), decodeSeconds(0.0), uploadSeconds(0.0) {}
+    };
+
+    //background thread: takes assets in turn until none are left
+    void decodeLoop() {
+        for (;;){
+            int i = __sync_fetch_and_add(&nextToDecode, 1);
+            if (i >= (int)assets.size()){
+                return;
+            }
+            Asset &asset = assets[i];
+            double start = Log::now();
+            try{
+                if (!asset.path.empty()){
+                    asset.surface = ci::Surface(ci::loadImage(ci::DataSourcePath::createRef(asset.path)));
+                }
+                else{
+                    FontLock lock;
+                    ci::TextLayout layout;
+                    layout.clear(asset.background);
+                    layout.setFont(ci::Font("Arial", asset.fontSize));
+                    layout.setColor(asset.color);
+                    layout.addLine(asset.text);
+                    asset.surface = layout.render(true, false);
+                }
+            }
+            catch (std::exception &e){
+                LOG_ERROR("couldn't load asset %s: %s", asset.path.empty() ? asset.text.c_str() : asset.path.c_str(), e.what());
+                asset.surface = ci::Surface(2, 2, true); //something to draw rather than nothing
+            }
+            asset.decodeSeconds = Log::now() - start;
+            __sync_synchronize(); //the surface is written before it is marked decoded
+            asset.decoded = 1;
+        }
+    }
+
+    size_t uploadAsset(Asset &asset) {
+        __sync_synchronize();
+        double start = Log::now();
+        asset.texture = ci::gl::Texture(asset.surface);
+        asset.surface = ci::Surface();
+        asset.uploadSeconds = Log::now() - start;
+        return (size_t)asset.texture.getWidth() * asset.texture.getHeight() * 4;
+    }
+
+    void logTimes() const {
+        LOG_INFO("assets: %d ready %.1f ms after start", (int)assets.size(), (Log::now() - startTime) * 1000.0);
+        for (int i = 0; i < (int)assets.size(); i++){
+            const Asset &asset = assets[i];
+            LOG_INFO("  %-24s decoded in %5.1f ms, uploaded in %5.1f ms", asset.path.empty() ? asset.text.c_str() : asset.path.substr(asset.path.rfind('/') + 1).c_str(),
+                     asset.decodeSeconds * 1000.0, asset.uploadSeconds * 1000.0);
+        }
+    }
+
+    AssetManager(const AssetManager &);
+    AssetManager &operator=(const AssetManager &);
+
+    std::vector<Asset> assets; //not added to once started
+    volatile int nextToDecode;
+    volatile int started;
+    bool allUploaded;
+    double startTime;
+};
@@ -0,0 +1,195 @@
+#pragma once
+
+//A canopy compiled ahead of time by tools/bundle_compiler, loaded without parsing or decoding anything
+//  - the panorama is cut into the app's tiles (the copied edge included), at full size and smaller levels
+//  - projection text is already wrapped into lines, and portal images are already shrunk to fit the overlay
+//  - pixels are RGBA, ready to upload; the file is memory-mapped, so only what is uploaded is read
+//
+//Layout (native byte order, each section 16-byte aligned):
+//  BundleHeader
+//  BundleLevel[levelCount]
+//  BundleTile[tileCount] for each level, at its tilesOffset
+//  BundleProjection[projectionCount]
+//  lines (uint32 length, then the bytes) and pixels, found through the offsets above
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+const char BUNDLE_MAGIC[8] = { 'C', 'A', 'N', 'O', 'P', 'Y', 'B', '1' };
+const uint32_t BUNDLE_VERSION = 1;
+
+struct BundleHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t tileWidth;
+    uint32_t tileHeight;
+    uint32_t width; //panorama size, without the copied edge
+    uint32_t height;
+    uint32_t tileCount; //tiles per level, in the app's order (column by column, the copied edge first)
+    uint32_t levelCount;
+    uint32_t projectionCount;
+    uint64_t levelsOffset;
+    uint64_t projectionsOffset;
+};
+
+struct BundleLevel {
+    uint32_t scale; //the panorama is this many times smaller than full size
+    uint32_t reserved;
+    uint64_t tilesOffset;
+};
+
+struct BundleTile {
+    uint64_t pixelsOffset;
+    uint32_t width;
+    uint32_t height;
+};
+
+struct BundleProjection {
+    int32_t id;
+    int32_t offX; //as the canopy information gives them
+    int32_t offY;
+    int32_t width;
+    int32_t height;
+    uint32_t hasImage;
+    uint32_t imageWidth; //portal image as stored (0 if there is none)
+    uint32_t imageHeight;
+    uint64_t imageOffset;
+    uint64_t linesOffset;
+    uint32_t textLineCount;
+    uint32_t captionLineCount;
+    char hash[16]; //of the text, as CanopyLoader works it out
+};
+
+class CanopyBundle {
+public:
+    CanopyBundle() : data(0), size(0) {}
+
+    ~CanopyBundle() {
+        if (data){
+            munmap((void *)data, size);
+        }
+    }
+
+    //maps the bundle at path and checks every offset in it; false with why in error otherwise
+    bool open(const std::string &path, std::string &error) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0){
+            error = "can't open " + path;
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(BundleHeader)){
+            close(fd);
+            error = path + " is too short to be a bundle";
+            return false;
+        }
+        size = info.st_size;
+        void *mapped = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED){
+            size = 0;
+            error = "can't map " + path;
+            return false;
+        }
+        data = (const unsigned char *)mapped;
+        madvise(mapped, size, MADV_WILLNEED);
+
+        if (!valid()){
+            error = path + " isn't a bundle this app can read";
+            return false;
+        }
+        return true;
+    }
+
+    const BundleHeader &header() const {
+        return *(const BundleHeader *)data;
+    }
+
+    const BundleLevel &level(int l) const {
+        return ((const BundleLevel *)(data + header().levelsOffset))[l];
+    }
+
+    const BundleTile &tile(int l, int t) const {
+        return ((const BundleTile *)(data + level(l).tilesOffset))[t];
+    }
+
+    const BundleProjection &projection(int p) const {
+        return ((const BundleProjection *)(data + header().projectionsOffset))[p];
+    }
+
+    const unsigned char *pixels(uint64_t offset) const {
+        return data + offset;
+    }
+
+    //the wrapped description and caption of projection p
+    void lines(int p, std::vector<std::string> &textLines, std::vector<std::string> &captionLines) const {
+        const BundleProjection &proj = projection(p);
+        uint64_t at = proj.linesOffset;
+        textLines.resize(proj.textLineCount);
+        captionLines.resize(proj.captionLineCount);
+        for (uint32_t i = 0; i < proj.textLineCount + proj.captionLineCount; i++){
+            uint32_t length;
+            memcpy(&length, data + at, sizeof(length));
+            std::string line((const char *)data + at + sizeof(length), length);
+            at += sizeof(length) + length;
+            (i < proj.textLineCount ? textLines[i] : captionLines[i - proj.textLineCount]).swap(line);
+        }
+    }
+
+private:
+    CanopyBundle(const CanopyBundle &);
+    CanopyBundle &operator=(const CanopyBundle &);
+
+    bool fits(uint64_t offset, uint64_t length) const {
+        return offset <= size && length <= size - offset;
+    }
+
+    bool valid() const {
+        const BundleHeader &h = header();
+        if (memcmp(h.magic, BUNDLE_MAGIC, sizeof(h.magic)) != 0 || h.version != BUNDLE_VERSION || h.levelCount == 0 ||
+            !fits(h.levelsOffset, (uint64_t)h.levelCount * sizeof(BundleLevel)) ||
+            !fits(h.projectionsOffset, (uint64_t)h.projectionCount * sizeof(BundleProjection))){
+            return false;
+        }
+        for (uint32_t l = 0; l < h.levelCount; l++){
+            if (!fits(level(l).tilesOffset, (uint64_t)h.tileCount * sizeof(BundleTile))){
+                return false;
+            }
+            for (uint32_t t = 0; t < h.tileCount; t++){
+                const BundleTile &tl = tile(l, t);
+                if (!fits(tl.pixelsOffset, (uint64_t)tl.width * tl.height * 4)){
+                    return false;
+                }
+            }
+        }
+        for (uint32_t p = 0; p < h.projectionCount; p++){
+            const BundleProjection &proj = projection(p);
+            if (!fits(proj.imageOffset, (uint64_t)proj.imageWidth * proj.imageHeight * 4)){
+                return false;
+            }
+            uint64_t at = proj.linesOffset;
+            for (uint32_t i = 0; i < proj.textLineCount + proj.captionLineCount; i++){
+                uint32_t length;
+                if (!fits(at, sizeof(length))){
+                    return false;
+                }
+                memcpy(&length, data + at, sizeof(length));
+                at += sizeof(length);
+                if (!fits(at, length)){
+                    return false;
+                }
+                at += length;
+            }
+        }
+        return true;
+    }
+
+    const unsigned char *data;
+    size_t size;
+};
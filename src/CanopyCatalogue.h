@@ -0,0 +1,151 @@
+#pragma once
+
+//The canopies on the server, as the load screen lists them
+//  - IDs are found through a hash index, so checking a typed ID doesn't scan the list
+//  - the list is shown a page at a time, so only the rows on screen are ever rendered
+//
+//  mCatalogue.assign(result.canopyIds, result.canopyNames);
+//  if (mCatalogue.contains(id)) ...load it...
+//  rows = mCatalogue.pageRows(page);
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <algorithm>
+
+class CanopyCatalogue {
+public:
+    CanopyCatalogue() : rowsPerPage(14) {}
+
+    void setRowsPerPage(int rows) {
+        rowsPerPage = std::max(1, rows);
+    }
+
+    //replaces the list; an ID listed twice keeps its first entry
+    void assign(const std::vector<int> &canopyIds, const std::vector<std::string> &canopyNames) {
+        ids.clear();
+        names.clear();
+        size_t capacity = 16;
+        while (capacity < canopyIds.size() * 2){
+            capacity *= 2;
+        }
+        slots.assign(capacity, 0);
+        for (size_t i = 0; i < canopyIds.size(); i++){
+            size_t slot = slotFor(canopyIds[i]);
+            if (slots[slot] == 0){
+                ids.push_back(canopyIds[i]);
+                names.push_back(i < canopyNames.size() ? canopyNames[i] : std::string());
+                slots[slot] = ids.size();
+            }
+        }
+    }
+
+    int size() const {
+        return ids.size();
+    }
+
+    bool empty() const {
+        return ids.empty();
+    }
+
+    int id(int entry) const {
+        return ids[entry];
+    }
+
+    const std::string &name(int entry) const {
+        return names[entry];
+    }
+
+    //the entry of a canopy ID, -1 if it isn't on the server
+    int find(int id) const {
+        if (slots.empty()){
+            return -1;
+        }
+        return slots[slotFor(id)] - 1;
+    }
+
+    bool contains(int id) const {
+        return find(id) != -1;
+    }
+
+    int pageCount() const {
+        return std::max(1, (size() + rowsPerPage - 1) / rowsPerPage);
+    }
+
+    int pageOf(int entry) const {
+        return entry / rowsPerPage;
+    }
+
+    //the rows on a page, "<id>. <name>"
+    std::vector<std::string> pageRows(int page) const {
+        std::vector<std::string> rows;
+        int end = std::min(size(), (page + 1) * rowsPerPage);
+        for (int i = page * rowsPerPage; i < end; i++){
+            std::ostringstream row;
+            row << ids[i] << ". " << names[i];
+            rows.push_back(row.str());
+        }
+        return rows;
+    }
+
+private:
+    //the slot holding id, or the empty slot it would go in (linear probing, the table is never more than half full)
+    size_t slotFor(int id) const {
+        size_t mask = slots.size() - 1;
+        size_t slot = ((unsigned)id * 2654435761u) & mask;
+        while (slots[slot] != 0 && ids[slots[slot] - 1] != id){
+            slot = (slot + 1) & mask;
+        }
+        return slot;
+    }
+
+    int rowsPerPage;
+    std::vector<int> ids;
+    std::vector<std::string> names;
+    std::vector<int> slots; //entry + 1 for each ID, 0 where empty
+};
+
+//A canopy ID typed on the number pad, any number of digits long
+class CanopyIdInput {
+public:
+    enum { MAX_DIGITS = 9 }; //the most that always fit in an int
+
+    //false if there is no room for another digit
+    bool push(int digit) {
+        if (digits.size() >= MAX_DIGITS || digit < 0 || digit > 9){
+            return false;
+        }
+        digits += (char)('0' + digit);
+        return true;
+    }
+
+    //deletes the last digit
+    void back() {
+        if (!digits.empty()){
+            digits.erase(digits.size() - 1);
+        }
+    }
+
+    void clear() {
+        digits.clear();
+    }
+
+    bool empty() const {
+        return digits.empty();
+    }
+
+    const std::string &text() const {
+        return digits;
+    }
+
+    int value() const {
+        int id = 0;
+        for (size_t i = 0; i < digits.size(); i++){
+            id = id * 10 + (digits[i] - '0');
+        }
+        return id;
+    }
+
+private:
+    std::string digits;
+};
@@ -0,0 +1,530 @@
+#pragma once
+
+//Loads canopies off the main thread
+//
+//  main thread --jobs--> I/O thread --fetched--> decode thread --results--> main thread
+//
+//  - the I/O thread downloads, keeping connections open between requests
+//  - the decode thread parses XML, decodes and shrinks images, cuts the full panorama into tiles and renders projection text
+//  - the main thread only turns finished images into textures
+//Each hop is a single-producer/single-consumer queue, so no stage waits on another's lock.
+//cancel() makes everything already requested stale: it is skipped where possible and never returned.
+//
+//With a cache directory set, nothing unchanged is transferred twice:
+//  - manifests and portal images are kept on disk with their ETag and asked for again with If-None-Match
+//  - portal images the manifest gives an imageHash for are read from disk without asking at all
+//  - rendered projection text is kept by a hash of its content, so only edited text is wrapped and rendered again
+//
+//A BUNDLE job opens a canopy compiled by tools/bundle_compiler instead: nothing is downloaded or decoded,
+//the decode thread maps the file and renders the already wrapped text, and the app uploads tiles straight from it.
+//
+//Each stage is timed with TRACE_SPAN, so with Trace started a load can be seen thread by thread.
+
+#include "cinder/Cinder.h"
+#include "cinder/Surface.h"
+#include "cinder/ImageIo.h"
+#include "cinder/Xml.h"
+#include "cinder/Text.h"
+#include "cinder/Font.h"
+#include "cinder/Thread.h"
+#include "cinder/ip/Resize.h"
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <list>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdexcept>
+#include "HttpClient.h"
+#include "CanopyBundle.h"
+#include "DiskCache.h"
+#include "SpscQueue.h"
+#include "TextWrap.h"
+#include "FontLock.h"
+#include "Log.h"
+#include "Trace.h"
+#include "TileStream.h"
+
+//A data object as listed in the canopy information, with its text already wrapped and rendered
+struct ProjectionRecord {
+    int id;
+    std::string hash; //of the text; from the manifest, or worked out from the text if it has none
+    std::string imageHash; //of the portal image, empty if the manifest doesn't give one
+    int offX;
+    int offY;
+    int height;
+    int width;
+    bool hasImage;
+    std::vector<std::string> textLines;
+    std::vector<std::string> captionLines;
+    ci::Surface infoText;
+    ci::Surface captionText;
+};
+
+typedef std::shared_ptr<CanopyBundle> CanopyBundleRef;
+typedef std::shared_ptr<TileStream> TileStreamRef;
+
+struct CanopyManifest {
+    int width;
+    int height;
+    std::vector<ProjectionRecord> projections;
+    double textSeconds; //time spent wrapping and rendering text
+    int textReused; //projections whose rendered text was kept from an earlier load
+
+    CanopyManifest() : width(0), height(0), textSeconds(0.0), textReused(0) {}
+};
+
+struct LoadJob {
+    enum Type {
+        CANOPY_LIST,
+        MANIFEST,
+        PREVIEW,
+        PANORAMA,
+        PORTAL_IMAGE,
+        BUNDLE //url is the path of a compiled bundle
+    };
+
+    Type type;
+    std::string url;
+    int index; //projection a portal image belongs to
+    int maxWidth; //portal images are shrunk to fit (0 keeps the size)
+    int maxHeight;
+    std::string hash; //content hash of a portal image, if the manifest gives one
+    TileCut cut; //PANORAMA: cut into tiles as it is decoded, rather than decoded whole (no areas: decoded whole)
+    int generation; //set by CanopyLoader::request()
+
+    LoadJob() : type(CANOPY_LIST), index(-1), maxWidth(0), maxHeight(0), generation(0) {}
+    LoadJob(Type type, const std::string &url, int index = -1) : type(type), url(url), index(index), maxWidth(0), maxHeight(0), generation(0) {}
+};
+
+struct LoadResult {
+    LoadJob job;
+    std::string error; //empty if the job succeeded
+    double fetchSeconds;
+    double decodeSeconds;
+    bool cached; //the bytes came from the disk cache (nothing, or only a "not modified", was downloaded)
+
+    std::vector<int> canopyIds; //CANOPY_LIST
+    std::vector<std::string> canopyNames;
+    CanopyManifest manifest; //MANIFEST, BUNDLE
+    CanopyBundleRef bundle; //BUNDLE
+    ci::Surface image; //PREVIEW, PANORAMA without a cut, PORTAL_IMAGE
+    TileStreamRef tiles; //PANORAMA with a cut
+
+    LoadResult() : fetchSeconds(0.0), decodeSeconds(0.0), cached(false) {}
+};
+
+class CanopyLoader {
+public:
+    CanopyLoader() : urgent(256), background(4096), fetched(16), results(256), generation(0), started(0) {}
+
+    //starts the I/O and decode threads (only the first call does anything)
+    void start() {
+        if (__sync_bool_compare_and_swap(&started, 0, 1)){
+            std::thread(&CanopyLoader::ioLoop, this).detach();
+            std::thread(&CanopyLoader::decodeLoop, this).detach();
+        }
+    }
+
+    HttpClient &http() {
+        return client;
+    }
+
+    //keeps downloads in directory between runs, trimmed to maxBytes (does nothing once started)
+    void setCache(const std::string &directory, size_t maxBytes) {
+        if (!started && cache.open(directory)){
+            cache.trim(maxBytes);
+        }
+    }
+
+    //main thread: queues a job; portal images wait behind everything else
+    void request(LoadJob job) {
+        job.generation = generation;
+        if (job.type == LoadJob::PORTAL_IMAGE){
+            overflowBackground.push_back(job);
+        }
+        else{
+            overflowUrgent.push_back(job);
+        }
+        flush();
+    }
+
+    //main thread: everything requested so far will be dropped
+    void cancel() {
+        __sync_fetch_and_add(&generation, 1);
+        overflowUrgent.clear();
+        overflowBackground.clear();
+    }
+
+    //main thread: the next finished job of the current generation, false if there is none yet
+    bool poll(LoadResult &result) {
+        flush();
+        while (results.pop(result)){
+            if (result.job.generation == generation){
+                return true;
+            }
+        }
+        return false;
+    }
+
+    //renders the wrapped description and caption as they are shown in the overlay
+    static void renderProjectionText(ProjectionRecord &record) {
+        TRACE_SPAN_ARG("render text", record.id);
+        FontLock lock;
+        float clearAlpha = 0.5f;// set transparency value
+
+        ci::TextLayout caption;
+        caption.clear(ci::ColorA(0.0f,0.0f,0.0f,clearAlpha));//caption backgroud color
+        caption.setFont(ci::Font("Arial", 14));//caption font
+        caption.setColor(ci::Color(1.0f,1.0f,1.0f));//caption text color
+
+        ci::TextLayout info;
+        info.clear(ci::ColorA(0.0f,0.0f,0.0f,clearAlpha));//backgroud color
+        info.setFont(ci::Font("Arial", 18));//font
+        info.setColor(ci::Color(1.0f,1.0f,1.0f));//text color
+
+        //add text lines for the object
+        for (int t = 0; t < record.textLines.size(); t++){
+            info.addLine(record.textLines[t]);
+        }
+        for (int t = 0; t < record.captionLines.size(); t++){
+            caption.addLine(record.captionLines[t]);
+        }
+
+        record.infoText = info.render(true, false);
+        record.captionText = caption.render(true, false);
+    }
+
+private:
+    struct Fetched {
+        LoadJob job;
+        std::string bytes;
+        std::string error;
+        double fetchSeconds;
+        bool cached;
+
+        Fetched() : fetchSeconds(0.0), cached(false) {}
+    };
+
+    //a rendered projection text, kept by its hash
+    struct RenderedText {
+        std::vector<std::string> textLines;
+        std::vector<std::string> captionLines;
+        ci::Surface infoText;
+        ci::Surface captionText;
+    };
+
+    //moves jobs the queues had no room for into them
+    void flush() {
+        while (!overflowUrgent.empty() && urgent.push(overflowUrgent.front())){
+            overflowUrgent.pop_front();
+        }
+        while (!overflowBackground.empty() && background.push(overflowBackground.front())){
+            overflowBackground.pop_front();
+        }
+    }
+
+    //what a job's download is called in traces
+    static const char *fetchSpanName(LoadJob::Type type) {
+        static const char *names[] = { "fetch canopy list", "fetch manifest", "fetch preview", "fetch panorama", "fetch portal image", "open bundle" };
+        return names[type];
+    }
+
+    bool stale(const LoadJob &job) const {
+        return job.generation != generation;
+    }
+
+    //I/O thread: downloads jobs, most urgent first
+    void ioLoop() {
+        Trace::nameThread("io");
+        for (;;){
+            Fetched item;
+            if (!urgent.pop(item.job) && !background.pop(item.job)){
+                usleep(2000);
+                continue;
+            }
+            if (stale(item.job)){
+                continue;
+            }
+
+            //bundles are local files, mapped by the decode thread
+            double start = Log::now();
+            if (item.job.type != LoadJob::BUNDLE){
+                TRACE_SPAN_ARG(fetchSpanName(item.job.type), item.job.index);
+                fetch(item);
+            }
+            item.fetchSeconds = Log::now() - start;
+
+            while (!fetched.push(item) && !stale(item.job)){
+                usleep(2000);
+            }
+        }
+    }
+
+    //I/O thread: gets a job's bytes from the disk cache or the server
+    void fetch(Fetched &item) {
+        const LoadJob &job = item.job;
+        bool cacheable = job.type == LoadJob::MANIFEST || job.type == LoadJob::PORTAL_IMAGE;
+        std::string key = job.hash.empty() ? job.url : "portal " + job.hash;
+        std::string tag;
+        std::string cachedBytes;
+        bool inCache = cacheable && cache.read(key, cachedBytes, &tag);
+
+        //a portal image is the same wherever its hash is
+        if (inCache && !job.hash.empty()){
+            item.bytes.swap(cachedBytes);
+            item.cached = true;
+            return;
+        }
+
+        std::map<std::string, std::string> headers;
+        if (inCache && !tag.empty()){
+            headers["If-None-Match"] = tag;
+        }
+        HttpResponse response;
+        if (!client.get(job.url, response, headers)){
+            item.error = response.error;
+            return;
+        }
+        if (response.status == 304 && inCache){
+            item.bytes.swap(cachedBytes);
+            item.cached = true;
+            return;
+        }
+        if (cacheable && (!job.hash.empty() || !response.header("etag").empty())){
+            cache.write(key, response.body, response.header("etag"));
+        }
+        item.bytes.swap(response.body);
+    }
+
+    //decode thread: parses and decodes downloads
+    void decodeLoop() {
+        Trace::nameThread("decode");
+        for (;;){
+            Fetched item;
+            if (!fetched.pop(item)){
+                usleep(2000);
+                continue;
+            }
+            if (stale(item.job)){
+                continue;
+            }
+
+            LoadResult result;
+            result.job = item.job;
+            result.error = item.error;
+            result.fetchSeconds = item.fetchSeconds;
+            result.cached = item.cached;
+            if (result.error.empty()){
+                double start = Log::now();
+                try{
+                    decode(item.bytes, result);
+                }
+                catch (std::exception &e){
+                    result.error = e.what();
+                }
+                result.decodeSeconds = Log::now() - start;
+            }
+
+            while (!results.push(result) && !stale(result.job)){
+                usleep(2000);
+            }
+        }
+    }
+
+    static ci::DataSourceRef bufferSource(const std::string &bytes) {
+        ci::Buffer buffer(bytes.size());
+        memcpy(buffer.getData(), bytes.data(), bytes.size());
+        return ci::DataSourceBuffer::createRef(buffer);
+    }
+
+    void decode(const std::string &bytes, LoadResult &result) {
+        switch (result.job.type){
+            case LoadJob::CANOPY_LIST: {
+                TRACE_SPAN("parse canopy list");
+                ci::XmlTree canopies(bufferSource(bytes));
+                const std::list<ci::XmlTree> &listOfCanopies = canopies.getChild("canopies").getChildren();
+                for (std::list<ci::XmlTree>::const_iterator i = listOfCanopies.begin(); i != listOfCanopies.end(); ++i){
+                    result.canopyIds.push_back(atoi(i->getChild("id").getValue().c_str()));
+                    result.canopyNames.push_back(i->getChild("name").getValue());
+                }
+                break;
+            }
+            case LoadJob::MANIFEST:
+                decodeManifest(bytes, result.manifest);
+                break;
+            case LoadJob::BUNDLE:
+                decodeBundle(result.job.url, result);
+                break;
+            case LoadJob::PANORAMA:
+                if (!result.job.cut.areas.empty()){
+                    decodeTiles(bytes, result);
+                    break;
+                }
+                //without a cut it is decoded whole, as the preview is
+            default: {
+                ci::Surface image;
+                {
+                    TRACE_SPAN_ARG(result.job.type == LoadJob::PORTAL_IMAGE ? "decode portal image" : "decode panorama", result.job.index);
+                    image = ci::Surface(ci::loadImage(bufferSource(bytes)));
+                }
+                if (result.job.maxWidth > 0 && result.job.maxHeight > 0){
+                    float scale = std::min(result.job.maxWidth / (float)image.getWidth(), result.job.maxHeight / (float)image.getHeight());
+                    if (scale < 1.0f){
+                        TRACE_SPAN_ARG("shrink portal image", result.job.index);
+                        ci::Vec2i size(std::max(1, (int)(image.getWidth() * scale)), std::max(1, (int)(image.getHeight() * scale)));
+                        image = ci::ip::resizeCopy(image, image.getBounds(), size);
+                    }
+                }
+                result.image = image;
+                break;
+            }
+        }
+    }
+
+    //cuts a panorama into packed tiles, a strip at a time if it is a baseline JPEG,
+    //otherwise from the whole decoded image (which is dropped as soon as it is cut)
+    void decodeTiles(const std::string &bytes, LoadResult &result) {
+        TileStreamRef tiles(new TileStream);
+        if (!streamJpegTiles((const unsigned char *)bytes.data(), bytes.size(), result.job.cut, *tiles)){
+            TRACE_SPAN("decode panorama");
+            ci::Surface image = ci::Surface(ci::loadImage(bufferSource(bytes)));
+            const ci::SurfaceChannelOrder &order = image.getChannelOrder();
+            tiles->begin(result.job.cut, image.getWidth(), image.getHeight(), image.getPixelInc(), order.getRedOffset(), order.getGreenOffset(),
+                         order.getBlueOffset());
+            tiles->cutImage(image.getData(), image.getRowBytes());
+        }
+        result.tiles = tiles;
+    }
+
+    void decodeManifest(const std::string &bytes, CanopyManifest &manifest) {
+        TRACE_SPAN("decode manifest");
+        ci::XmlTree doc;
+        {
+            TRACE_SPAN("parse manifest");
+            doc = ci::XmlTree(bufferSource(bytes));
+        }
+        const ci::XmlTree &canopy = doc.getChild("canopy");
+        manifest.height = atoi(canopy.getChild("height").getValue().c_str());
+        manifest.width = atoi(canopy.getChild("width").getValue().c_str());
+
+        const std::list<ci::XmlTree> &projections = canopy.getChild("projections").getChildren();
+        manifest.projections.resize(projections.size());
+        manifest.textSeconds = 0.0;
+        int cursor = 0;
+        for (std::list<ci::XmlTree>::const_iterator i = projections.begin(); i != projections.end(); ++i, ++cursor){
+            ProjectionRecord &record = manifest.projections[cursor];
+            record.id = atoi(i->getChild("id").getValue().c_str());
+            record.offX = atoi(i->getChild("offX").getValue().c_str());
+            record.offY = atoi(i->getChild("offY").getValue().c_str());
+            record.height = atoi(i->getChild("height").getValue().c_str());
+            record.width = atoi(i->getChild("width").getValue().c_str());
+            record.hasImage = record.width != 0;
+            if (i->hasChild("imageHash")){
+                record.imageHash = i->getChild("imageHash").getValue();
+            }
+
+            double start = Log::now();
+            std::string description = i->getChild("description").getValue();
+            std::string caption = record.hasImage ? i->getChild("caption").getValue() : std::string(" ");
+            record.hash = i->hasChild("hash") ? i->getChild("hash").getValue() : DiskCache::hash(description + '\0' + caption);
+
+            //text that hasn't changed since an earlier load is already rendered
+            std::map<std::string, RenderedText>::iterator found = renderedText.find(record.hash);
+            if (found != renderedText.end()){
+                record.textLines = found->second.textLines;
+                record.captionLines = found->second.captionLines;
+                record.infoText = found->second.infoText;
+                record.captionText = found->second.captionText;
+                manifest.textReused++;
+            }
+            else{
+                {
+                    TRACE_SPAN_ARG("wrap text", record.id);
+                    wrapProjectionText(description, caption, record.textLines, record.captionLines);
+                }
+                renderProjectionText(record);
+                keepText(record);
+            }
+            manifest.textSeconds += Log::now() - start;
+        }
+    }
+
+    //maps a compiled bundle; its text is already wrapped, so only rendering it is left
+    void decodeBundle(const std::string &path, LoadResult &result) {
+        TRACE_SPAN("decode bundle");
+        CanopyBundleRef bundle(new CanopyBundle);
+        std::string error;
+        {
+            TRACE_SPAN("map bundle");
+            if (!bundle->open(path, error)){
+                throw std::runtime_error(error);
+            }
+        }
+        const BundleHeader &header = bundle->header();
+        CanopyManifest &manifest = result.manifest;
+        manifest.width = header.width;
+        manifest.height = header.height;
+        manifest.projections.resize(header.projectionCount);
+        manifest.textSeconds = 0.0;
+        for (int p = 0; p < (int)header.projectionCount; p++){
+            const BundleProjection &proj = bundle->projection(p);
+            ProjectionRecord &record = manifest.projections[p];
+            record.id = proj.id;
+            record.hash = std::string(proj.hash, sizeof(proj.hash));
+            record.offX = proj.offX;
+            record.offY = proj.offY;
+            record.height = proj.height;
+            record.width = proj.width;
+            record.hasImage = proj.hasImage;
+
+            double start = Log::now();
+            std::map<std::string, RenderedText>::iterator found = renderedText.find(record.hash);
+            if (found != renderedText.end()){
+                record.textLines = found->second.textLines;
+                record.captionLines = found->second.captionLines;
+                record.infoText = found->second.infoText;
+                record.captionText = found->second.captionText;
+                manifest.textReused++;
+            }
+            else{
+                bundle->lines(p, record.textLines, record.captionLines);
+                renderProjectionText(record);
+                keepText(record);
+            }
+            manifest.textSeconds += Log::now() - start;
+        }
+        result.bundle = bundle;
+    }
+
+    //keeps a rendered text for later loads (all of them are dropped once there are TEXT_CACHE_ENTRIES)
+    void keepText(const ProjectionRecord &record) {
+        if (renderedText.size() >= TEXT_CACHE_ENTRIES){
+            renderedText.clear();
+        }
+        RenderedText &text = renderedText[record.hash];
+        text.textLines = record.textLines;
+        text.captionLines = record.captionLines;
+        text.infoText = record.infoText;
+        text.captionText = record.captionText;
+    }
+
+    CanopyLoader(const CanopyLoader &);
+    CanopyLoader &operator=(const CanopyLoader &);
+
+    enum { TEXT_CACHE_ENTRIES = 1024 };
+
+    HttpClient client;
+    DiskCache cache; //I/O thread only
+    std::map<std::string, RenderedText> renderedText; //decode thread only
+    SpscQueue<LoadJob> urgent; //main -> I/O: lists, manifests and panoramas
+    SpscQueue<LoadJob> background; //main -> I/O: portal images
+    SpscQueue<Fetched> fetched; //I/O -> decode
+    SpscQueue<LoadResult> results; //decode -> main
+    std::deque<LoadJob> overflowUrgent; //main thread only: jobs waiting for room in the queues
+    std::deque<LoadJob> overflowBackground;
+    volatile int generation;
+    volatile int started;
+};
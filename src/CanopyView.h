@@ -0,0 +1,305 @@
+#pragma once
+
+//Where the canopy view is looking and the draw list for it, without Cinder or GL
+//Shared by the app and tools/headless_render, so the tool draws the frames the app would,
+//and by tools/bundle_compiler, so bundles are cut into the tiles the app uses.
+//
+//  CanopyPose pose = poseFor(grid, mYaw.follow(rotation.y) - modYaw, rotation.z - modRoll, rotation.x - modPitch);
+//  buildCanopyDrawList(mDrawList, grid, pose, overlays);
+
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#include "DrawList.h"
+
+//How the panorama is cut into tiles and how many of them cover the screen
+struct CanopyGrid {
+    int ghostWidth; //panorama width, with the copied edge
+    int ghostHeight;
+    int ghostRows;
+    int ghostCols;
+    int tileWidth;
+    int tileHeight;
+    int screenWidth;
+    int screenHeight;
+    int screenRows; //tiles in the live window
+    int screenCols;
+};
+
+//The part of the panorama a tile shows
+struct TileArea {
+    int x1;
+    int y1;
+    int x2;
+    int y2;
+};
+
+//the part of the panorama (width without the copied edge) each tile shows, in the app's tile order:
+//column by column, the copy of the panorama's last 1024 pixels first
+inline std::vector<TileArea> canopyTileAreas(int width, int height, int tileWidth, int tileHeight)
+{
+    int rows = (int)ceil(height / (float)tileHeight);
+    int cols = (int)ceil(width / (float)tileWidth);
+    std::vector<TileArea> areas(rows * (cols + (1024 / tileWidth)));
+    int ghostIndex = rows * (1024 / tileWidth);
+    int startIndex = 0;
+    for(int x = 0; x < cols ; ++x) {
+        for(int y = 0; y < rows ; ++y) {
+
+            int gX = tileWidth * x;
+            int gY = tileHeight * y;
+            int gH = std::min(tileHeight, height - tileHeight * y);
+            int gW = std::min(tileWidth, width - tileWidth * x);
+
+            TileArea area = { gX, gY, gX + gW, gY + gH };
+            areas[ghostIndex] = area;
+            ghostIndex++;
+
+            //adds end to beginning of image
+            if (x == cols - 1){
+                gW = tileWidth;
+                for (int u = (1024 / tileWidth); u > 0; u--){
+                    gX = width - tileWidth * u;
+                    TileArea copy = { gX, gY, gX + gW, gY + gH };
+                    areas[startIndex] = copy;
+                    startIndex++;
+                }
+            }
+        }
+    }
+    return areas;
+}
+
+//Adds up yaw readings across their wrap at +-pi, so turning all the way around keeps going
+class YawTracker {
+public:
+    YawTracker() {
+        reset();
+    }
+
+    void reset() {
+        actu = -1.0f;
+        curr = 0.0f;
+        prev = 0.0f;
+    }
+
+    //the actual yaw after a new reading
+    float follow(float yaw) {
+        //updates the actual X offset based on the difference between the past and current gyro reading
+        if(actu == -1.0){
+            actu = yaw;
+            curr = yaw;
+            prev = yaw;
+            return actu;
+        }
+        curr = yaw;
+
+        if (prev > 0 && curr < 0){
+            if(fabsf(prev) < 0.5 && fabsf(curr) < 0.5){
+                actu -= fabsf(prev + curr);
+            }
+            else{
+                actu += fabsf(prev + curr);
+            }
+        }
+        else if (prev < 0 && curr < 0){
+            if (prev > curr){
+                actu -= fabsf(prev - curr);
+            }
+            else if (prev < curr){
+                actu += fabsf(prev - curr);
+            }
+        }
+        else if (prev > 0 && curr > 0){
+            if (prev > curr){
+                actu -= fabsf(prev - curr);
+            }
+            else if (prev < curr){
+                actu += fabsf(prev - curr);
+            }
+        }
+        else if (prev < 0 && curr > 0){
+            if(fabsf(prev) < 0.5 && fabsf(curr) < 0.5){
+                actu += fabsf(prev + curr);
+            }
+            else{
+                actu -= fabsf(prev + curr);
+            }
+        }
+
+        prev = curr;
+        return actu;
+    }
+
+private:
+    float actu; //the actual x position calculated by small delta moves (-1.0 before the first reading)
+    float curr; //the new X gyro reading
+    float prev; //the old actual x position
+};
+
+//Where the screen is on the canvas
+struct CanopyPose {
+    float xOffset; //global X location of where top left corner is on the canvas
+    float yOffset; //global Y location of where top left corner is on the canvas
+    float pitch; //degrees the canvas is turned by
+    int baseRow; //tile row at the top of the live window
+    int baseCol; //tile column at the left of the live window
+};
+
+//fills in the live window's base row and column for the pose's offsets
+inline CanopyPose withTiles(const CanopyGrid &grid, CanopyPose pose)
+{
+    // Figure out the base row / column to view
+    int gR = grid.ghostRows - 1 - (((int)floor(pose.yOffset / grid.tileHeight) + grid.ghostRows));
+
+    int lowestRow = grid.ghostHeight / grid.tileHeight;//Keeps iPad on the image
+    gR = std::max(0, std::min(gR, lowestRow));
+
+    pose.baseRow = gR;
+    pose.baseCol = grid.ghostCols - 1 - (((int)floor(pose.xOffset / grid.tileWidth) + grid.ghostCols));
+    return pose;
+}
+
+//the pose for calibrated readings (radians), yaw already followed by a YawTracker
+inline CanopyPose poseFor(const CanopyGrid &grid, float yaw, float roll, float pitch)
+{
+    CanopyPose pose;
+
+    // calculating change in gyro for Y direction, roll
+    pose.yOffset = -((roll + 3.1415/2) / (2 * 3.1415)) * grid.ghostWidth - 1200.0f;
+
+    // calculating change in gyro for X direction (ipad is being held sideways), yaw
+    pose.xOffset = (yaw / (2 * 3.1415)) * grid.ghostWidth;
+
+    //Transfers view to other end of image if reaches the end
+    while (pose.xOffset >= 0) {
+        pose.xOffset -= (grid.ghostWidth - grid.screenWidth);
+    }
+    while(pose.xOffset < -(grid.ghostWidth - grid.screenWidth)){
+        pose.xOffset += (grid.ghostWidth - grid.screenWidth);
+    }
+
+    // calculating change in gyro for Z direction, pitch
+    pose.pitch = pitch / (2 * 3.1415) * 360.0f;
+
+    return withTiles(grid, pose);
+}
+
+inline int liveRows(const CanopyGrid &grid)
+{
+    return std::min(grid.screenRows, grid.ghostRows);
+}
+
+inline int liveCols(const CanopyGrid &grid)
+{
+    return std::min(grid.screenCols, grid.ghostCols);
+}
+
+//the tile shown in slot (c * liveRows + r) of the live window
+inline int liveTile(const CanopyGrid &grid, const CanopyPose &pose, int slot)
+{
+    int c = slot / liveRows(grid);
+    int r = slot % liveRows(grid);
+    return ((pose.baseCol + c) % grid.ghostCols) * grid.ghostRows + ((pose.baseRow + r) % grid.ghostRows);
+}
+
+//Everything on screen besides the panorama, as left by the view step
+struct CanopyOverlays {
+    const int *offX; //data object positions on the canvas
+    const int *offY;
+    const int *data; //projection each position belongs to
+    const unsigned char *visible; //if each object is on screen
+    int count;
+
+    int objectScanned; //-1 if none
+    int displayedObject; //-1 if none
+    bool showScanning;
+    bool showButtons;
+    bool paused;
+    bool showScanBox;
+    int scannerX;
+    int scannerY;
+
+    int top; //objects off each edge of the screen
+    int bottom;
+    int left;
+    int right;
+};
+
+//lists what the canopy view looks like
+inline void buildCanopyDrawList(DrawList &list, const CanopyGrid &grid, const CanopyPose &pose, const CanopyOverlays &o)
+{
+    list.clear();
+
+    int usedRows = liveRows(grid);
+    int usedCols = liveCols(grid);
+    int relXOffset = (int) pose.xOffset % grid.tileWidth;
+    int relYOffset = (int) pose.yOffset % grid.tileHeight - grid.screenHeight;
+
+    // move the picture in accordance to gyro readings
+    list.pitch = pose.pitch;
+    list.canvasX = relXOffset;
+    list.canvasY = relYOffset;
+
+    for(int c = 0; c < usedCols ; ++c) {
+        for(int r = 0; r < usedRows ; ++r) {
+            int gH = std::min(grid.tileHeight, grid.ghostHeight - grid.tileHeight * ((pose.baseRow + r)));
+            int gW = std::min(grid.tileWidth, grid.ghostWidth - grid.tileWidth * ((pose.baseCol + c)));
+            list.add(DrawItem::TILE, c * usedRows + r, c * grid.tileWidth, r * grid.tileHeight, gW, gH);
+        }
+    }
+
+    // notices on objects that are on screen, unless the object is being displayed
+    for (int i = 0; i < o.count; ++i) {
+        if (o.visible[i] && o.displayedObject != i){
+            list.add(DrawItem::INDICATOR, o.objectScanned == i ? 1 : 0, //changes indicators icon if being scanned (pre-display)
+                     o.offX[i] + pose.xOffset - relXOffset, o.offY[i] + pose.yOffset - relYOffset - grid.screenHeight);
+        }
+    }
+
+    if (o.showScanning){
+        list.add(DrawItem::SCANNING, 0, 750.0f, -90.0f);
+    }
+
+    if (o.showButtons){ //displays screen buttons when screen is touched
+        if (o.paused){
+            list.add(DrawItem::BUTTON, DrawList::PLAY, 0, 20.0f, 768.0f, 100.0f);
+            list.add(DrawItem::BUTTON, DrawList::SWITCH_PANORAMA, 0, 924, 100, 100);
+        }
+        else{
+            list.add(DrawItem::BUTTON, DrawList::PAUSE, 0.0f, 20.0f, 768.0f, 100.0f);
+            list.add(DrawItem::BUTTON, DrawList::CALIBRATE, 668, 924, 100, 100);
+            list.add(DrawItem::BUTTON, DrawList::SWITCH_PANORAMA, 0, 924, 100, 100);
+        }
+    }
+
+    if (o.showScanBox){ //shows the scanning box
+        list.add(DrawItem::SCAN_BOX, 0, grid.screenHeight/2 - o.scannerY/2, grid.screenWidth/2 - o.scannerX/2, o.scannerY, o.scannerX);
+    }
+
+    //prevents duplication when going too low or too high
+    if (pose.yOffset < -grid.ghostHeight){
+        list.add(DrawItem::TOO_LOW, 0, 700.0f, -150.0f);
+    }
+    if (pose.yOffset > grid.ghostHeight){
+        list.add(DrawItem::TOO_HIGH, 0, 700.0f, -818.0f);
+    }
+
+    if (o.displayedObject != -1){// if an object is being displayed, display text/pic
+        list.add(DrawItem::OVERLAY, o.data[o.displayedObject], 500, 500);
+    }
+
+    //searching arrows to indicate where projections are
+    if (o.right > 0){
+        list.add(DrawItem::ARROW, 0, 384.0, 1000.0, 0, 0, 90.0);
+    }
+    if (o.left > 0){
+        list.add(DrawItem::ARROW, 0, 384.0, 44.0, 0, 0, -90.0);
+    }
+    if (o.top > 0){
+        list.add(DrawItem::ARROW, 0, 744.0, 512, 0, 0, 0.0);
+    }
+    if (o.bottom > 0){
+        list.add(DrawItem::ARROW, 0, 24.0, 512.0, 0, 0, 180.0);
+    }
+}
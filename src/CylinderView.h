@@ -0,0 +1,183 @@
+#pragma once
+
+//The panorama wrapped around a cylinder and seen from its axis, without Cinder or GL
+//  - the cylinder's circumference is the panorama's width, so its pixels stay square
+//  - each tile is a strip of quads around the cylinder, all in one vertex array
+//  - the camera looks where the flat view's pose looks, so scanning and the arrows still line up
+//  - tiles outside the camera's frustum are culled, so only what is on screen is drawn
+//Shared by the app (which aims its CameraPersp with it) and tools/headless_render.
+//
+//  buildCylinderMesh(mCylinder, areas, firstTile, panoramaWidth, ghostHeight);
+//  CylinderCamera camera = cylinderCamera(mCylinder, grid, pose);
+//  cullCylinder(mCylinder, frustumFrom(viewProjection), mCylinderTiles);
+
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include "CanopyView.h"
+
+//The cylinder's vertices, with the tiles as ranges of triangle strips in them
+struct CylinderMesh {
+    float radius;
+    int panoramaWidth; //without the copied edge
+    int panoramaHeight;
+    std::vector<float> vertices; //x y z for each vertex
+    std::vector<float> coords; //u v for each vertex
+    std::vector<int> tiles; //ghost surface each strip shows
+    std::vector<int> first; //first vertex of each strip
+    std::vector<int> count; //vertices in each strip
+    std::vector<float> bounds; //min x y z, max x y z of each strip
+};
+
+//wraps the tiles from firstTile on (the ones before are copies of the panorama's end) around the cylinder,
+//each cut into segments no wider than segmentWidth pixels so the curve stays smooth
+inline void buildCylinderMesh(CylinderMesh &mesh, const std::vector<TileArea> &areas, int firstTile, int panoramaWidth, int panoramaHeight,
+                              int segmentWidth = 64)
+{
+    mesh.radius = panoramaWidth / (2.0f * (float)M_PI);
+    mesh.panoramaWidth = panoramaWidth;
+    mesh.panoramaHeight = panoramaHeight;
+    mesh.vertices.clear();
+    mesh.coords.clear();
+    mesh.tiles.clear();
+    mesh.first.clear();
+    mesh.count.clear();
+    mesh.bounds.clear();
+
+    for (int t = firstTile; t < (int)areas.size(); t++){
+        const TileArea &area = areas[t];
+        int segments = std::max(1, (area.x2 - area.x1 + segmentWidth - 1) / segmentWidth);
+        float top = panoramaHeight / 2.0f - area.y1;
+        float bottom = panoramaHeight / 2.0f - area.y2;
+        mesh.tiles.push_back(t);
+        mesh.first.push_back(mesh.vertices.size() / 3);
+        mesh.count.push_back((segments + 1) * 2);
+
+        float low[3] = { mesh.radius, bottom, mesh.radius };
+        float high[3] = { -mesh.radius, top, -mesh.radius };
+        for (int s = 0; s <= segments; s++){
+            float u = s / (float)segments;
+            float angle = 2.0f * (float)M_PI * (area.x1 + (area.x2 - area.x1) * u) / panoramaWidth;
+            float x = mesh.radius * sinf(angle);
+            float z = -mesh.radius * cosf(angle);
+            float strip[] = { x, top, z, x, bottom, z };
+            float stripCoords[] = { u, 0.0f, u, 1.0f };
+            mesh.vertices.insert(mesh.vertices.end(), strip, strip + 6);
+            mesh.coords.insert(mesh.coords.end(), stripCoords, stripCoords + 4);
+            low[0] = std::min(low[0], x);
+            low[2] = std::min(low[2], z);
+            high[0] = std::max(high[0], x);
+            high[2] = std::max(high[2], z);
+        }
+        mesh.bounds.insert(mesh.bounds.end(), low, low + 3);
+        mesh.bounds.insert(mesh.bounds.end(), high, high + 3);
+    }
+}
+
+//Where the camera is and what it looks at, for CameraPersp::lookAt and setPerspective
+struct CylinderCamera {
+    float eye[3];
+    float target[3];
+    float up[3];
+    float fov; //degrees across the screen's long side (the window's height, as the app is drawn sideways)
+    float nearClip;
+    float farClip;
+};
+
+//the camera at the middle of the cylinder's axis, looking at the pixel the flat view has at the middle of the screen
+//and turned as the flat canvas is, with the same number of pixels across the screen where it looks straight ahead
+inline CylinderCamera cylinderCamera(const CylinderMesh &mesh, const CanopyGrid &grid, const CanopyPose &pose)
+{
+    float centerX = grid.screenWidth / 2.0f - pose.xOffset - 1024.0f; //on the panorama, without the copied edge
+    float centerY = grid.screenHeight / 2.0f - pose.yOffset;
+    float angle = 2.0f * (float)M_PI * centerX / mesh.panoramaWidth;
+
+    CylinderCamera camera;
+    float look[3] = { mesh.radius * sinf(angle), mesh.panoramaHeight / 2.0f - centerY, -mesh.radius * cosf(angle) };
+    float length = sqrtf(look[0] * look[0] + look[1] * look[1] + look[2] * look[2]);
+    for (int i = 0; i < 3; i++){
+        look[i] /= length;
+        camera.eye[i] = 0.0f;
+        camera.target[i] = look[i];
+    }
+
+    //straight up, square to the view, then turned around it by the canvas' rotation
+    float up[3] = { -look[0] * look[1], 1.0f - look[1] * look[1], -look[2] * look[1] };
+    length = sqrtf(up[0] * up[0] + up[1] * up[1] + up[2] * up[2]);
+    for (int i = 0; i < 3; i++){
+        up[i] /= length;
+    }
+    float side[3] = { look[1] * up[2] - look[2] * up[1], look[2] * up[0] - look[0] * up[2], look[0] * up[1] - look[1] * up[0] };
+    float roll = (90.0f - pose.pitch) * (float)M_PI / 180.0f;
+    for (int i = 0; i < 3; i++){
+        camera.up[i] = up[i] * cosf(roll) - side[i] * sinf(roll);
+    }
+
+    camera.fov = 2.0f * atanf(grid.screenWidth / 2.0f / mesh.radius) * 180.0f / (float)M_PI;
+    camera.nearClip = 1.0f;
+    camera.farClip = 2.0f * mesh.radius + mesh.panoramaHeight;
+    return camera;
+}
+
+//Planes a x + b y + c z + d >= 0 bounding what a camera sees
+struct Frustum {
+    float planes[6][4];
+};
+
+//the frustum of a projection * view matrix (column major, as GL and Cinder keep them)
+inline Frustum frustumFrom(const float m[16])
+{
+    Frustum frustum;
+    for (int p = 0; p < 6; p++){
+        int row = p / 2;
+        float sign = p % 2 == 0 ? 1.0f : -1.0f;
+        for (int i = 0; i < 4; i++){
+            frustum.planes[p][i] = m[i * 4 + 3] + sign * m[i * 4 + row];
+        }
+    }
+    return frustum;
+}
+
+//if any of the box is inside the frustum (boxes near a corner may be kept when they are just outside)
+inline bool boxInFrustum(const Frustum &frustum, const float low[3], const float high[3])
+{
+    for (int p = 0; p < 6; p++){
+        const float *plane = frustum.planes[p];
+        float distance = plane[3];
+        for (int i = 0; i < 3; i++){
+            distance += plane[i] * (plane[i] > 0.0f ? high[i] : low[i]);
+        }
+        if (distance < 0.0f){
+            return false;
+        }
+    }
+    return true;
+}
+
+//the strips (indexes into mesh.tiles) inside the frustum
+inline void cullCylinder(const CylinderMesh &mesh, const Frustum &frustum, std::vector<int> &visible)
+{
+    visible.clear();
+    for (int s = 0; s < (int)mesh.tiles.size(); s++){
+        if (boxInFrustum(frustum, &mesh.bounds[s * 6], &mesh.bounds[s * 6 + 3])){
+            visible.push_back(s);
+        }
+    }
+}
+
+//where a point on the canvas (ghost surface coordinates, with the copied edge) is on the cylinder
+inline void cylinderPoint(const CylinderMesh &mesh, float canvasX, float canvasY, float point[3])
+{
+    float angle = 2.0f * (float)M_PI * (canvasX - 1024.0f) / mesh.panoramaWidth;
+    point[0] = mesh.radius * sinf(angle);
+    point[1] = mesh.panoramaHeight / 2.0f - canvasY;
+    point[2] = -mesh.radius * cosf(angle);
+}
+
+//where an item the draw list put on the canvas (an indicator) is on the cylinder
+inline void cylinderItemPoint(const CylinderMesh &mesh, const DrawList &list, const CanopyGrid &grid, const CanopyPose &pose, const DrawItem &item,
+                              float point[3])
+{
+    //undoes buildCanopyDrawList()'s move to the live window
+    cylinderPoint(mesh, item.x - pose.xOffset + list.canvasX, item.y - pose.yOffset + list.canvasY + grid.screenHeight, point);
+}
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <math.h>
+
+//Counts values below a bound in any range of a sequence in O(log n) using per-level prefix counts
+class WaveletMatrix {
+public:
+    WaveletMatrix() : bits(0), n(0) {}
+
+    //values must be in [0, limit)
+    void build(const std::vector<int> &values, int limit) {
+        n = values.size();
+        bits = 1;
+        while ((1 << bits) < limit){
+            bits++;
+        }
+        zerosBefore.assign(bits, std::vector<int>(n + 1, 0));
+        zeros.assign(bits, 0);
+
+        std::vector<int> cur(values);
+        std::vector<int> next(n);
+        for (int level = 0; level < bits; level++){
+            int bit = bits - 1 - level;
+            std::vector<int> &prefix = zerosBefore[level];
+            for (int i = 0; i < n; i++){
+                prefix[i + 1] = prefix[i] + (((cur[i] >> bit) & 1) == 0);
+            }
+            zeros[level] = prefix[n];
+
+            //stable split: values with a 0 at this bit first
+            int z = 0;
+            int o = zeros[level];
+            for (int i = 0; i < n; i++){
+                if ((cur[i] >> bit) & 1){
+                    next[o++] = cur[i];
+                }
+                else{
+                    next[z++] = cur[i];
+                }
+            }
+            cur.swap(next);
+        }
+    }
+
+    //how many values in positions [l, r) are less than k
+    int countLess(int l, int r, int k) const {
+        if (l >= r || k <= 0){
+            return 0;
+        }
+        if (k >= (1 << bits)){
+            return r - l;
+        }
+        int result = 0;
+        for (int level = 0; level < bits; level++){
+            int bit = bits - 1 - level;
+            const std::vector<int> &prefix = zerosBefore[level];
+            int l0 = prefix[l];
+            int r0 = prefix[r];
+            if ((k >> bit) & 1){
+                result += r0 - l0;
+                l = zeros[level] + (l - l0);
+                r = zeros[level] + (r - r0);
+            }
+            else{
+                l = l0;
+                r = r0;
+            }
+        }
+        return result;
+    }
+
+private:
+    int bits;
+    int n;
+    std::vector< std::vector<int> > zerosBefore; //per level, how many 0 bits come before each position
+    std::vector<int> zeros; //per level, how many 0 bits there are
+};
+
+//Answers how many data objects are above, below, left and right of the screen
+//Objects are sorted by their position around the panorama, so each count is a range query
+//The panorama wraps around, and objects on the seam are only counted once
+class DirectionIndex {
+public:
+    DirectionIndex() : period(0) {}
+
+    //period is the width of the panorama without the copied edge
+    void build(const int *offX, const int *offY, const int *copiedBy, int count, int period) {
+        this->period = period;
+
+        std::vector< std::pair<int, int> > objects; //(angular position, height)
+        objects.reserve(count);
+        for (int i = 0; i < count; i++){
+            if (copiedBy[i] == -2){ //the seam copy is the same object
+                continue;
+            }
+            int a = offX[i] % period;
+            if (a < 0){
+                a += period;
+            }
+            objects.push_back(std::make_pair(a, offY[i]));
+        }
+        std::sort(objects.begin(), objects.end());
+
+        int n = objects.size();
+        angles.resize(n);
+        heights.resize(n);
+        for (int i = 0; i < n; i++){
+            angles[i] = objects[i].first;
+            heights[i] = objects[i].second;
+        }
+        std::sort(heights.begin(), heights.end());
+        heights.erase(std::unique(heights.begin(), heights.end()), heights.end());
+
+        //heights in angular order, as ranks so the matrix stays small
+        std::vector<int> ranks(n);
+        for (int i = 0; i < n; i++){
+            ranks[i] = std::lower_bound(heights.begin(), heights.end(), objects[i].second) - heights.begin();
+        }
+        heightRanks.build(ranks, heights.size() + 1);
+    }
+
+    //counts objects within nearRange of the screen's left edge, split by where they are relative to the screen
+    void count(float pixelXOffset, float pixelYOffset, float nearRange, float screenWidth, float screenHeight,
+               int &top, int &bottom, int &left, int &right) const {
+        top = bottom = left = right = 0;
+        if (angles.empty() || period <= 0){
+            return;
+        }
+
+        //positions are measured from the screen's left edge, wrapping half a panorama either side of the screen's center
+        float edge = -pixelXOffset;
+        float lowest = screenWidth / 2 - period / 2.0f;
+        float highest = lowest + period;
+        float nearLow = std::max(-nearRange, lowest);
+        float nearHigh = std::min(nearRange, highest);
+
+        //the ends of the wrapped range are the same point, so when the near range reaches it it counts on the left
+        left = countBetween(edge, nearLow, std::min(0.0f, nearHigh), -nearRange < lowest);
+        right = countBetween(edge, std::max(screenWidth, nearLow), nearHigh, false);
+
+        //objects in the screen's columns are above or below it
+        float columnLow = std::max(0.0f, nearLow);
+        float columnHigh = std::min(screenWidth, nearHigh);
+        if (columnLow < columnHigh){
+            int ranges[4];
+            int rangeCount = indexRanges(edge, columnLow, columnHigh, false, ranges);
+            int belowTop = std::lower_bound(heights.begin(), heights.end(), -pixelYOffset) - heights.begin(); //heights < -pixelYOffset
+            int notBottom = std::upper_bound(heights.begin(), heights.end(), screenHeight - pixelYOffset) - heights.begin(); //heights <= screenHeight - pixelYOffset
+            for (int r = 0; r < rangeCount; r++){
+                int l = ranges[r * 2];
+                int h = ranges[r * 2 + 1];
+                top += heightRanks.countLess(l, h, belowTop);
+                bottom += (h - l) - heightRanks.countLess(l, h, notBottom);
+            }
+        }
+    }
+
+private:
+    //objects between edge + low (included if includeLow) and edge + high (high - low is at most one period)
+    int countBetween(float edge, float low, float high, bool includeLow) const {
+        if (low >= high){
+            return 0;
+        }
+        int ranges[4];
+        int rangeCount = indexRanges(edge, low, high, includeLow, ranges);
+        int total = 0;
+        for (int r = 0; r < rangeCount; r++){
+            total += ranges[r * 2 + 1] - ranges[r * 2];
+        }
+        return total;
+    }
+
+    //converts the interval (edge + low, edge + high) around the panorama, closed at low if includeLow, into up to two ranges of sorted positions
+    int indexRanges(float edge, float low, float high, bool includeLow, int *ranges) const {
+        float start = edge + low;
+        float shift = floor(start / period) * period;
+        start -= shift;
+        float end = edge + high - shift;
+
+        int n = angles.size();
+        int first = includeLow ? firstNotBelow(start) : firstAbove(start);
+        if (end <= period){
+            ranges[0] = first;
+            ranges[1] = firstNotBelow(end);
+            return ranges[0] < ranges[1] ? 1 : 0;
+        }
+        ranges[0] = first;
+        ranges[1] = n;
+        ranges[2] = 0;
+        ranges[3] = std::min(firstNotBelow(end - period), ranges[0]);
+        return 2;
+    }
+
+    int firstAbove(float v) const {
+        return std::upper_bound(angles.begin(), angles.end(), v) - angles.begin();
+    }
+
+    int firstNotBelow(float v) const {
+        return std::lower_bound(angles.begin(), angles.end(), v) - angles.begin();
+    }
+
+    int period;
+    std::vector<int> angles; //sorted angular positions of the objects
+    std::vector<int> heights; //distinct heights of the objects, sorted
+    WaveletMatrix heightRanks; //height rank of each object in angular order
+};
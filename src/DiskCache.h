@@ -0,0 +1,142 @@
+#pragma once
+
+//Keeps downloads on disk between runs, keyed by a URL or a content hash
+//  - each entry is one file: the server's tag (ETag) on the first line, then the bytes
+//  - entries are written under a temporary name and renamed, so a crash never leaves half of one
+//  - trim() deletes the least recently read entries once the cache is over its limit
+//Not thread safe; CanopyLoader only uses it from its I/O thread.
+//
+//  cache.open(directory);
+//  if (!cache.read(url, bytes, &tag)) ...download..., cache.write(url, bytes, etag);
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+class DiskCache {
+public:
+    //64-bit FNV-1a of text as 16 hex digits, for naming entries and hashing content
+    static std::string hash(const std::string &text) {
+        unsigned long long h = 14695981039346656037ULL;
+        for (size_t i = 0; i < text.size(); i++){
+            h = (h ^ (unsigned char)text[i]) * 1099511628211ULL;
+        }
+        char hex[17];
+        snprintf(hex, sizeof(hex), "%016llx", h);
+        return hex;
+    }
+
+    //creates the directory (and its parents) if needed; false leaves the cache off
+    bool open(const std::string &directory) {
+        dir.clear();
+        if (directory.empty()){
+            return false;
+        }
+        std::string path = directory[directory.size() - 1] == '/' ? directory : directory + "/";
+        for (size_t slash = path.find('/', 1); slash != std::string::npos; slash = path.find('/', slash + 1)){
+            if (mkdir(path.substr(0, slash).c_str(), 0755) != 0 && errno != EEXIST){
+                return false;
+            }
+        }
+        dir = path;
+        return true;
+    }
+
+    bool enabled() const {
+        return !dir.empty();
+    }
+
+    //false if there is no entry for key
+    bool read(const std::string &key, std::string &bytes, std::string *tag = 0) {
+        if (!enabled()){
+            return false;
+        }
+        std::string path = pathFor(key);
+        FILE *file = fopen(path.c_str(), "rb");
+        if (!file){
+            return false;
+        }
+        std::string contents;
+        char buffer[16384];
+        size_t n;
+        while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0){
+            contents.append(buffer, n);
+        }
+        fclose(file);
+
+        size_t newline = contents.find('\n');
+        if (newline == std::string::npos){
+            return false;
+        }
+        if (tag){
+            *tag = contents.substr(0, newline);
+        }
+        bytes = contents.substr(newline + 1);
+        utimes(path.c_str(), 0); //marks it as recently used for trim()
+        return true;
+    }
+
+    bool write(const std::string &key, const std::string &bytes, const std::string &tag = "") {
+        if (!enabled() || tag.find('\n') != std::string::npos){
+            return false;
+        }
+        std::string path = pathFor(key);
+        std::string temporary = path + ".part";
+        FILE *file = fopen(temporary.c_str(), "wb");
+        if (!file){
+            return false;
+        }
+        bool ok = fwrite(tag.data(), 1, tag.size(), file) == tag.size() && fputc('\n', file) != EOF &&
+                  fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+        ok = fclose(file) == 0 && ok;
+        if (!ok || rename(temporary.c_str(), path.c_str()) != 0){
+            unlink(temporary.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    //deletes the least recently read entries until the cache holds at most maxBytes
+    void trim(size_t maxBytes) {
+        if (!enabled()){
+            return;
+        }
+        DIR *listing = opendir(dir.c_str());
+        if (!listing){
+            return;
+        }
+        std::vector< std::pair<time_t, std::pair<std::string, size_t> > > entries;
+        size_t total = 0;
+        while (dirent *entry = readdir(listing)){
+            std::string name = entry->d_name;
+            struct stat info;
+            if (name[0] == '.' || stat((dir + name).c_str(), &info) != 0 || !S_ISREG(info.st_mode)){
+                continue;
+            }
+            entries.push_back(std::make_pair(info.st_mtime, std::make_pair(name, (size_t)info.st_size)));
+            total += info.st_size;
+        }
+        closedir(listing);
+
+        std::sort(entries.begin(), entries.end());
+        for (size_t i = 0; i < entries.size() && total > maxBytes; i++){
+            if (unlink((dir + entries[i].second.first).c_str()) == 0){
+                total -= entries[i].second.second;
+            }
+        }
+    }
+
+private:
+    std::string pathFor(const std::string &key) const {
+        return dir + hash(key) + ".cache";
+    }
+
+    std::string dir; //ends in '/', empty while the cache is off
+};
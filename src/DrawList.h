@@ -0,0 +1,116 @@
+#pragma once
+
+//What one canopy frame draws, built by the simulation step and submitted by draw()
+//Items only say what to draw and where, so a frame can be built, compared and timed without GL.
+//Tiles and indicators are on the canvas, which is turned by pitch and moved by canvasX/canvasY;
+//everything else is in screen coordinates. Items are drawn in the order they were added.
+//
+//  list.clear(); list.add(DrawItem::TILE, slot, x, y, w, h);  //update()
+//  for (...) draw(list[i]);                                   //draw()
+
+#include <vector>
+#include <stddef.h>
+#include <math.h>
+
+struct DrawItem {
+    enum Kind {
+        TILE,      //panorama tile; texture is its slot in the live window
+        INDICATOR, //data object marker; texture is 1 while the object is being scanned
+        SCANNING,  //"Scanning..." label
+        BUTTON,    //screen button; texture is a DrawList::Button
+        SCAN_BOX,  //outline of the scanning box
+        TOO_LOW,   //the view is below the panorama (clears what was drawn before it)
+        TOO_HIGH,  //the view is above the panorama (clears what was drawn before it)
+        OVERLAY,   //description and portal image; texture is the shown projection
+        ARROW      //searching arrow toward objects off screen
+    };
+
+    Kind kind;
+    int texture;
+    float x;
+    float y;
+    float width;
+    float height;
+    float angle; //degrees
+
+    bool onCanvas() const {
+        return kind == TILE || kind == INDICATOR;
+    }
+};
+
+class DrawList {
+public:
+    enum Button {
+        PAUSE,
+        PLAY,
+        CALIBRATE,
+        SWITCH_PANORAMA
+    };
+
+    float pitch; //degrees the canvas is turned by
+    float canvasX; //where the canvas is moved to
+    float canvasY;
+
+    DrawList() {
+        clear();
+    }
+
+    void clear() {
+        items.clear();
+        pitch = 0.0f;
+        canvasX = 0.0f;
+        canvasY = 0.0f;
+    }
+
+    void add(DrawItem::Kind kind, int texture = 0, float x = 0.0f, float y = 0.0f, float width = 0.0f, float height = 0.0f, float angle = 0.0f) {
+        DrawItem item;
+        item.kind = kind;
+        item.texture = texture;
+        item.x = x;
+        item.y = y;
+        item.width = width;
+        item.height = height;
+        item.angle = angle;
+        items.push_back(item);
+    }
+
+    size_t size() const {
+        return items.size();
+    }
+
+    const DrawItem &operator[](size_t i) const {
+        return items[i];
+    }
+
+    //changes whenever anything drawn would (positions to a sixteenth of a pixel), for comparing frames
+    unsigned hash() const {
+        unsigned h = 2166136261u;
+        mix(h, pitch);
+        mix(h, canvasX);
+        mix(h, canvasY);
+        for (size_t i = 0; i < items.size(); i++){
+            const DrawItem &item = items[i];
+            mix(h, item.kind);
+            mix(h, item.texture);
+            mix(h, item.x);
+            mix(h, item.y);
+            mix(h, item.width);
+            mix(h, item.height);
+            mix(h, item.angle);
+        }
+        return h;
+    }
+
+private:
+    static void mix(unsigned &h, int value) {
+        for (int b = 0; b < 4; b++){
+            h = (h ^ ((value >> (b * 8)) & 0xff)) * 16777619u;
+        }
+    }
+
+    static void mix(unsigned &h, float value) {
+        mix(h, (int)floorf(value * 16.0f + 0.5f));
+    }
+
+    std::vector<DrawItem> items;
+};
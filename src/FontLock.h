@@ -0,0 +1,33 @@
+#pragma once
+
+//Cinder's Font and its FontManager aren't documented as thread safe, so text is only laid out and drawn while holding this lock
+//The asset threads, the loader's decode thread and the main thread all render text, so each takes it around its fonts
+//
+//  {
+//      FontLock lock;
+//      ci::TextLayout layout;
+//      layout.setFont(ci::Font("Arial", 20));
+//      ...
+//  }
+
+#include <pthread.h>
+
+class FontLock {
+public:
+    FontLock() {
+        pthread_mutex_lock(&mutex());
+    }
+
+    ~FontLock() {
+        pthread_mutex_unlock(&mutex());
+    }
+
+private:
+    static pthread_mutex_t &mutex() {
+        static pthread_mutex_t m = PTHREAD_MUTEX_INITIALIZER;
+        return m;
+    }
+
+    FontLock(const FontLock &);
+    FontLock &operator=(const FontLock &);
+};
@@ -0,0 +1,146 @@
+#pragma once
+
+//Picks a render quality level that keeps frames within their time budget
+//  - level 0 is full quality; each level above it is cheaper to draw (the app decides what each one turns down)
+//  - each drawn frame reports its load: the time it took as a share of its budget (1.0 is exactly on budget)
+//  - quality drops a level when the slowest frames of the last window are over budget,
+//    and rises a level when even they have left plenty of room for a while
+//  - a rise that has to be undone soon after makes the next rise wait twice as long, so quality doesn't flap
+//Every change is logged with the load that caused it. Used from the main thread only.
+//
+//  mGovernor.addFrame(Log::now(), frameSeconds / budgetSeconds);
+//  if (mGovernor.changed()) ...apply mGovernor.level()...
+
+#include <vector>
+#include <algorithm>
+#include "Log.h"
+
+class FrameGovernor {
+public:
+    FrameGovernor(int levels = 1) : levelCount(levels), window(30), over(1.0f), under(0.5f), dropDelay(1.0), riseDelay(5.0), maxRiseDelay(60.0) {
+        reset();
+    }
+
+    void setLevels(int levels) {
+        levelCount = std::max(1, levels);
+        currentLevel = std::min(currentLevel, levelCount - 1);
+    }
+
+    //frames whose slowest tenth decides a change
+    void setWindow(int frames) {
+        window = std::max(1, frames);
+        loads.clear();
+    }
+
+    //load above which quality drops, and below which it may rise again
+    void setThresholds(float overLoad, float underLoad) {
+        over = overLoad;
+        under = underLoad;
+    }
+
+    //seconds a level is kept at least before dropping, and before rising
+    void setDelays(double drop, double rise) {
+        dropDelay = drop;
+        riseDelay = rise;
+        currentRiseDelay = rise;
+    }
+
+    //back to full quality, as if no frames had been drawn
+    void reset() {
+        currentLevel = 0;
+        loads.clear();
+        next = 0;
+        lastChange = -1.0;
+        lastRise = -1.0;
+        currentRiseDelay = riseDelay;
+        levelChanged = false;
+        changes = 0;
+    }
+
+    //adds a drawn frame's load and changes level if the window calls for it
+    void addFrame(double now, float load) {
+        if (lastChange < 0.0){
+            lastChange = now;
+        }
+        if ((int)loads.size() < window){
+            loads.push_back(load);
+        }
+        else{
+            loads[next] = load;
+        }
+        next = (next + 1) % window;
+        if ((int)loads.size() < window){
+            return;
+        }
+
+        float slow = slowLoad();
+        if (slow > over && currentLevel < levelCount - 1 && now - lastChange >= dropDelay){
+            //the last rise didn't hold, so the next one waits longer
+            if (lastRise >= 0.0 && now - lastRise < currentRiseDelay){
+                currentRiseDelay = std::min(currentRiseDelay * 2.0, maxRiseDelay);
+            }
+            change(now, currentLevel + 1, slow);
+        }
+        else if (slow < under && currentLevel > 0 && now - lastChange >= currentRiseDelay){
+            lastRise = now;
+            change(now, currentLevel - 1, slow);
+        }
+        else if (lastRise >= 0.0 && now - lastRise >= maxRiseDelay){
+            currentRiseDelay = riseDelay; //the level has held, so rises are tried at the normal pace again
+            lastRise = -1.0;
+        }
+    }
+
+    int level() const {
+        return currentLevel;
+    }
+
+    //if the level changed since the last call
+    bool changed() {
+        bool result = levelChanged;
+        levelChanged = false;
+        return result;
+    }
+
+    //times the level has changed since reset()
+    int changeCount() const {
+        return changes;
+    }
+
+private:
+    //the load only a tenth of the window's frames went over
+    float slowLoad() const {
+        std::vector<float> sorted(loads);
+        size_t n = sorted.size() * 9 / 10;
+        std::nth_element(sorted.begin(), sorted.begin() + n, sorted.end());
+        return sorted[n];
+    }
+
+    void change(double now, int level, float slow) {
+        LOG_INFO("frame governor: quality level %d -> %d (slowest frames at %.0f%% of budget, next rise after %.0f s)",
+                 currentLevel, level, slow * 100.0f, currentRiseDelay);
+        currentLevel = level;
+        lastChange = now;
+        loads.clear();
+        next = 0;
+        levelChanged = true;
+        changes++;
+    }
+
+    int levelCount;
+    int window;
+    float over;
+    float under;
+    double dropDelay;
+    double riseDelay;
+    double maxRiseDelay;
+
+    int currentLevel;
+    std::vector<float> loads; //ring of the last window's loads
+    int next; //where the next load goes in loads
+    double lastChange; //when the level last changed (-1 before the first frame)
+    double lastRise; //when quality last rose (-1 if it hasn't since it last held)
+    double currentRiseDelay;
+    bool levelChanged;
+    int changes;
+};
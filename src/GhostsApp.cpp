@@ -2,18 +2,39 @@
 #include "cinder/Camera.h"
 #include "cinder/gl/Texture.h"
 #include "cinder/gl/gl.h"
+#include "cinder/gl/Fbo.h"
 #include "cinder/Capture.h"
 #include "cinder/ImageIo.h"
 #include "cinder/Rand.h"
 #include "cinder/Xml.h"
+#include "cinder/ip/Resize.h"
+#include "cinder/Thread.h"
+#include "cinder/Utilities.h"
 #include <vector>
 #include <map>
 #include <list>
 #include <sstream>
+#include <stdexcept>
 #include <stdio.h>
 #include <math.h>
+#include <sys/stat.h>
 #include "cinder/Text.h"
 #include "cinder/Font.h"
+#include "ProjectionKernels.h"
+#include "DirectionIndex.h"
+#include "Log.h"
+#include "LoadProfile.h"
+#include "CanopyLoader.h"
+#include "TripleBuffer.h"
+#include "CanopyView.h"
+#include "MemoryBudget.h"
+#include "FrameGovernor.h"
+#include "CanopyCatalogue.h"
+#include "AssetManager.h"
+#include "PixelFormats.h"
+#include "CylinderView.h"
+#include "Trace.h"
+#include "FontLock.h"
 
 using namespace std;
 using namespace ci;
@@ -25,26 +46,131 @@ int TILE_WIDTH = 256; //must be a factor of 1024 for math to work out
 int TILE_HEIGHT = 2048; //must be a factor of 1024 for math to work out
 int SCREEN_ROWS = ceil(SCREEN_HEIGHT / TILE_HEIGHT) + 2;
 int SCREEN_COLS = ceil(SCREEN_WIDTH / TILE_WIDTH) + 2;
-int LOWEST_ROW = 0;
 
-int ISREADY = false;
+string SERVICES_URL = "http://ghosts.slifty.com/services/"; //where canopies are loaded from (point at tools/standin_server to benchmark)
+int BENCHMARK_RUNS = 0; //if more than 0, loads BENCHMARK_CANOPY this many times and logs how long each load stage took
+int BENCHMARK_CANOPY = -1; //canopy to benchmark (-1 is the first one on the server)
+bool TRACE_LOADS = false; //writes each load's spans on every thread to Documents/traces/load_<canopy>_<n>.json (open in chrome://tracing)
+
+double HTTP_TIMEOUT = 15.0; //seconds to wait for a connection or for more of a response
+int HTTP_RETRIES = 3; //times a failed request is tried again
+double HTTP_BACKOFF = 0.5; //seconds before the first retry, doubled for each one after
+double LIST_RETRY_DELAY = 5.0; //seconds before asking an unreachable server for the canopy list again
+int CATALOGUE_ROWS = 14; //canopies listed per page of the load screen
+int CATALOGUE_PAGES_KEPT = 4; //rendered catalogue pages kept for turning back to (one while memory is short)
+double LOAD_APPLY_SECONDS = 0.008; //time per frame the main thread spends applying what the loader finished
+
+bool PROGRESSIVE_PANORAMA = true; //shows a low resolution panorama while the full one downloads
+int PREVIEW_SCALE = 8; //the preview is this many times smaller than the panorama in each direction
+int FULL_TILES_PER_FRAME = 4; //full resolution tiles swapped in per frame once the full panorama has arrived
+
+int MEMORY_BUDGET_MB = 0; //memory the app's images and textures may use (0 uses MEMORY_BUDGET_SHARE of the device's memory)
+float MEMORY_BUDGET_SHARE = 0.4f; //share of the device's memory used as the budget
+
+int ASSET_THREADS = 2; //threads the interface images and labels are decoded on at startup
+
+int DISK_CACHE_MB = 64; //manifests and portal images kept on disk between runs (0 turns the cache off)
+
+bool USE_BUNDLES = true; //loads a canopy from Documents/bundles/canopy_<id>.bundle (made by tools/bundle_compiler) when it is there
+
+int PORTAL_MAX_WIDTH = 450; //largest portal image the overlay has room for; bigger ones are shrunk when decoded
+int PORTAL_MAX_HEIGHT = 450;
+
+PixelFormat TILE_FORMAT = PIXELS_AUTO; //format tiles are kept in (PIXELS_AUTO: L8 for black and white canopies, RGB565 otherwise; PIXELS_ETC1 needs GPU support)
+PixelFormat PORTAL_FORMAT = PIXELS_RGB565; //format portal images are uploaded in
+
+bool CYLINDER_VIEW = false; //draws the panorama on a cylinder seen through mCam; the tiles drawn are the ones left after frustum culling
+
+bool RENDER_ON_DEMAND = true; //re-presents the last frame instead of redrawing when nothing on screen has changed
+float ROTATION_THRESHOLD = 0.002; //smallest gyro change (radians) that counts as movement
+float ACTIVE_FRAME_RATE = 60.0f; //frame rate while the view is changing
+float IDLE_FRAME_RATE = 15.0f; //frame rate while the last frame is being re-presented
+
+bool GOVERN_QUALITY = true; //turns render quality down while frames take longer than FRAME_BUDGET_MS, and back up once there is room
+float FRAME_BUDGET_MS = 16.0f; //time update() and draw() may take for one frame at ACTIVE_FRAME_RATE
+
+double SIM_STEP = 1.0 / 120.0; //seconds the canopy view is advanced by per step
+int SIM_MAX_STEPS = 8; //steps per frame at most on top of a frame's worth at the current frame rate; a longer stall is skipped rather than caught up
+
+//Render quality levels the frame governor moves between, each turning down one more thing than the one before
+enum RenderQuality {
+    FULL_QUALITY,
+    BATCHED_INDICATORS, //indicators are drawn with one call per icon (the scanned one ends up above the others)
+    HALF_PORTAL_IMAGES, //portal images are uploaded at half size and drawn stretched
+    HALF_FRAME_RATE,    //the view is drawn at half ACTIVE_FRAME_RATE
+    LOWER_TILES,        //tiles are one pyramid level smaller (canopies loaded from a bundle only)
+    QUALITY_COUNT
+};
+
+//The app's own images and labels, loaded once by mAssets
+enum AssetId {
+    ASSET_INDICATOR,
+    ASSET_INDICATOR_SCANNED,
+    ASSET_PAUSE,
+    ASSET_PLAY,
+    ASSET_CALIBRATE,
+    ASSET_SWITCH_PANORAMA,
+    ASSET_NUMBER_PAD, //1-9, Back, 0, Go
+    ASSET_LOADING_PANORAMA = ASSET_NUMBER_PAD + 12,
+    ASSET_COUNT
+};
 
 //Structure that contains information on a data object in the panorama
+//Only needed when the object is loaded or displayed; its position is kept in ProjectionPositions
 struct Projection {
     int id;
-    int offX;
-    int offY;
     int height;
     int width;
-    Surface imageFile;
+    Surface imageFile; //portal image, no larger than the overlay shows it
+    gl::Texture imageTexture; //imageFile uploaded while the object is near the view
     vector<string> textLines;
     vector<string> captionLines;
-    TextLayout info;
-    TextLayout caption;
     gl::Texture infoImage;
     gl::Texture captionImage;
-    int copiedBy;
     bool hasImage;
+    bool imageRequested; //if imageFile is being loaded
+    bool imageMapped; //if imageFile wraps the bundle's mapped pixels (not counted in the budget, never evicted)
+    string imageHash; //content hash of the portal image (empty if the server doesn't give one)
+};
+
+//Orientation handed from the sensor callback to the renderer
+struct ViewState {
+    Vec3f rotation;
+};
+
+//Positions of the data objects on the canvas, read every frame by the visibility and scan passes
+//Kept as parallel arrays so those passes only touch the coordinates
+//Objects on the seam are listed twice but share one Projection record
+struct ProjectionPositions {
+    vector<int> offX;
+    vector<int> offY;
+    vector<int> copiedBy; //index of the seam copy (-1 if not copied, -2 if this is the copy)
+    vector<int> data; //index of the object's Projection record
+    
+    int size() const {
+        return offX.size();
+    }
+    
+    void clear() {
+        offX.clear();
+        offY.clear();
+        copiedBy.clear();
+        data.clear();
+    }
+    
+    void reserve(int n) {
+        offX.reserve(n);
+        offY.reserve(n);
+        copiedBy.reserve(n);
+        data.reserve(n);
+    }
+    
+    void add(int x, int y, int copy, int dataIndex) {
+        offX.push_back(x);
+        offY.push_back(y);
+        copiedBy.push_back(copy);
+        data.push_back(dataIndex);
+    }
 };
 
 class GhostsApp : public AppCocoaTouch {
@@ -56,6 +182,66 @@ public:
 	virtual void	draw();
     
     void reset();
+    void request(const LoadJob &job);
+    void requestCanopyList();
+    void requestCanopy();
+    string bundlePath(int id);
+    bool useBundle();
+    int bundleTileLevel();
+    void uploadBundleTiles(int level);
+    void applyLoadResults();
+    void applyCanopyList(const LoadResult &result);
+    void applyManifest(const LoadResult &result);
+    void applyPanorama(const LoadResult &result);
+    void applyPortalImage(const LoadResult &result);
+    void canopyReady();
+    void finishLoadRun();
+    void writeLoadTrace();
+    void failLoad(const string &message);
+    void drawLoadError();
+    void loadAssets();
+    void drawLoadingPanorama();
+    gl::Texture &cataloguePageTexture();
+    void releasePageTextures(int keep);
+    void logHttpStats();
+    void updatePanorama();
+    int fullPanoramaScale();
+    string panoramaUrl(int scale);
+    LoadJob panoramaJob(int scale);
+    PixelFormat cutFormat();
+    gl::Texture packedTexture(const PackedPixels &packed);
+    gl::Texture packedTexture(const unsigned char *pixels, int rowBytes, int pixelBytes, int r, int g, int b, int width, int height, PixelFormat format);
+    gl::Texture packedTexture(const Surface &surface, const Area &area, PixelFormat format);
+    string portalUrl(int id);
+    void chooseTileFormat(bool grey);
+    void logTiles(double seconds);
+    gl::Texture tileFrom(const Surface &image, int t);
+    gl::Texture bundleTile(int level, int t);
+    gl::Texture previewTile(int t);
+    size_t tileBytes(const gl::Texture &tile);
+    void setTile(int t, const gl::Texture &texture, bool full);
+    bool tileIsLive(int t);
+    void enforceMemoryBudget();
+    void ensurePortalImage(int p);
+    gl::Texture &portalTexture(int p);
+    void releaseFarPortalTextures();
+    bool stepView();
+    void buildDrawList();
+    CanopyGrid canopyGrid();
+    void drawCanopy();
+    void aimCylinder(const CanopyPose &pose);
+    void drawCylinder();
+    void drawCylinderIndicator(const DrawItem &item);
+    void drawOverlay(const DrawItem &item);
+    size_t drawIndicators(size_t first);
+    float activeFrameRate();
+    float portalScale();
+    void applyQuality();
+    bool viewIsStatic();
+    void presentLastFrame();
+    void drawLoadScreen();
+    void drawLoadScreenLayer();
+    void drawLoadScreenText();
     
     void	touchesBegan( TouchEvent event );
 	void	touchesMoved( TouchEvent event );
@@ -68,20 +254,39 @@ public:
     int               liveIndex; // The upper left quad index
     vector<gl::Texture>   mLiveTextures; // The four textures being rendered
     vector<gl::Texture>   mGhostSurfaces; // All the available ghost surfaces    
+    vector<Area>          mTileAreas; // The part of the panorama each ghost surface shows
+    TileStreamRef         mFullTiles; // The full panorama's tiles, packed by the loader, while they are swapped in
+    vector<int>           mPendingTiles; // Ghost surfaces still showing the preview, nearest the view last
+    vector<unsigned char> mTileFull; // If each ghost surface is cut from the full panorama rather than the preview
+    Surface               mPreview; // Low resolution panorama tiles drop back to when memory runs short
+    CanopyBundleRef       mBundle; // Compiled bundle the canopy was loaded from, if any (portal images point into it)
+    int                   mBundleLevel; // Largest bundle level the memory budget had room for
+    int                   mTileLevel; // Bundle level the tiles were uploaded from
+    PixelFormat           mTileFormat; // Format this canopy's tiles are kept in (PIXELS_AUTO until its first pixels arrive)
+    bool                  mEtc1Supported; // If the GPU takes ETC1 textures
+    bool                  mUnpackRowLength; // If GL can upload part of a bigger image straight from it (GL_UNPACK_ROW_LENGTH)
+    PackedPixels          mStaging; // Pixels packed for upload, reused for every tile
+    MemoryBudget          mBudget; // Memory held by surfaces and textures
     
-    vector<Projection>  mProjections;
+    vector<Projection>  mProjections; //loaded data objects
+    vector<int>         mPortalTextures; //projections whose portal image is uploaded
+    ProjectionPositions mPositions; //where each data object is on the canvas
+    vector<unsigned char> mVisible; //if each data object is on screen this frame
+    vector<unsigned char> mInBox; //if the center of the screen is in each data object's scanning box this frame
+    DirectionIndex mDirections; //data objects sorted around the panorama for the searching arrows
     bool                astralActivated;
     int                 whichAstral;
     float               astralShiftX;
     float               astralShiftY;
     
     int ghostWidth;
+    int panoramaWidth; //width of the panorama without the copied edge
     int ghostHeight;
     int ghostRows;
     int ghostCols;
     
-    int baseRow;
-    int baseCol;
+    int baseRow; //tile row at the top of the live window
+    int baseCol; //tile column at the left of the live window
     
     float capturePitch;
     float captureRoll;
@@ -121,6 +326,7 @@ public:
     bool isPaused; //if image shouldn't be updated
     bool recentlyTouched; //if the screen has been touched
     bool showScanBox; //if the scan box should be shown
+    bool showScanning; //if "Scanning..." should be shown
     
     int top; //used to track how many objects are above the screen
     int right; //used to track how many objects are to the right of screen
@@ -132,24 +338,67 @@ public:
     Vec3f rotation;
     
     bool onLoadScreen; //if on the load screen
-    vector<string> tableOfCanopies; //list of the canopies available
-    gl::Texture canopyIndexes; //textures of the canopy indecies
+    CanopyCatalogue mCatalogue; //the canopies on the server
+    int mCataloguePage; //page of the catalogue on the load screen
+    vector<gl::Texture> mPageTextures; //the rows of each catalogue page, rendered when the page is first shown (empty if not)
+    list<int> mPageOrder; //pages in mPageTextures, least recently shown first
+    gl::Fbo mLoadScreen; //the load screen but for the typed digits and messages
+    gl::Fbo mLoadScreenFrame; //mLoadScreen with the typed digits and messages drawn over it, drawn each frame
+    int mLoadScreenPage; //catalogue page mLoadScreen was drawn for (-1 if it needs drawing again)
+    string mLoadScreenText; //typed digits and messages mLoadScreenFrame was drawn with
     vector<gl::Texture> numberPadNumbers; //number pad textures
-    bool loadingIndexes; //if it should load the list of indecies
+    gl::Texture loadingPanorama; //"Loading Panorama..." message
     
-    int firstDigit;
-    int secondDigit;
+    CanopyIdInput mTypedId; //canopy ID typed on the number pad
     bool notVaildID;
     bool shouldUpdateImage;
     
-    float actuX; //the actual x position calculated by small delta moves
-    float currX; //the new X gyro reading
-    float prevX; //the old actual x position
-    
-    vector<int> canopiesOnServer; //list of ID numbers of canopies on the server 
+    YawTracker mYaw; //the yaw added up across its wrap
     
     int lastCanopyID; //previous canopy
     
+    LoadProfile mLoadProfile; //how long each stage of loading took (kept across resets)
+    CanopyLoader mLoader; //downloads and decodes on its own threads (kept across resets)
+    int mOutstandingJobs; //jobs requested from mLoader for this load that haven't come back
+    double mLoadStarted; //when the canopy was picked
+    bool mRunFinished; //if this load's timings have been logged
+    int mPortalsCached; //portal images this load found in the disk cache
+    int mPortalsDownloaded; //portal images this load downloaded
+    
+    //where loading is up to
+    enum LoadState {
+        LIST_NEEDED,    //the list of canopies should be requested
+        LIST_LOADING,   //waiting for the list of canopies
+        CHOOSING,       //the load screen is up
+        CANOPY_LOADING, //waiting for the canopy information and panorama
+        VIEWING         //the canopy is interactive (more of it may still be arriving)
+    };
+    LoadState mLoadState;
+    TripleBuffer<ViewState> mViewStates; //newest orientation from rotated()
+    string loadError; //why the last load failed, shown on the load screen
+    double listRetryTime; //when to ask for the canopy list again after it failed
+    
+    bool frameDirty; //if something other than orientation changed since the last drawn frame
+    bool hasLastFrame; //if lastFrame holds the view currently on screen
+    Vec3f lastDrawnRotation; //gyro reading the last frame was drawn from
+    gl::Fbo lastFrame; //copy of the last frame, re-presented while the view is static
+    
+    DrawList mDrawList; //the canopy frame, built by update() and submitted by draw()
+    Vec3f mDrawListRotation; //gyro reading mDrawList was built from
+    double mSimTime; //seconds the canopy view has been stepped through
+    double mSimLastTime; //elapsed time update() last ran at
+    double mSimBehind; //seconds the canopy view is behind real time (less than SIM_STEP once caught up)
+    
+    FrameGovernor mGovernor; //render quality for the frame time budget (kept across resets)
+    double mFrameStart; //when update() started stepping the view for the frame being drawn (0 if it didn't)
+    vector<float> mIndicatorVertices; //batched indicator quads
+    vector<float> mIndicatorCoords;
+    
+    CylinderMesh mCylinder; //the panorama wrapped around a cylinder (CYLINDER_VIEW only)
+    vector<int> mCylinderStrips; //strips of mCylinder inside mCam's frustum this frame
+    
+    AssetManager mAssets; //interface images and labels (kept across resets)
+    
 };
 
 void GhostsApp::reset(){ //resets the app so it can load a new panorama
@@ -157,8 +406,18 @@ void GhostsApp::reset(){ //resets the app so it can load a new panorama
     lastCanopyID = canopyID;
     mLiveTextures.clear();
     mGhostSurfaces.clear();
+    mLoader.cancel(); //anything still loading is ignored
+    mFullTiles.reset();
+    mPendingTiles.clear();
+    mTileFull.clear();
+    mPortalTextures.clear();
+    mPreview = Surface();
+    vector<unsigned char>().swap(mStaging.data);
+    mProjections.clear(); //portal images may point into the bundle
+    mBundle.reset();
+    mBudget.clear(); //everything is loaded again
     onLoadScreen = true;
-    ISREADY = false;
+    setFrameRate(activeFrameRate());
     disableRotation();
     shutdown();
     setup();
@@ -166,14 +425,26 @@ void GhostsApp::reset(){ //resets the app so it can load a new panorama
 
 void GhostsApp::setup()
 {
+    Log::start(console()); //writes log messages from a background thread
+    Trace::nameThread("main");
+    if (TRACE_LOADS){
+        Trace::start();
+    }
+    
     canopyID = -1; //indicates no canopy is loaded
     lastCanopyID = -1;
-    canopiesOnServer.resize(0);
+    mCatalogue = CanopyCatalogue();
+    mCatalogue.setRowsPerPage(CATALOGUE_ROWS);
+    mCataloguePage = 0;
+    mPageTextures.clear();
+    mPageOrder.clear();
+    mLoadScreenPage = -1;
     
     isPaused = false; //isn't paused
     isCalibrate = false; //isn't being calibrated
     recentlyTouched = false; //hasn't been touched recently
     showScanBox = false; //doesn't show scanning box
+    showScanning = false;
     
     dist = pow(150.0, 2) + pow(100.0, 2);//default biggest distance a scanned object can be from center
     
@@ -199,15 +470,46 @@ void GhostsApp::setup()
     baseCol = 0;
     
     onLoadScreen = true;
-    loadingIndexes = true;
+    mLoadState = LIST_NEEDED;
     shouldUpdateImage = true;
     
     //indicates no digits are entered
-    firstDigit = -1; 
-    secondDigit = -1;
+    mTypedId.clear();
     
     notVaildID = false; //looking for a valid ID
-    actuX = -1.0; //indicates no precious actual X is stored
+    mYaw.reset(); //no yaw has been read yet
+    
+    frameDirty = true; //nothing has been drawn yet
+    hasLastFrame = false;
+    mDrawList.clear();
+    mSimTime = 0.0;
+    mSimLastTime = getElapsedSeconds();
+    mSimBehind = 0.0;
+    
+    listRetryTime = 0.0;
+    
+    size_t deviceMemory = MemoryBudget::physicalMemory();
+    if (MEMORY_BUDGET_MB > 0){
+        mBudget.setLimit((size_t)MEMORY_BUDGET_MB << 20);
+    }
+    else if (deviceMemory > 0){
+        mBudget.setLimit((size_t)(deviceMemory * MEMORY_BUDGET_SHARE));
+    }
+    mLoader.http().setTimeout(HTTP_TIMEOUT);
+    mLoader.http().setRetries(HTTP_RETRIES, HTTP_BACKOFF);
+    if (DISK_CACHE_MB > 0){
+        mLoader.setCache(getHomeDirectory() + "Library/Caches/canopies", (size_t)DISK_CACHE_MB << 20);
+    }
+    mLoader.start();
+    mTileFormat = PIXELS_AUTO;
+    mEtc1Supported = hasGlExtension((const char *)glGetString(GL_EXTENSIONS), "GL_OES_compressed_ETC1_RGB8_texture");
+    mUnpackRowLength = hasUnpackRowLength((const char *)glGetString(GL_VERSION), (const char *)glGetString(GL_EXTENSIONS));
+    if (!mAssets.isStarted()){
+        loadAssets();
+    }
+    mOutstandingJobs = 0;
+    mGovernor.setLevels(QUALITY_COUNT);
+    mRunFinished = true;
     
     gl::setMatricesWindow( getWindowWidth(), getWindowHeight() ); //sets OpenGL to use the screen bounds
 }
@@ -217,19 +519,102 @@ void GhostsApp::prepareSettings( Settings *settings )
 	settings->enableMultiTouch();
 }
 
+//applies loads and the newest orientation, then steps the canopy view on a fixed timestep and lists what it looks like
 void GhostsApp::update() {
+    mFrameStart = 0.0; //not timed until the loads below are out of the way
+    mAssets.upload();
+    applyLoadResults();
+    
+    //takes the newest orientation from the sensor
+    if (mViewStates.update()){
+        rotation = mViewStates.read().rotation;
+        
+        //if touch is active, update image offsets
+        if (isCalibrate) {
+            modPitch = rotation.x - capturePitch;
+            modRoll = rotation.z - captureRoll;
+            modYaw = rotation.y - captureYaw;
+        }
+    }
+    
+    double now = getElapsedSeconds();
+    double elapsed = now - mSimLastTime;
+    mSimLastTime = now;
+    
+    if (onLoadScreen){
+        //asks for the list of canopies, again after a little while if the server couldn't be reached
+        if (mLoadState == LIST_NEEDED && now >= listRetryTime){
+            requestCanopyList();
+        }
+        if (mLoadState != CHOOSING){
+            return;
+        }
+        
+        //benchmarking picks the canopy itself
+        if (BENCHMARK_RUNS > mLoadProfile.completedRuns() && canopyID == -1 && !mCatalogue.empty() && loadError.empty()){
+            canopyID = BENCHMARK_CANOPY != -1 ? BENCHMARK_CANOPY : mCatalogue.id(0);
+        }
+        
+        //once a canopy has been selected, load it
+        if (canopyID != -1){
+            onLoadScreen = false;
+            requestCanopy();
+        }
+        return;
+    }
+    
+    if (mLoadState != VIEWING){
+        return;
+    }
+    enforceMemoryBudget(); //before updatePanorama() so the tiles on screen are known
+    updatePanorama();
+    
+    //the governor times the view's own work: uploads and swap-ins above come and go with loads
+    mFrameStart = Log::now();
+    
+    //a frame at the idle frame rate is several steps long, so only more than that counts as a stall
+    mSimBehind += elapsed;
+    int maxSteps = SIM_MAX_STEPS + (int)ceil(1.0 / (getFrameRate() * SIM_STEP));
+    int steps = 0;
+    bool changed = false;
+    while (mSimBehind >= SIM_STEP && steps < maxSteps){
+        if (stepView()){
+            changed = true;
+        }
+        mSimTime += SIM_STEP;
+        mSimBehind -= SIM_STEP;
+        steps++;
+    }
+    if (steps == maxSteps){
+        mSimBehind = 0.0;
+    }
+    
+    //a static view keeps the draw list it has
+    if (changed || frameDirty){
+        buildDrawList();
+        releaseFarPortalTextures();
+    }
+    
+    //uploads the scanned and shown objects' portal images here so draw() only draws: before the scanned one is shown,
+    //and again if a quality change or the budget dropped them (a frame with the image is drawn once it is ready)
+    int objects[] = { objectScanned, displayedObject };
+    for (int i = 0; i < 2; i++){
+        if (objects[i] == -1){
+            continue;
+        }
+        int p = mPositions.data[objects[i]];
+        if (!mProjections[p].imageTexture && portalTexture(p)){
+            frameDirty = true;
+        }
+    }
 }
 
 void GhostsApp::rotated( Vec3f rotation )
 {
-	this->rotation = rotation;
-    
-    //if touch is active, update image offsets
-    if (isCalibrate) {
-        modPitch = rotation.x - capturePitch;
-        modRoll = rotation.z - captureRoll;
-        modYaw = rotation.y - captureYaw;
-    }
+    //hands the reading to the renderer, which picks up the newest one each frame
+    ViewState state;
+    state.rotation = rotation;
+    mViewStates.write(state);
 }
 
 void GhostsApp::touchesBegan( TouchEvent event )
@@ -245,6 +630,14 @@ void GhostsApp::touchesBegan( TouchEvent event )
             
             int touchedDigit = -1;
             
+            //turns the pages of the catalogue
+            if (x > 430 && x < 490 && y > 50 && y < 150 && mCataloguePage > 0){
+                mCataloguePage--;
+            }
+            else if (x > 430 && x < 490 && y > 160 && y < 260 && mCataloguePage < mCatalogue.pageCount() - 1){
+                mCataloguePage++;
+            }
+            
             //reads input from the number pad
             //The "go" and "back" button are 10 and -10 respectively
             if (y < 782 && y > 712){
@@ -290,38 +683,33 @@ void GhostsApp::touchesBegan( TouchEvent event )
                 }
             }
             
-            //if a number was touched, register it as the first digit, second digit, or nothing
+            //a new choice replaces the last load's error
+            if (touchedDigit != -1){
+                loadError = "";
+            }
+            
+            //if a number was touched, add it to the typed ID and show the page the ID is listed on
             //if the back button was touched, delete the last inputted digit
             //if the go button was touched, check if it is a validID
-            if (touchedDigit != -1 && firstDigit == -1){
-                if (touchedDigit != -10){
-                    firstDigit = touchedDigit;
-                }
-            }
-            else if (touchedDigit == -10 && firstDigit != -1 && secondDigit == -1){
-                firstDigit = -1;
-            }
-            else if (touchedDigit != -1 && firstDigit != -1 && secondDigit == -1){
-                if (touchedDigit != -10 && touchedDigit != 10){
-                    secondDigit = touchedDigit;
+            if (touchedDigit >= 0 && touchedDigit <= 9){
+                mTypedId.push(touchedDigit);
+                notVaildID = false;
+                int entry = mCatalogue.find(mTypedId.value());
+                if (entry != -1){
+                    mCataloguePage = mCatalogue.pageOf(entry);
                 }
             }
-            else if (touchedDigit == -10 && firstDigit != -1 && secondDigit != -1){
-                secondDigit = -1;
+            else if (touchedDigit == -10){
+                mTypedId.back();
                 notVaildID = false;
             }
             
             //If the number is a validID, set canopy to load to be that ID 
-            else if (touchedDigit == 10 && firstDigit != -1 && secondDigit != -1){
-                canopyID = 10 * firstDigit + secondDigit;
-                bool isValidID = false;
-                for (int o = 0; o < canopiesOnServer.size(); o++){
-                    if (canopyID == canopiesOnServer[o]){
-                        isValidID = true;
-                    }
+            else if (touchedDigit == 10 && !mTypedId.empty()){
+                if (mCatalogue.contains(mTypedId.value())){
+                    canopyID = mTypedId.value();
                 }
-                if (!isValidID){
-                    canopyID = -1;
+                else{
                     notVaildID = true;
                 }
             }
@@ -333,6 +721,7 @@ void GhostsApp::touchesBegan( TouchEvent event )
         
         recentlyTouched = true;
         timeTouched = getElapsedSeconds();
+        frameDirty = true;
         
         //define x and y coordinates of the touch
         for( vector<TouchEvent::Touch>::const_iterator touchIt = event.getTouches().begin(); touchIt != event.getTouches().end(); ++touchIt ) {
@@ -376,6 +765,57 @@ void GhostsApp::touchesMoved( TouchEvent event )
 void GhostsApp::touchesEnded( TouchEvent event )
 {
     isCalibrate = false;
+    frameDirty = true;
+}
+
+//checks if the canopy view would look the same as the last drawn frame
+bool GhostsApp::viewIsStatic()
+{
+    //touches and loads always need a new frame
+    if (frameDirty){
+        return false;
+    }
+    
+    //screen buttons are timed out after being touched
+    if (recentlyTouched){
+        return false;
+    }
+    
+    //an object is being scanned but hasn't been displayed yet (waiting on SCAN_TIME)
+    if (oldTime != -1.0 && displayedObject == -1){
+        return false;
+    }
+    
+    //the iPad has moved (ignored while paused since the image isn't updated)
+    if (!isPaused){
+        if (abs(rotation.x - lastDrawnRotation.x) > ROTATION_THRESHOLD || abs(rotation.y - lastDrawnRotation.y) > ROTATION_THRESHOLD || abs(rotation.z - lastDrawnRotation.z) > ROTATION_THRESHOLD){
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+//draws the last canopy frame again without redrawing its tiles, indicators and overlays
+void GhostsApp::presentLastFrame()
+{
+    //the first static frame is drawn once into the framebuffer and the app drops to the idle frame rate
+    if (!hasLastFrame){
+        if (!lastFrame){
+            lastFrame = gl::Fbo(getWindowWidth(), getWindowHeight());
+        }
+        {
+            gl::SaveFramebufferBinding bindingSaver;
+            lastFrame.bindFramebuffer();
+            drawCanopy();
+        }
+        hasLastFrame = true;
+        setFrameRate(IDLE_FRAME_RATE);
+    }
+    
+    gl::clear(Color(0, 0, 0));
+    gl::disableAlphaBlending();
+    gl::draw(lastFrame.getTexture(), Rectf(0.0f, 0.0f, (float)getWindowWidth(), (float)getWindowHeight()));
 }
 
 void GhostsApp::draw()
@@ -383,857 +823,1629 @@ void GhostsApp::draw()
     //Draw the load screen
     if (onLoadScreen){
         gl::clear(Color(0,0,0));
-        if (loadingIndexes){
-            
-            //loads all the canopies' name and ID number
-            ostringstream tableInfo;
-            tableInfo.str("");
-            XmlTree canopies(loadUrl("http://ghosts.slifty.com/services/getCanopyList.php"));
-            list<XmlTree> listOfCanopies = canopies.getChild("canopies").getChildren();
-            list<XmlTree>::iterator i;
-            tableOfCanopies.resize(listOfCanopies.size() + 2);
-            
-            
-            //creates a table of contents with the index and names of each panorama
-            int tableIndex = 2;
-            tableOfCanopies[0] = "List of Canopies and their index numbers:";
-            tableOfCanopies[1] = "  ";
-            for(i = listOfCanopies.begin(); i != listOfCanopies.end(); ++i, tableIndex ++) {
-                XmlTree canopyOption = *i;
-                tableInfo.str("");
-                tableInfo << canopyOption.getChild("id").getValue().c_str() << ". " << canopyOption.getChild("name").getValue().c_str();
-                tableOfCanopies[tableIndex] = tableInfo.str();
-                
-                canopiesOnServer.resize(canopiesOnServer.size() + 1);
-                canopiesOnServer[canopiesOnServer.size() - 1] = atoi(canopyOption.getChild("id").getValue().c_str());
+        
+        if (mLoadState != CHOOSING){
+            if (!loadError.empty()){
+                drawLoadError();
             }
-            
-            //creates TextLayout for the table of contents
-            TextLayout canopyTableOfContents;
-            canopyTableOfContents.clear(ColorA(0.0f,0.0f,0.0f,1.0));
-            canopyTableOfContents.setFont(Font("Arial", 20));
-            canopyTableOfContents.setColor(Color(10.0f,10.0f,10.0f));
-            
-            //fills table of contents
-            for (int u = 0; u < tableOfCanopies.size(); u++){
-                canopyTableOfContents.addLine(tableOfCanopies[u]);
+            return;
+        }
+        
+        drawLoadScreen();
+    }
+    
+    //If not on the load screen anymore
+    else{
+        if(mLoadState == CANOPY_LOADING) {
+            drawLoadingPanorama();
+        } 
+        
+        // default is canopy
+        else {
+            //re-presents the last frame instead of redrawing when nothing on screen could have changed
+            if (RENDER_ON_DEMAND && viewIsStatic()){
+                presentLastFrame();
             }
-            
-            //creates an image fot the table of contents
-            canopyIndexes = gl::Texture(canopyTableOfContents.render(true, false));
-            
-            //Creates a table of each number button
-            //also creates a list of rendered images for each number buttom
-            vector<TextLayout> numberPad;
-            numberPad.resize(12);
-            ostringstream temp; //the number to add to the table of numbers
-            numberPadNumbers.resize(12);
-            for (int r = 0; r < numberPad.size(); r++){
-                numberPad[r].clear(ColorA(1.0f,1.0f,1.0f,1.0));
-                numberPad[r].setFont(Font("Arial", 50));
-                numberPad[r].setColor(Color(0.0f,0.0f,0.0f));
-                if(r < 9){
-                    temp.str("");
-                    temp << r + 1;
-                    numberPad[r].addLine(temp.str());
-                    numberPadNumbers[r] = gl::Texture(numberPad[r].render(true, false));
-                }
-                else if (r == 9){
-                    numberPad[r].setFont(Font("Arial", 25));
-                    numberPad[r].addLine("Back");
-                    numberPadNumbers[r] = gl::Texture(numberPad[r].render(true, false));
-                }
-                else if (r == 10){
-                    numberPad[r].addLine("0");
-                    numberPadNumbers[r] = gl::Texture(numberPad[r].render(true, false));
-                }
-                else if (r == 11){
-                    numberPad[r].setFont(Font("Arial", 25));
-                    numberPad[r].addLine("Go");
-                    numberPadNumbers[r] = gl::Texture(numberPad[r].render(true, false));
+            else{
+                if (hasLastFrame){ //wakes up from idle
+                    hasLastFrame = false;
+                    setFrameRate(activeFrameRate());
                 }
+                drawCanopy();
             }
+        }
+    }
+}
+
+//memory held by a texture or surface, for the memory budget
+static size_t textureBytes(const gl::Texture &texture)
+{
+    return texture ? (size_t)texture.getWidth() * texture.getHeight() * 4 : 0;
+}
+
+static size_t surfaceBytes(const Surface &surface)
+{
+    return surface ? (size_t)surface.getRowBytes() * surface.getHeight() : 0;
+}
+
+static size_t portalBytes(const gl::Texture &texture)
+{
+    return texture ? pixelFormatBytes(PORTAL_FORMAT, texture.getWidth(), texture.getHeight()) : 0;
+}
+
+//uploads pixels laid out as the format takes them, rowLength pixels apart (0 if tightly packed),
+//as a texture Cinder deletes when it is released
+static gl::Texture uploadTexture(const unsigned char *pixels, size_t bytes, PixelFormat format, int width, int height, int rowLength)
+{
+    PixelUpload upload = pixelUpload(format);
+    
+    GLuint id;
+    glGenTextures(1, &id);
+    glBindTexture(GL_TEXTURE_2D, id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (rowLength){
+        glPixelStorei(UNPACK_ROW_LENGTH, rowLength);
+    }
+    if (upload.compressed){
+        glCompressedTexImage2D(GL_TEXTURE_2D, 0, upload.format, width, height, 0, bytes, pixels);
+    }
+    else{
+        glTexImage2D(GL_TEXTURE_2D, 0, upload.format, width, height, 0, upload.format, upload.type, pixels);
+    }
+    if (rowLength){
+        glPixelStorei(UNPACK_ROW_LENGTH, 0);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return gl::Texture(GL_TEXTURE_2D, id, width, height, false);
+}
+
+//uploads packed pixels
+gl::Texture GhostsApp::packedTexture(const PackedPixels &packed)
+{
+    return uploadTexture(packed.data.empty() ? 0 : &packed.data[0], packed.data.size(), packed.format, packed.width, packed.height, 0);
+}
 
-            loadingIndexes = false; //done loading the number pad and table of contents
+//uploads pixels in a compact format: straight from their rows if they are already in it (and GL can step over the rest of
+//each row), otherwise packed into mStaging, which is reused so cutting a panorama doesn't allocate anything per tile
+gl::Texture GhostsApp::packedTexture(const unsigned char *pixels, int rowBytes, int pixelBytes, int r, int g, int b, int width, int height, PixelFormat format)
+{
+    if (uploadsAsIs(format, pixelBytes, r, g, b) && rowBytes % pixelBytes == 0){
+        int rowLength = rowBytes / pixelBytes;
+        if (rowLength == width){
+            return uploadTexture(pixels, (size_t)rowBytes * height, format, width, height, 0);
         }
+        if (mUnpackRowLength){
+            return uploadTexture(pixels, (size_t)rowBytes * height, format, width, height, rowLength);
+        }
+    }
+    packPixels(pixels, rowBytes, pixelBytes, r, g, b, width, height, format, mStaging);
+    return packedTexture(mStaging);
+}
+
+//uploads part of a surface in a compact format
+gl::Texture GhostsApp::packedTexture(const Surface &surface, const Area &area, PixelFormat format)
+{
+    const SurfaceChannelOrder &order = surface.getChannelOrder();
+    return packedTexture(surface.getData(area.getUL()), surface.getRowBytes(), surface.getPixelInc(), order.getRedOffset(), order.getGreenOffset(),
+                         order.getBlueOffset(), area.getWidth(), area.getHeight(), format);
+}
+
+//queues a job with the loader and counts it against this load
+void GhostsApp::request(const LoadJob &job)
+{
+    mLoader.request(job);
+    mOutstandingJobs++;
+}
+
+void GhostsApp::requestCanopyList()
+{
+    Trace::clear(); //a load's trace starts with the canopy list
+    request(LoadJob(LoadJob::CANOPY_LIST, SERVICES_URL + "getCanopyList.php"));
+    mLoadState = LIST_LOADING;
+}
+
+//starts loading the selected canopy: its information first, then its panorama and portal images
+//a compiled bundle of it is used instead of the server if there is one
+void GhostsApp::requestCanopy()
+{
+    mLoadStarted = Log::now();
+    mLoadProfile.startRun();
+    mRunFinished = false;
+    mPortalsCached = 0;
+    mPortalsDownloaded = 0;
+    mLoadState = CANOPY_LOADING;
+    
+    string bundle = bundlePath(canopyID);
+    if (USE_BUNDLES && access(bundle.c_str(), R_OK) == 0){
+        LOG_INFO("%s", bundle.c_str());
+        request(LoadJob(LoadJob::BUNDLE, bundle));
+        return;
+    }
+    
+    ostringstream oss;
+    oss << SERVICES_URL << "getCanopyInformation.php?c=" << canopyID;
+    LOG_INFO("%s", oss.str().c_str());
+    request(LoadJob(LoadJob::MANIFEST, oss.str()));
+}
+
+string GhostsApp::bundlePath(int id)
+{
+    ostringstream path;
+    path << getDocumentsDirectory() << "bundles/canopy_" << id << ".bundle";
+    return path.str();
+}
+
+//applies what the loader has finished, leaving the rest for later frames once LOAD_APPLY_SECONDS is used up
+void GhostsApp::applyLoadResults()
+{
+    double start = Log::now();
+    LoadResult result;
+    while (Log::now() - start < LOAD_APPLY_SECONDS && mLoader.poll(result)){
+        mOutstandingJobs--;
+        frameDirty = true;
+        switch (result.job.type){
+            case LoadJob::CANOPY_LIST:
+                applyCanopyList(result);
+                break;
+            case LoadJob::MANIFEST:
+            case LoadJob::BUNDLE:
+                applyManifest(result);
+                break;
+            case LoadJob::PREVIEW:
+            case LoadJob::PANORAMA:
+                applyPanorama(result);
+                break;
+            case LoadJob::PORTAL_IMAGE:
+                applyPortalImage(result);
+                break;
+        }
+    }
+    
+    //a load is finished once everything it asked for has come back
+    if (mLoadState == VIEWING && !mRunFinished && mOutstandingJobs == 0 && !mFullTiles){
+        finishLoadRun();
+    }
+}
+
+//indexes the list of canopies and renders the number pad
+void GhostsApp::applyCanopyList(const LoadResult &result)
+{
+    TRACE_SPAN("apply canopy list");
+    if (!result.error.empty()){
+        LOG_ERROR("couldn't load the canopy list: %s", result.error.c_str());
+        loadError = "Couldn't reach the canopy server, trying again...";
+        listRetryTime = getElapsedSeconds() + LIST_RETRY_DELAY;
+        mLoadState = LIST_NEEDED;
+        return;
+    }
+    mLoadProfile.add(LoadProfile::LIST, result.fetchSeconds + result.decodeSeconds);
+    
+    //loads all the canopies' name and ID number, their rows are rendered a page at a time when shown
+    mCatalogue.assign(result.canopyIds, result.canopyNames);
+    mCataloguePage = 0;
+    releasePageTextures(0); //the pages list other canopies now
+    mLoadScreenPage = -1;
+    LOG_INFO("%d canopies on the server, %d pages", mCatalogue.size(), mCatalogue.pageCount());
+    
+    //number pad buttons
+    numberPadNumbers.resize(12);
+    for (int r = 0; r < numberPadNumbers.size(); r++){
+        numberPadNumbers[r] = mAssets.texture(ASSET_NUMBER_PAD + r);
+        mBudget.add(MemoryBudget::INTERFACE, textureBytes(numberPadNumbers[r]));
+    }
+    
+    loadError = "";
+    mLoadState = CHOOSING;
+}
+
+//sets up the canopy's data objects and tiles, then asks for its panorama and portal images
+void GhostsApp::applyManifest(const LoadResult &result)
+{
+    TRACE_SPAN("apply manifest");
+    //a bundle that can't be read is skipped for the server
+    if (!result.error.empty() && result.job.type == LoadJob::BUNDLE){
+        LOG_WARN("couldn't load the bundle of canopy %d, loading it from the server: %s", canopyID, result.error.c_str());
+        ostringstream oss;
+        oss << SERVICES_URL << "getCanopyInformation.php?c=" << canopyID;
+        request(LoadJob(LoadJob::MANIFEST, oss.str()));
+        return;
+    }
+    if (!result.error.empty()){
+        ostringstream message;
+        message << "Couldn't load canopy " << canopyID << ", please try again.";
+        LOG_ERROR("couldn't load canopy %d: %s", canopyID, result.error.c_str());
+        failLoad(message.str());
+        return;
+    }
+    const CanopyManifest &manifest = result.manifest;
+    LOG_INFO("canopy information %s, text of %d of %d projections kept from earlier loads",
+             result.bundle ? "from a bundle" : result.cached ? "unchanged" : "downloaded", manifest.textReused, (int)manifest.projections.size());
+    mLoadProfile.add(LoadProfile::MANIFEST, result.fetchSeconds + result.decodeSeconds - manifest.textSeconds);
+    
+    //Loads the panorama's dimensions
+    ghostHeight = manifest.height;
+    ghostWidth = manifest.width;
+    
+    //Loads in projection data 
+    int count = manifest.projections.size();
+    mProjections.clear(); //records are filled in place, so none may carry over from the last canopy
+    mProjections.resize(count);
+    mPositions.clear();
+    mPositions.reserve(count * 2);
+    
+    //creates all projection structures, their text was wrapped and rendered by the loader
+    double stageStart = Log::now();
+    for (int cursor = 0; cursor < count; ++cursor) {
+        const ProjectionRecord &record = manifest.projections[cursor];
+        Projection &proj = mProjections[cursor]; //filled in place so surfaces aren't copied
         
-        //Draws the Title and directions
-        glPushMatrix();
-        glTranslatef(400, 50, 0);
-        glRotatef(90, 0, 0, 1);
-        gl::drawStringCentered("Ghosts Of The Past", Vec2f(525,-350),ColorA(1, 1, 1, 1), Font("Arial", 50));
-        gl::drawStringCentered("Input an index number below to display a panorama.", Vec2f(525,-250),ColorA(1, 1, 1, 1), Font("Arial", 20));
-        gl::draw(canopyIndexes);
-        glPopMatrix();
-        
-        //draws the number pad
-        glPushMatrix();
-        glRotatef(90, 0, 0, 1);
-        
-        //boxes of 70x70
-        gl::drawSolidRect(Rectf(712, -304, 782, -374));//1
-        gl::draw(numberPadNumbers[0],Vec2f(732, -369));
-        
-        gl::drawSolidRect(Rectf(792, -304, 862, -374));//2
-        gl::draw(numberPadNumbers[1],Vec2f(812, -369));
-        
-        gl::drawSolidRect(Rectf(872, -304, 942, -374));//3
-        gl::draw(numberPadNumbers[2],Vec2f(892, -369));
-        
-        gl::drawSolidRect(Rectf(712, -224, 782, -294));//4
-        gl::draw(numberPadNumbers[3],Vec2f(732, -284));
-        
-        gl::drawSolidRect(Rectf(792, -224, 862, -294));//5
-        gl::draw(numberPadNumbers[4],Vec2f(812, -284));
-        
-        gl::drawSolidRect(Rectf(872, -224, 942, -294));//6
-        gl::draw(numberPadNumbers[5],Vec2f(892, -284));
-        
-        gl::drawSolidRect(Rectf(712, -144, 782, -214));//7
-        gl::draw(numberPadNumbers[6],Vec2f(732, -204));
-        
-        gl::drawSolidRect(Rectf(792, -144, 862, -214));//8
-        gl::draw(numberPadNumbers[7],Vec2f(812, -204));
-        
-        gl::drawSolidRect(Rectf(872, -144, 942, -214));//9
-        gl::draw(numberPadNumbers[8],Vec2f(892, -204));
-        
-        gl::drawSolidRect(Rectf(712, -63, 782, -134));//back
-        gl::draw(numberPadNumbers[9],Vec2f(719, -112));
-        
-        gl::drawSolidRect(Rectf(792, -63, 862, -134));//0
-        gl::draw(numberPadNumbers[10],Vec2f(812, -124));
-        
-        gl::drawSolidRect(Rectf(872, -63, 942, -134));//go
-        gl::draw(numberPadNumbers[11],Vec2f(888, -114));
+        //loads its location on the canopy and its ID number
+        proj.id = record.id;
+        int offX = record.offX + 1024;
+        int offY = record.offY;
+        proj.height = record.height;
+        proj.width = record.width;
+        proj.hasImage = record.hasImage;
+        proj.imageRequested = false;
+        proj.imageMapped = false;
+        proj.imageHash = record.imageHash;
+        proj.textLines = record.textLines;
+        proj.captionLines = record.captionLines;
         
-        ostringstream inputtedIndex; //the digits inputted by the user
-        inputtedIndex.str("");
+        proj.infoImage = gl::Texture(record.infoText);
+        proj.captionImage = gl::Texture(record.captionText);
+        mBudget.add(MemoryBudget::TEXT, textureBytes(proj.infoImage) + textureBytes(proj.captionImage));
         
-        //Draw the numbers inputed by the user on the screen
-        gl::drawStringCentered("Inputed Digits:", Vec2f(749, -474), ColorA(1,1,1,1), Font("Arial", 30));
-        if (firstDigit != -1){
-            inputtedIndex << firstDigit;
-            gl::drawStringCentered(inputtedIndex.str(), Vec2f(849, -474), ColorA(1,1,1,1), Font("Arial", 40));
+        //assigns position, objects past the seam are also placed at the beginning of the canvas
+        if (offX >= ghostWidth){
+            mPositions.add(offX, offY, mPositions.size() + 1, cursor);
+            mPositions.add(offX - ghostWidth, offY, -2, cursor);
+        }
+        else{
+            mPositions.add(offX, offY, -1, cursor);
+        }
+    }
+    mLoadProfile.add(LoadProfile::TEXT, manifest.textSeconds + Log::now() - stageStart);
+    
+    // Load canopy data
+    
+    LOG_DEBUG("gh %d gw %d", ghostHeight, ghostWidth);
+    
+    ghostRows = ceil(ghostHeight / (float)TILE_HEIGHT);
+    ghostCols = ceil(ghostWidth / (float)TILE_WIDTH);
+    mLiveTextures.resize(SCREEN_ROWS * SCREEN_COLS);
+    mGhostSurfaces.resize(ghostRows * (ghostCols + (1024 / TILE_WIDTH)));
+    
+    //works out which part of the panorama each tile shows
+    vector<TileArea> areas = canopyTileAreas(ghostWidth, ghostHeight, TILE_WIDTH, TILE_HEIGHT);
+    mTileAreas.resize(areas.size());
+    for (int t = 0; t < areas.size(); t++){
+        mTileAreas[t] = Area(areas[t].x1, areas[t].y1, areas[t].x2, areas[t].y2);
+    }
+    if (CYLINDER_VIEW){
+        buildCylinderMesh(mCylinder, areas, ghostRows * (1024 / TILE_WIDTH), ghostWidth, ghostHeight);
+    }
+    
+    panoramaWidth = ghostWidth;
+    mTileFull.assign(mGhostSurfaces.size(), 0);
+    
+    LOG_DEBUG("col %d row %d", ghostCols, ghostRows);
+    
+    ghostWidth += 1024;
+    ghostCols += (1024 / TILE_WIDTH);
+    
+    //sorts the objects around the panorama (without the copied edge) for the searching arrows
+    if (mPositions.size() > 0){
+        mDirections.build(&mPositions.offX[0], &mPositions.offY[0], &mPositions.copiedBy[0], mPositions.size(), ghostWidth - 1024);
+    }
+    else{
+        mDirections = DirectionIndex();
+    }
+    
+    // loading buttons and surfaces
+    stageStart = Log::now();
+    buttonSurface = mAssets.texture(ASSET_INDICATOR);
+    selectedObject = mAssets.texture(ASSET_INDICATOR_SCANNED);
+    pause = mAssets.texture(ASSET_PAUSE);
+    play = mAssets.texture(ASSET_PLAY);
+    calibrate = mAssets.texture(ASSET_CALIBRATE);
+    switchPanorama = mAssets.texture(ASSET_SWITCH_PANORAMA);
+    mBudget.add(MemoryBudget::INTERFACE, textureBytes(buttonSurface) + textureBytes(selectedObject) + textureBytes(pause) +
+                                         textureBytes(play) + textureBytes(calibrate) + textureBytes(switchPanorama));
+    mLoadProfile.add(LoadProfile::ASSETS, Log::now() - stageStart);
+    
+    //a bundle already holds the tiles, otherwise the panorama is downloaded
+    mBundle = result.bundle;
+    if (!mBundle || !useBundle()){
+        //a small copy of the panorama stretched over the tiles makes the canopy usable as soon as it arrives
+        if (PROGRESSIVE_PANORAMA){
+            request(LoadJob(LoadJob::PREVIEW, panoramaUrl(PREVIEW_SCALE)));
         }
-        if (secondDigit != -1){
-            inputtedIndex.str("");
-            inputtedIndex << secondDigit;
-            gl::drawStringCentered(inputtedIndex.str(), Vec2f(874, -474), ColorA(1,1,1,1), Font("Arial", 40));
+        else{
+            request(panoramaJob(fullPanoramaScale()));
+        }
+    }
+    
+    //portal images are loaded behind the panorama
+    //images that don't fit in the memory budget are loaded when they are shown
+    for (int p = 0; p < mProjections.size(); p++){
+        if (mProjections[p].hasImage && mBudget.fits((size_t)mProjections[p].width * mProjections[p].height * 4)){
+            ensurePortalImage(p);
         }
-        //if not a valid ID, tell the user so
-        if (notVaildID){
-            gl::drawStringCentered("*not a vaild index!", Vec2f(950, -464));
+    }
+}
+
+//cuts a panorama that has arrived into tiles
+void GhostsApp::applyPanorama(const LoadResult &result)
+{
+    TRACE_SPAN("apply panorama");
+    bool full = result.job.type == LoadJob::PANORAMA;
+    
+    //a full panorama following the preview only improves what is already there
+    if (full && mLoadState == VIEWING){
+        if (!result.error.empty()){
+            LOG_WARN("couldn't load the full panorama, staying on the preview: %s", result.error.c_str());
+            return;
         }
+        mLoadProfile.add(LoadProfile::PANORAMA, result.fetchSeconds + result.decodeSeconds);
+        mFullTiles = result.tiles;
+        mBudget.add(MemoryBudget::PANORAMA, mFullTiles->bytes());
         
-        glPopMatrix();
-        
-        //if a canopy has been selected, clear the screen, tell the user the panorama is loading, and load the selected panorama
-        if(canopyID != -1){
-            onLoadScreen = false;
-            gl::clear(Color(0,0,0));
-            glPushMatrix();
-            glTranslatef(434,300,0);
-            glRotatef(90,0,0,1);
-            
-            TextLayout loadingPanorama;
-            loadingPanorama.clear(ColorA(0.0f,0.0f,0.0f,1.0));
-            loadingPanorama.setFont(Font("Arial", 50));
-            loadingPanorama.setColor(Color(10.0f,10.0f,10.0f));
-            loadingPanorama.addLine("Loading Panorama...");
-            gl::Texture loadingPano = gl::Texture(loadingPanorama.render(true, false));
-            gl::draw(loadingPano);
-            glPopMatrix();
+        //replaces the tiles nearest the view first
+        int viewCol = liveIndex == -1 ? 0 : liveIndex / ghostRows;
+        vector< pair<int, int> > byDistance;
+        for (int t = 0; t < mGhostSurfaces.size(); t++){
+            int colDistance = abs(t / ghostRows - viewCol);
+            colDistance = min(colDistance, ghostCols - colDistance);
+            byDistance.push_back(make_pair(colDistance, t));
         }
+        sort(byDistance.begin(), byDistance.end());
+        mPendingTiles.clear();
+        for (int i = byDistance.size() - 1; i >= 0; i--){
+            mPendingTiles.push_back(byDistance[i].second);
+        }
+        return;
     }
     
-    //If not on the load screen anymore
+    if (!result.error.empty()){
+        ostringstream message;
+        message << "Couldn't load canopy " << canopyID << ", please try again.";
+        LOG_ERROR("couldn't load the panorama of canopy %d: %s", canopyID, result.error.c_str());
+        failLoad(message.str());
+        return;
+    }
+    mLoadProfile.add(full ? LoadProfile::PANORAMA : LoadProfile::PREVIEW, result.fetchSeconds + result.decodeSeconds);
+    
+    double stageStart = Log::now();
+    if (full){
+        //the loader has already cut it
+        chooseTileFormat(result.tiles->format == PIXELS_L8);
+        for (int t = 0; t < mTileAreas.size(); t++){
+            setTile(t, packedTexture(result.tiles->tiles[t]), true);
+        }
+    }
     else{
-        if(!ISREADY) {
-            
-            // loading image from ghosts
-            ostringstream oss;
-            oss << "http://ghosts.slifty.com/services/getCanopyInformation.php?c=" << canopyID;
-            
-            //Loads the projections
-            XmlTree doc( loadUrl( oss.str() ) );
-            console() << oss.str() << std::endl;
-            XmlTree canopy = doc.getChild("canopy");
-            XmlTree projections = canopy.getChild("projections");
-            
-            //Loads the panorama's dimensions
-            ghostHeight = atoi(canopy.getChild("height").getValue().c_str());
-            ghostWidth = atoi(canopy.getChild("width").getValue().c_str());
-            
-            //Loads in projection data 
-            list<XmlTree> L = projections.getChildren();
-            list<XmlTree>::iterator i;
-            mProjections.resize(L.size());
-            
-            //creates all projection structures
-            int cursor = 0;
-            for(i = L.begin(); i != L.end(); ++i, ++cursor) {
-                XmlTree projectionXML = *i;
-                
-                Projection proj;
-                
-                //loads its location on the canopy and its ID number
-                proj.id = atoi(projectionXML.getChild("id").getValue().c_str());
-                proj.offX = atoi(projectionXML.getChild("offX").getValue().c_str())+ 1024;
-                proj.offY = atoi(projectionXML.getChild("offY").getValue().c_str());
-                proj.height = atoi(projectionXML.getChild("height").getValue().c_str());
-                proj.width = atoi(projectionXML.getChild("width").getValue().c_str());
-                
-                //prints out projection's URL location
-                oss.str("");
-                oss << "http://ghosts.slifty.com/services/getPortalImage.php?p=" << proj.id;
-                console() << oss.str() << std::endl;
-                
-                //checks if the the projection has an image and loads it if it does
-                if (atoi(projectionXML.getChild("width").getValue().c_str()) != 0){
-                    proj.imageFile = Surface(loadImage( loadUrl( oss.str() ) ));
-                    proj.hasImage = true;
-                }
-                else{
-                    proj.hasImage = false;
-                }
-                
-                //loads text gotten from server
-                string text = projectionXML.getChild("description").getValue(); 
-                
-                //loads caption gotten from server
-                string caption = projectionXML.getChild("caption").getValue();
-                if (!proj.hasImage){
-                    caption = " ";
-                }
-                
-                //Lines used to store text/caption characters per TextLayout
-                string line = "";
-                string captionLine = "";
-                int place = 0;
-                int place2 = 0;
-                
-                int tracker = 0;//keeps track of the current amount of characters in a line
-                int captionTracker = 0;//keeps track of current amount of characters in the caption
-                int resizer = 1;
+        chooseTileFormat(isGrayscale(result.image.getData(), result.image.getRowBytes(), result.image.getPixelInc(), result.image.getChannelOrder().getRedOffset(),
+                                     result.image.getChannelOrder().getGreenOffset(), result.image.getChannelOrder().getBlueOffset(),
+                                     result.image.getWidth(), result.image.getHeight()));
+        //the preview is kept so tiles can drop back to it when memory runs short
+        mPreview = result.image;
+        mBudget.add(MemoryBudget::PANORAMA, surfaceBytes(mPreview));
+        for (int t = 0; t < mTileAreas.size(); t++){
+            setTile(t, tileFrom(mPreview, t), false);
+        }
+    }
+    mLoadProfile.add(LoadProfile::SLICING, Log::now() - stageStart);
+    logTiles(Log::now() - stageStart);
+    
+    canopyReady();
+    
+    //the full panorama is swapped in by updatePanorama() when it arrives,
+    //at the largest size that leaves room in the memory budget
+    if (!full){
+        int scale = fullPanoramaScale();
+        if (scale < PREVIEW_SCALE){
+            request(panoramaJob(scale));
+        }
+        else{
+            LOG_WARN("not enough memory for a larger panorama, staying on the preview");
+        }
+    }
+}
+
+void GhostsApp::applyPortalImage(const LoadResult &result)
+{
+    TRACE_SPAN_ARG("apply portal image", result.job.index);
+    Projection &proj = mProjections[result.job.index];
+    proj.imageRequested = false;
+    if (!result.error.empty()){
+        LOG_WARN("couldn't load portal image %d: %s", proj.id, result.error.c_str());
+        proj.hasImage = false;
+        return;
+    }
+    mLoadProfile.add(LoadProfile::PORTAL_IMAGES, result.fetchSeconds + result.decodeSeconds);
+    if (result.cached){
+        mPortalsCached++;
+    }
+    else{
+        mPortalsDownloaded++;
+    }
+    proj.imageFile = result.image;
+    mBudget.add(MemoryBudget::PORTAL_IMAGES, surfaceBytes(proj.imageFile));
+}
+
+//uploads the tiles straight from the bundle, at the largest size the memory budget has room for
+//false (and the bundle dropped) if it was compiled for other tiles
+bool GhostsApp::useBundle()
+{
+    const BundleHeader &header = mBundle->header();
+    if (header.tileWidth != TILE_WIDTH || header.tileHeight != TILE_HEIGHT || header.tileCount != mTileAreas.size()){
+        LOG_WARN("the bundle of canopy %d was compiled for %dx%d tiles, loading the panorama from the server", canopyID,
+                 header.tileWidth, header.tileHeight);
+        mBundle.reset();
+        return false;
+    }
+    
+    //the smallest level is enough to tell a black and white canopy
+    int level = header.levelCount - 1;
+    bool grey = true;
+    for (int t = 0; t < header.tileCount && grey; t++){
+        const BundleTile &tile = mBundle->tile(level, t);
+        grey = isGrayscale(mBundle->pixels(tile.pixelsOffset), tile.width * 4, 4, 0, 1, 2, tile.width, tile.height);
+    }
+    chooseTileFormat(grey);
+    
+    for (int l = 0; l < header.levelCount; l++){
+        size_t bytes = 0;
+        for (int t = 0; t < header.tileCount; t++){
+            bytes += pixelFormatBytes(mTileFormat, mBundle->tile(l, t).width, mBundle->tile(l, t).height);
+        }
+        if (mBudget.fits(bytes)){
+            level = l;
+            break;
+        }
+    }
+    if (level > 0){
+        LOG_INFO("memory budget allows the panorama at 1/%d size", mBundle->level(level).scale);
+    }
+    mBundleLevel = level;
+    
+    double stageStart = Log::now();
+    uploadBundleTiles(bundleTileLevel());
+    mLoadProfile.add(LoadProfile::SLICING, Log::now() - stageStart);
+    logTiles(Log::now() - stageStart);
+    
+    canopyReady();
+    return true;
+}
+
+//the bundle level tiles are shown at: what the memory budget allows, a level smaller at LOWER_TILES quality
+int GhostsApp::bundleTileLevel()
+{
+    int level = mBundleLevel + (mGovernor.level() >= LOWER_TILES ? 1 : 0);
+    return min(level, (int)mBundle->header().levelCount - 1);
+}
+
+void GhostsApp::uploadBundleTiles(int level)
+{
+    TRACE_SPAN_ARG("upload bundle tiles", level);
+    for (int t = 0; t < mTileAreas.size(); t++){
+        setTile(t, bundleTile(level, t), level == 0);
+    }
+    mTileLevel = level;
+    liveIndex = -1; //the textures on screen are picked again
+}
+
+//the canopy can be looked around from here on
+void GhostsApp::canopyReady()
+{
+    LOG_INFO("canopy %d ready after %.3f s", canopyID, Log::now() - mLoadStarted);
+    mLoadState = VIEWING;
+    enableRotation();
+}
+
+//logs how long everything this load asked for took
+void GhostsApp::finishLoadRun()
+{
+    mRunFinished = true;
+    LOG_INFO("canopy %d fully loaded after %.3f s, %d portal images from the cache and %d downloaded", canopyID, Log::now() - mLoadStarted,
+             mPortalsCached, mPortalsDownloaded);
+    logHttpStats();
+    mBudget.log();
+    mLoadProfile.finishRun();
+    if (TRACE_LOADS){
+        writeLoadTrace();
+    }
+    
+    //benchmarking goes straight back to load the canopy again
+    if (BENCHMARK_RUNS > mLoadProfile.completedRuns()){
+        reset();
+    }
+}
+
+//writes the spans of the load that just finished, numbered so benchmark runs don't overwrite each other
+void GhostsApp::writeLoadTrace()
+{
+    string directory = getDocumentsDirectory() + "traces";
+    mkdir(directory.c_str(), 0755);
+    ostringstream path;
+    path << directory << "/load_" << canopyID << "_" << mLoadProfile.completedRuns() << ".json";
+    if (!Trace::write(path.str())){
+        LOG_WARN("couldn't write the load trace to %s", path.str().c_str());
+    }
+}
+
+//goes back to the load screen and says what happened instead of leaving the app
+void GhostsApp::failLoad(const string &message)
+{
+    reset();
+    loadError = message;
+}
+
+//the load screen as one quad, from framebuffers redrawn only when what they show changes
+//mLoadScreen holds everything but the typed digits and messages, and mLoadScreenFrame is it with those drawn over
+void GhostsApp::drawLoadScreen()
+{
+    if (!mLoadScreen){
+        mLoadScreen = gl::Fbo(getWindowWidth(), getWindowHeight());
+        mLoadScreenFrame = gl::Fbo(getWindowWidth(), getWindowHeight());
+    }
+    Rectf window(0.0f, 0.0f, (float)getWindowWidth(), (float)getWindowHeight());
+    
+    bool redraw = false;
+    if (mLoadScreenPage != mCataloguePage){
+        gl::SaveFramebufferBinding bindingSaver;
+        mLoadScreen.bindFramebuffer();
+        gl::clear(Color(0,0,0));
+        drawLoadScreenLayer();
+        mLoadScreenPage = mCataloguePage;
+        redraw = true;
+    }
+    
+    string text = mTypedId.text() + (notVaildID ? "\n!\n" : "\n\n") + loadError;
+    if (redraw || text != mLoadScreenText){
+        gl::SaveFramebufferBinding bindingSaver;
+        mLoadScreenFrame.bindFramebuffer();
+        gl::disableAlphaBlending();
+        gl::draw(mLoadScreen.getTexture(), window);
+        gl::enableAlphaBlending();
+        drawLoadScreenText();
+        mLoadScreenText = text;
+    }
+    
+    gl::disableAlphaBlending();
+    gl::draw(mLoadScreenFrame.getTexture(), window);
+}
+
+//the title, directions, catalogue page, number pad and page buttons
+void GhostsApp::drawLoadScreenLayer()
+{
+    FontLock lock;
+    //Draws the Title and directions
+    glPushMatrix();
+    glTranslatef(400, 50, 0);
+    glRotatef(90, 0, 0, 1);
+    gl::drawStringCentered("Ghosts Of The Past", Vec2f(525,-350),ColorA(1, 1, 1, 1), Font("Arial", 50));
+    gl::drawStringCentered("Input an index number below to display a panorama.", Vec2f(525,-250),ColorA(1, 1, 1, 1), Font("Arial", 20));
+    gl::draw(cataloguePageTexture());
+    glPopMatrix();
+    
+    //draws the number pad
+    glPushMatrix();
+    glRotatef(90, 0, 0, 1);
+    
+    //boxes of 70x70
+    gl::drawSolidRect(Rectf(712, -304, 782, -374));//1
+    gl::draw(numberPadNumbers[0],Vec2f(732, -369));
+    
+    gl::drawSolidRect(Rectf(792, -304, 862, -374));//2
+    gl::draw(numberPadNumbers[1],Vec2f(812, -369));
+    
+    gl::drawSolidRect(Rectf(872, -304, 942, -374));//3
+    gl::draw(numberPadNumbers[2],Vec2f(892, -369));
+    
+    gl::drawSolidRect(Rectf(712, -224, 782, -294));//4
+    gl::draw(numberPadNumbers[3],Vec2f(732, -284));
+    
+    gl::drawSolidRect(Rectf(792, -224, 862, -294));//5
+    gl::draw(numberPadNumbers[4],Vec2f(812, -284));
+    
+    gl::drawSolidRect(Rectf(872, -224, 942, -294));//6
+    gl::draw(numberPadNumbers[5],Vec2f(892, -284));
+    
+    gl::drawSolidRect(Rectf(712, -144, 782, -214));//7
+    gl::draw(numberPadNumbers[6],Vec2f(732, -204));
+    
+    gl::drawSolidRect(Rectf(792, -144, 862, -214));//8
+    gl::draw(numberPadNumbers[7],Vec2f(812, -204));
+    
+    gl::drawSolidRect(Rectf(872, -144, 942, -214));//9
+    gl::draw(numberPadNumbers[8],Vec2f(892, -204));
+    
+    gl::drawSolidRect(Rectf(712, -63, 782, -134));//back
+    gl::draw(numberPadNumbers[9],Vec2f(719, -112));
+    
+    gl::drawSolidRect(Rectf(792, -63, 862, -134));//0
+    gl::draw(numberPadNumbers[10],Vec2f(812, -124));
+    
+    gl::drawSolidRect(Rectf(872, -63, 942, -134));//go
+    gl::draw(numberPadNumbers[11],Vec2f(888, -114));
+    
+    //pages of the catalogue
+    if (mCatalogue.pageCount() > 1){
+        ostringstream page;
+        page << "Page " << mCataloguePage + 1 << " of " << mCatalogue.pageCount();
+        gl::drawSolidRect(Rectf(50, -430, 150, -490));//previous page
+        gl::drawSolidRect(Rectf(160, -430, 260, -490));//next page
+        gl::drawStringCentered("Prev", Vec2f(100, -470), ColorA(0,0,0,1), Font("Arial", 25));
+        gl::drawStringCentered("Next", Vec2f(210, -470), ColorA(0,0,0,1), Font("Arial", 25));
+        gl::drawStringCentered(page.str(), Vec2f(340, -470), ColorA(1,1,1,1), Font("Arial", 20));
+    }
+    
+    gl::drawStringCentered("Inputed Digits:", Vec2f(749, -474), ColorA(1,1,1,1), Font("Arial", 30));
+    glPopMatrix();
+}
+
+//the typed digits and what went wrong, if anything
+void GhostsApp::drawLoadScreenText()
+{
+    FontLock lock;
+    glPushMatrix();
+    glRotatef(90, 0, 0, 1);
+    
+    //Draw the numbers inputed by the user on the screen (smaller once they get long)
+    if (!mTypedId.empty()){
+        int digits = mTypedId.text().size();
+        float digitWidth = digits > 4 ? 14.0f : 25.0f;
+        gl::drawStringCentered(mTypedId.text(), Vec2f(837 + digitWidth * digits / 2, -474), ColorA(1,1,1,1), Font("Arial", digits > 4 ? 25 : 40));
+    }
+    //if not a valid ID, tell the user so
+    if (notVaildID){
+        gl::drawStringCentered("*not a vaild index!", Vec2f(950, -464));
+    }
+    
+    //if the last canopy couldn't be loaded, say so
+    if (!loadError.empty()){
+        gl::drawStringCentered(loadError, Vec2f(827, -424), ColorA(1,0.3,0.3,1), Font("Arial", 20));
+    }
+    
+    glPopMatrix();
+}
+
+//the table of contents for the catalogue page on screen (the caller holds the FontLock)
+//each page is rendered the first time it is shown and kept for turning back to, a few at a time
+gl::Texture &GhostsApp::cataloguePageTexture()
+{
+    if (mCataloguePage >= (int)mPageTextures.size()){
+        mPageTextures.resize(mCataloguePage + 1);
+    }
+    mPageOrder.remove(mCataloguePage);
+    mPageOrder.push_back(mCataloguePage);
+    
+    gl::Texture &texture = mPageTextures[mCataloguePage];
+    if (!texture){
+        TextLayout canopyTableOfContents;
+        canopyTableOfContents.clear(ColorA(0.0f,0.0f,0.0f,1.0));
+        canopyTableOfContents.setFont(Font("Arial", 20));
+        canopyTableOfContents.setColor(Color(10.0f,10.0f,10.0f));
+        
+        //fills table of contents
+        canopyTableOfContents.addLine("List of Canopies and their index numbers:");
+        canopyTableOfContents.addLine("  ");
+        vector<string> rows = mCatalogue.pageRows(mCataloguePage);
+        for (int u = 0; u < rows.size(); u++){
+            canopyTableOfContents.addLine(rows[u]);
+        }
+        
+        texture = gl::Texture(canopyTableOfContents.render(true, false));
+        mBudget.add(MemoryBudget::INTERFACE, textureBytes(texture));
+        releasePageTextures(mBudget.pressure() == MemoryBudget::NORMAL ? CATALOGUE_PAGES_KEPT : 1);
+    }
+    return texture;
+}
+
+//drops the least recently shown catalogue pages until keep are left
+void GhostsApp::releasePageTextures(int keep)
+{
+    while ((int)mPageOrder.size() > keep){
+        gl::Texture &texture = mPageTextures[mPageOrder.front()];
+        mBudget.remove(MemoryBudget::INTERFACE, textureBytes(texture));
+        texture = gl::Texture();
+        mPageOrder.pop_front();
+    }
+}
+
+//starts decoding the interface images and rendering the load screen labels, in the order of AssetId
+void GhostsApp::loadAssets()
+{
+    const char *images[] = { "Data.jpg", "DataInverted.jpg", "PauseButton.jpg", "PlayButton.jpg", "Calibrate.jpg", "SwitchPanorama.jpg" };
+    for (int i = 0; i < 6; i++){
+        mAssets.addImage(getResourcePath(images[i]));
+    }
+    
+    const char *numberPad[] = { "1", "2", "3", "4", "5", "6", "7", "8", "9", "Back", "0", "Go" };
+    for (int r = 0; r < 12; r++){
+        float size = (r == 9 || r == 11) ? 25 : 50; //Back and Go are smaller
+        mAssets.addText(numberPad[r], size, ColorA(1.0f,1.0f,1.0f,1.0), Color(0.0f,0.0f,0.0f));
+    }
+    
+    mAssets.addText("Loading Panorama...", 50, ColorA(0.0f,0.0f,0.0f,1.0), Color(10.0f,10.0f,10.0f));
+    mAssets.start(ASSET_THREADS);
+}
+
+void GhostsApp::drawLoadingPanorama()
+{
+    if (!loadingPanorama){
+        loadingPanorama = mAssets.texture(ASSET_LOADING_PANORAMA);
+    }
+    
+    gl::clear(Color(0,0,0));
+    glPushMatrix();
+    glTranslatef(434,300,0);
+    glRotatef(90,0,0,1);
+    gl::draw(loadingPanorama);
+    glPopMatrix();
+}
+
+//swaps a few full resolution tiles in for the preview each frame once the full panorama has arrived
+void GhostsApp::updatePanorama()
+{
+    if (!mFullTiles){
+        return;
+    }
+    
+    //tiles that don't fit in the memory budget stay on the preview
+    TRACE_SPAN("swap in full tiles");
+    for (int n = 0; n < FULL_TILES_PER_FRAME && !mPendingTiles.empty(); n++){
+        int t = mPendingTiles.back();
+        PackedPixels &packed = mFullTiles->tiles[t];
+        if (!mBudget.fits(packed.data.size())){
+            LOG_WARN("memory budget reached, %d tiles stay on the preview", (int)mPendingTiles.size());
+            mPendingTiles.clear();
+            break;
+        }
+        mPendingTiles.pop_back();
+        setTile(t, packedTexture(packed), true);
+        mBudget.remove(MemoryBudget::PANORAMA, packed.data.size());
+        vector<unsigned char>().swap(packed.data); //the texture has it now
+    }
+    liveIndex = -1; //the textures on screen are picked again
+    frameDirty = true;
+    
+    if (mPendingTiles.empty()){
+        LOG_INFO("full panorama in place %.3f s after loading started", Log::now() - mLoadStarted);
+        mBudget.remove(MemoryBudget::PANORAMA, mFullTiles->bytes()); //tiles left on the preview
+        mFullTiles.reset();
+    }
+}
+
+//picks how many times smaller than the original the full panorama is downloaded (PREVIEW_SCALE if nothing bigger fits)
+//the loader holds the packed tiles and what it cuts them from (a strip, as the services send baseline JPEGs) while they are made
+int GhostsApp::fullPanoramaScale()
+{
+    PixelFormat format = cutFormat();
+    if (format == PIXELS_AUTO){
+        format = PIXELS_RGB565; //the larger of what it may be
+    }
+    size_t freed = mBudget.used(MemoryBudget::PREVIEW_TILES); //the preview tiles it replaces
+    for (int scale = 1; scale < PREVIEW_SCALE; scale *= 2){
+        size_t bytes = tileDecodeBytes(panoramaWidth / scale, ghostHeight / scale, TILE_HEIGHT / scale);
+        for (int t = 0; t < mTileAreas.size(); t++){
+            bytes += pixelFormatBytes(format, mTileAreas[t].getWidth() / scale, mTileAreas[t].getHeight() / scale);
+        }
+        if (bytes <= mBudget.available() + freed){
+            if (scale > 1){
+                LOG_INFO("memory budget allows the panorama at 1/%d size", scale);
+            }
+            return scale;
+        }
+    }
+    return PREVIEW_SCALE;
+}
+
+//asks for the portal image of projection p if it isn't loaded or on its way
+void GhostsApp::ensurePortalImage(int p)
+{
+    Projection &proj = mProjections[p];
+    if (!proj.hasImage || proj.imageFile || proj.imageRequested){
+        return;
+    }
+    
+    //a bundle holds the image already shrunk, its pixels are used where they are mapped
+    //they are the system's to page out, so they stay out of the budget
+    if (mBundle){
+        const BundleProjection &stored = mBundle->projection(p);
+        if (stored.imageWidth == 0){
+            proj.hasImage = false;
+            return;
+        }
+        proj.imageFile = Surface((uint8_t *)mBundle->pixels(stored.imageOffset), stored.imageWidth, stored.imageHeight,
+                                 stored.imageWidth * 4, SurfaceChannelOrder::RGBA);
+        proj.imageMapped = true;
+        return;
+    }
+    LoadJob job(LoadJob::PORTAL_IMAGE, portalUrl(proj.id), p);
+    job.hash = proj.imageHash; //read from the disk cache if it is there
+    job.maxWidth = PORTAL_MAX_WIDTH; //shrunk to what the overlay shows
+    job.maxHeight = PORTAL_MAX_HEIGHT;
+    request(job);
+    proj.imageRequested = true;
+}
+
+//update(): the portal image of projection p as a texture, uploaded the first time it is needed
+//empty until the image has arrived
+gl::Texture &GhostsApp::portalTexture(int p)
+{
+    Projection &proj = mProjections[p];
+    if (!proj.imageTexture){
+        TRACE_SPAN_ARG("upload portal image", p);
+        if (proj.imageFile && portalScale() > 1.0f){
+            Vec2i size(max(1, proj.imageFile.getWidth() / 2), max(1, proj.imageFile.getHeight() / 2));
+            Surface half = ip::resizeCopy(proj.imageFile, proj.imageFile.getBounds(), size);
+            proj.imageTexture = packedTexture(half, half.getBounds(), PORTAL_FORMAT);
+            mBudget.add(MemoryBudget::PORTAL_IMAGES, portalBytes(proj.imageTexture));
+            mPortalTextures.push_back(p);
+        }
+        else if (proj.imageFile){
+            proj.imageTexture = packedTexture(proj.imageFile, proj.imageFile.getBounds(), PORTAL_FORMAT);
+            mBudget.add(MemoryBudget::PORTAL_IMAGES, portalBytes(proj.imageTexture));
+            mPortalTextures.push_back(p);
+        }
+        else{
+            ensurePortalImage(p);
+        }
+    }
+    return proj.imageTexture;
+}
+
+//shows loadError in the middle of the screen
+void GhostsApp::drawLoadError()
+{
+    FontLock lock;
+    glPushMatrix();
+    glRotatef(90, 0, 0, 1);
+    gl::drawStringCentered(loadError, Vec2f(512, -384), ColorA(1,0.3,0.3,1), Font("Arial", 30));
+    glPopMatrix();
+}
+
+//logs how the connections to the server have been used so far
+void GhostsApp::logHttpStats()
+{
+    HttpClient::Stats stats = mLoader.http().getStats();
+    int fetched = stats.requests - stats.coalesced - stats.failures;
+    LOG_INFO("http: %u requests (%u shared, %u failed, %u retries), %u connections opened, %u reused, %.1f KB, mean %.3f s, slowest %.3f s",
+             stats.requests, stats.coalesced, stats.failures, stats.retries, stats.connectionsOpened, stats.connectionsReused,
+             stats.bytesReceived / 1024.0, fetched > 0 ? stats.totalSeconds / fetched : 0.0, stats.slowestSeconds);
+}
+
+//the full panorama at 1/scale of its size, cut into tiles by the loader as it is decoded
+LoadJob GhostsApp::panoramaJob(int scale)
+{
+    LoadJob job(LoadJob::PANORAMA, panoramaUrl(scale));
+    job.cut.areas = canopyTileAreas(panoramaWidth, ghostHeight, TILE_WIDTH, TILE_HEIGHT);
+    job.cut.panoramaWidth = panoramaWidth;
+    job.cut.panoramaHeight = ghostHeight;
+    job.cut.format = cutFormat();
+    return job;
+}
+
+//the format the loader packs the full panorama's tiles in: this canopy's, once it has been picked
+PixelFormat GhostsApp::cutFormat()
+{
+    if (mTileFormat != PIXELS_AUTO){
+        return mTileFormat;
+    }
+    return TILE_FORMAT == PIXELS_ETC1 && !mEtc1Supported ? PIXELS_RGB565 : TILE_FORMAT;
+}
+
+//the canopy image at 1/scale of its size
+string GhostsApp::panoramaUrl(int scale)
+{
+    ostringstream url;
+    url << SERVICES_URL << "getCanopyImage.php?c=" << canopyID << "&h=" << max(1, ghostHeight / scale) << "&w=" << max(1, panoramaWidth / scale) << "&x=" << 0 << "&y=" << 0;
+    return url.str();
+}
+
+//the low resolution tile ghost surface t drops back to when memory runs short
+gl::Texture GhostsApp::previewTile(int t)
+{
+    if (mBundle){
+        return bundleTile(mBundle->header().levelCount - 1, t);
+    }
+    return tileFrom(mPreview, t);
+}
+
+//tile t of a bundle level, uploaded straight from the mapped file
+gl::Texture GhostsApp::bundleTile(int level, int t)
+{
+    TRACE_SPAN_ARG("upload bundle tile", t);
+    const BundleTile &tile = mBundle->tile(level, t);
+    return packedTexture(mBundle->pixels(tile.pixelsOffset), tile.width * 4, 4, 0, 1, 2, tile.width, tile.height, mTileFormat);
+}
+
+//picks the format this canopy's tiles are kept in, once its first pixels have arrived
+void GhostsApp::chooseTileFormat(bool grey)
+{
+    if (mTileFormat != PIXELS_AUTO){
+        return;
+    }
+    mTileFormat = TILE_FORMAT;
+    if (mTileFormat == PIXELS_AUTO){
+        mTileFormat = grey ? PIXELS_L8 : PIXELS_RGB565;
+    }
+    else if (mTileFormat == PIXELS_ETC1 && !mEtc1Supported){
+        LOG_WARN("the GPU doesn't take ETC1 textures, keeping tiles as RGB565");
+        mTileFormat = PIXELS_RGB565;
+    }
+    LOG_INFO("canopy %d tiles are kept as %s%s", canopyID, pixelFormatName(mTileFormat), grey ? " (black and white)" : "");
+}
+
+//logs what the tiles cost in their format against full colour
+void GhostsApp::logTiles(double seconds)
+{
+    size_t bytes = 0;
+    size_t rgbaBytes = 0;
+    for (int t = 0; t < mGhostSurfaces.size(); t++){
+        bytes += tileBytes(mGhostSurfaces[t]);
+        rgbaBytes += textureBytes(mGhostSurfaces[t]);
+    }
+    LOG_INFO("%d tiles as %s: %.1f MB (%.1f MB as RGBA), cut and uploaded in %.1f ms", (int)mGhostSurfaces.size(), pixelFormatName(mTileFormat),
+             bytes / 1048576.0, rgbaBytes / 1048576.0, seconds * 1000.0);
+}
+
+//memory held by one of this canopy's tiles
+size_t GhostsApp::tileBytes(const gl::Texture &tile)
+{
+    return tile ? pixelFormatBytes(mTileFormat, tile.getWidth(), tile.getHeight()) : 0;
+}
+
+//cuts ghost surface t out of a panorama of any size
+gl::Texture GhostsApp::tileFrom(const Surface &image, int t)
+{
+    TRACE_SPAN_ARG("cut tile", t);
+    float scaleX = image.getWidth() / (float)panoramaWidth;
+    float scaleY = image.getHeight() / (float)ghostHeight;
+    const Area &area = mTileAreas[t];
+    int x1 = min((int)(area.getX1() * scaleX), image.getWidth() - 1);
+    int y1 = min((int)(area.getY1() * scaleY), image.getHeight() - 1);
+    int x2 = max(x1 + 1, min((int)ceil(area.getX2() * scaleX), image.getWidth()));
+    int y2 = max(y1 + 1, min((int)ceil(area.getY2() * scaleY), image.getHeight()));
+    return packedTexture(image, Area(x1, y1, x2, y2), mTileFormat);
+}
+
+//replaces ghost surface t and keeps the memory budget up to date
+void GhostsApp::setTile(int t, const gl::Texture &texture, bool full)
+{
+    mBudget.remove(mTileFull[t] ? MemoryBudget::FULL_TILES : MemoryBudget::PREVIEW_TILES, tileBytes(mGhostSurfaces[t]));
+    mGhostSurfaces[t] = texture;
+    mTileFull[t] = full;
+    mBudget.add(full ? MemoryBudget::FULL_TILES : MemoryBudget::PREVIEW_TILES, tileBytes(texture));
+}
+
+//if ghost surface t is one of the textures on screen
+bool GhostsApp::tileIsLive(int t)
+{
+    if (CYLINDER_VIEW){
+        for (size_t i = 0; i < mCylinderStrips.size(); i++){
+            if (mCylinder.tiles[mCylinderStrips[i]] == t){
+                return true;
+            }
+        }
+        return false;
+    }
+    if (liveIndex == -1){
+        return false;
+    }
+    int usedRows = min(SCREEN_ROWS, ghostRows);
+    int usedCols = min(SCREEN_COLS, ghostCols);
+    int col = (t / ghostRows - liveIndex / ghostRows + ghostCols) % ghostCols;
+    int row = (t % ghostRows - liveIndex % ghostRows + ghostRows) % ghostRows;
+    return col < usedCols && row < usedRows;
+}
+
+//gives memory back when the budget runs short:
+//first full resolution tiles off screen drop back to the preview, farthest first,
+//then portal images other than the one being shown are freed (they are downloaded again when shown)
+void GhostsApp::enforceMemoryBudget()
+{
+    if (mBudget.pressure() == MemoryBudget::NORMAL){
+        return;
+    }
+    size_t before = mBudget.used();
+    releasePageTextures(0); //the load screen isn't shown while a canopy is
+    
+    if (mPreview || mBundle){
+        int viewCol = liveIndex == -1 ? 0 : liveIndex / ghostRows;
+        vector< pair<int, int> > byDistance;
+        for (int t = 0; t < mGhostSurfaces.size(); t++){
+            if (mTileFull[t] && !tileIsLive(t)){
+                int colDistance = abs(t / ghostRows - viewCol);
+                colDistance = min(colDistance, ghostCols - colDistance);
+                byDistance.push_back(make_pair(colDistance, t));
+            }
+        }
+        sort(byDistance.begin(), byDistance.end());
+        for (int i = byDistance.size() - 1; i >= 0 && mBudget.pressure() != MemoryBudget::NORMAL; i--){
+            int t = byDistance[i].second;
+            setTile(t, previewTile(t), false);
+        }
+    }
+    
+    int shown = displayedObject != -1 ? mPositions.data[displayedObject] : -1;
+    for (int p = 0; p < mProjections.size() && mBudget.pressure() != MemoryBudget::NORMAL; p++){
+        if (p != shown && mProjections[p].imageFile && !mProjections[p].imageMapped){
+            mBudget.remove(MemoryBudget::PORTAL_IMAGES, surfaceBytes(mProjections[p].imageFile));
+            mProjections[p].imageFile = Surface();
+        }
+    }
+    
+    if (mBudget.used() < before){
+        LOG_WARN("memory budget: freed %.1f MB", (before - mBudget.used()) / 1048576.0);
+        mBudget.log();
+    }
+}
+
+string GhostsApp::portalUrl(int id)
+{
+    ostringstream url;
+    url << SERVICES_URL << "getPortalImage.php?p=" << id;
+    return url.str();
+}
+
+//releases portal textures of projections that are no longer on screen, scanned or shown
+void GhostsApp::releaseFarPortalTextures()
+{
+    for (int n = mPortalTextures.size() - 1; n >= 0; n--){
+        int p = mPortalTextures[n];
+        bool near = (displayedObject != -1 && mPositions.data[displayedObject] == p) ||
+                    (objectScanned != -1 && mPositions.data[objectScanned] == p);
+        for (int i = 0; i < mPositions.size() && !near; i++){
+            near = mVisible[i] && mPositions.data[i] == p;
+        }
+        if (!near){
+            mBudget.remove(MemoryBudget::PORTAL_IMAGES, portalBytes(mProjections[p].imageTexture));
+            mProjections[p].imageTexture = gl::Texture();
+            mPortalTextures.erase(mPortalTextures.begin() + n);
+        }
+    }
+}
+
+//advances the canopy view by one SIM_STEP: follows the gyro, moves the live window and runs the scan timer
+//true if the pose, the live window or what is being scanned changed, so the draw list has to be built again
+bool GhostsApp::stepView()
+{
+    float lastX = xOffset;
+    float lastY = yOffset;
+    float lastPitch = zPitch;
+    int lastIndex = liveIndex;
+    int lastScanned = objectScanned;
+    int lastDisplayed = displayedObject;
+    bool lastScanBox = showScanBox;
+    bool lastScanning = showScanning;
+    
+
+    //the yaw is followed even while paused so the view doesn't jump when it resumes
+    float yaw = mYaw.follow(rotation.y);
+    if (!isPaused){
+        CanopyPose pose = poseFor(canopyGrid(), yaw - modYaw, rotation.z - modRoll, rotation.x - modPitch);
+        xOffset = pose.xOffset;
+        yOffset = pose.yOffset;
+        zPitch = pose.pitch;
+        baseRow = pose.baseRow;
+        baseCol = pose.baseCol;
+    }
+    float pixelXOffset = xOffset;
+    float pixelYOffset = yOffset;
+    int gR = baseRow;
+    int gC = baseCol;
+    
+    int usedRows = min(SCREEN_ROWS, ghostRows);
+    int usedCols = min(SCREEN_COLS, ghostCols);
+    
+    int index = gC * ghostRows + gR;
+    if (CYLINDER_VIEW){
+        liveIndex = index; //the cylinder's tiles are picked by culling, this only tells loading where the view is
+    }
+    else if(index != liveIndex) {
+        
+        int b = 0;
+        int t = usedRows;
+        int l = 0;
+        int r = usedCols;
+        
+        if(liveIndex != -1) {
+            // Calculate the amount shifted (on the entire canopy)
+            int rShift = index % ghostRows - liveIndex % ghostRows;
+            int cShift = (index - index % ghostRows)/ghostRows - (liveIndex - liveIndex % ghostRows)/ghostRows;
+            
+            // This covers an edge case where the "lip" is passed over
+            if(abs(rShift) < usedRows && abs(cShift) < usedCols) {
                 
-                proj.textLines.resize(resizer);
-                proj.captionLines.resize(resizer);
+                // Convert that to an amount shifted on the texture matrix
+                rShift = rShift % usedRows;
+                cShift = cShift % usedCols;
                 
-                //Adds text to the structure
-                for (int q = 0; q < text.size() || q < caption.size(); q++){
-                    
-                    //Cuts down information text
-                    if (q < text.size()){
-                        line.append(text,q,1);//adds a character to the current line
-                        
-                        if (tracker < 40){//if the line is shorter than 40, keep adding to the line
-                            if (q == text.size() - 1){//if the end of the text has been reached, add the line to be displayed
-                                proj.textLines[place] = line;
-                                place++;
-                            }
-                            tracker++;
-                        }
-                        else{
-                            if (text.compare(q,1, " ") == 0){//if after a set of 40 characters there is a space, go to the next line
-                                resizer++;
-                                proj.textLines.resize(resizer);
-                                proj.textLines[place] = line;
-                                place++;
-                                line = "";
-                                tracker = 0;
-                            }
-                            else if (tracker == 45){//if the last word goes over the limit for a line, it is broken up with a "-"
-                                resizer++;
-                                proj.textLines.resize(resizer);
-                                line.append("-");
-                                proj.textLines[place] = line;
-                                place++;
-                                line = "";
-                                tracker = 0;
-                            }
-                            else{//if still on a word but less than 4 characters, keep adding characters
-                                tracker++;
-                            }
-                        }
-                    }
-                    
-                    //Cuts down caption text
-                    if (q < caption.size()){
-                        captionLine.append(caption,q,1);//adds a character to the current line
-                        
-                        if (captionTracker < 40){//if the line is shorter than 40, keep adding to the line
-                            if (q == caption.size() - 1){//if the end of the text has been reached, add the line to be displayed
-                                proj.captionLines[place2] = captionLine;
-                                place2++;
-                            }
-                            captionTracker++;
-                        }
-                        else{
-                            if (caption.compare(q,1, " ") == 0){//if after a set of 40 characters there is a space, go to the next line
-                                resizer++;
-                                proj.captionLines.resize(resizer);
-                                proj.captionLines[place2] = captionLine;
-                                place2++;
-                                captionLine = "";
-                                captionTracker = 0;
-                            }
-                            else if (captionTracker == 45){//if the last word goes over the limit for a line, it is broken up with a "-"
-                                proj.captionLines.resize(resizer);
-                                captionLine.append("-");
-                                proj.captionLines[place2] = captionLine;
-                                place2++;
-                                captionLine = "";
-                                captionTracker = 0;
-                            }
-                            else{//if still on a word but less than 4 characters, keep adding characters
-                                captionTracker++;
-                            }
+                if(cShift < 0) { // pan left (shift right)
+                    r = -cShift;
+                    for(int c = usedCols - 1; c >= -cShift; --c)
+                        for(int r = 0; r < usedRows ; ++r){
+                            mLiveTextures[c * usedRows + r] = mLiveTextures[ (c + cShift) * usedRows + r];
                         }
-                    }
                 }
                 
-                //adds the text to be displayed on the screen
-                gl::enableAlphaBlending();//enables transparency
-                float clearAlpha = 0.5f;// set transparency value
-                TextLayout textLayout;//information text
-                TextLayout captionText; // caption text
-                
-                captionText.clear(ColorA(0.0f,0.0f,0.0f,clearAlpha));//caption backgroud color
-                captionText.setFont(Font("Arial", 14));//caption font
-                captionText.setColor(Color(1.0f,1.0f,1.0f));//caption text color
-                
-                textLayout.clear(ColorA(0.0f,0.0f,0.0f,clearAlpha));//backgroud color
-                textLayout.setFont(Font("Arial", 18));//font
-                textLayout.setColor(Color(1.0f,1.0f,1.0f));//text color
-                
-                //add text lines for the object
-                for (int t = 0; t < proj.textLines.size(); t++){
-                    textLayout.addLine(proj.textLines[t]);
-                }
-                for (int t = 0; t < proj.captionLines.size(); t++){
-                    captionText.addLine(proj.captionLines[t]);
-                }
-                proj.info = textLayout;
-                proj.caption = captionText;
-                
-                proj.infoImage = gl::Texture(proj.info.render(true, false));
-                proj.captionImage = gl::Texture(proj.caption.render(true, false));
-                
-                proj.copiedBy = -1;
-                
-                //assigns structure
-                if (proj.offX >= ghostWidth){
-                    
-                    proj.copiedBy = cursor + 1;
-                    mProjections[cursor] = proj;
-                    
-                    proj.offX -= (ghostWidth);
-                    proj.copiedBy = -2;
-                    cursor++;
-                    mProjections.resize(mProjections.size() + 1);
-                    mProjections[cursor] = proj;
-                }
-                else{
-                    mProjections[cursor] = proj;
-                }
-                
-            }
-            
-            // Load canopy data
-            
-            console() << "gh " << ghostHeight << std::endl;
-            console() << "gw " << ghostWidth << std::endl;
-            
-            ghostRows = ceil(ghostHeight / (float)TILE_HEIGHT);
-            ghostCols = ceil(ghostWidth / (float)TILE_WIDTH);
-            mLiveTextures.resize(SCREEN_ROWS * SCREEN_COLS);
-            mGhostSurfaces.resize(ghostRows * (ghostCols + (1024 / TILE_WIDTH)));
-            
-            int ghostIndex = ghostRows * (1024 / TILE_WIDTH);
-            int startIndex = 0;
-            
-            oss.str("");
-            oss << "http://ghosts.slifty.com/services/getCanopyImage.php?c=" << canopyID << "&h=" << ghostHeight << "&w=" << ghostWidth << "&x=" << 0 << "&y=" << 0;
-            console() << oss.str() << std::endl;
-            
-            Surface panorama = Surface( loadImage( loadUrl( oss.str() ) ));
-            
-            for(int x = 0; x < ghostCols ; ++x) {
-                for(int y = 0; y < ghostRows ; ++y) {
-                    
-                    int gX = TILE_WIDTH * x;
-                    int gY = TILE_HEIGHT * y;
-                    int gH = min(TILE_HEIGHT, ghostHeight - TILE_HEIGHT * y);
-                    int gW = min(TILE_WIDTH, ghostWidth - TILE_WIDTH * x);
-                    
-                    mGhostSurfaces[ghostIndex] = gl::Texture(Surface(panorama.clone(Area(Vec2f(gX, gY), Vec2f(gX + gW, gY + gH)))));
-                    ghostIndex++;
-                    
-                    //adds end to beginning of image
-                    if (x == ghostCols - 1){
-                        gW = TILE_WIDTH;
-                        for (int u = (1024 / TILE_WIDTH); u > 0; u--){
-                            gX = ghostWidth - TILE_WIDTH * u;
-                            mGhostSurfaces[startIndex] = gl::Texture(Surface(panorama.clone(Area(Vec2f(gX, gY), Vec2f(gX + gW, gY + gH)))));
-                            startIndex++;
+                if(cShift > 0) { // pan right (shift left)
+                    l = usedCols - cShift;
+                    for(int c = 0; c < usedCols - cShift ; ++c)
+                        for(int r = 0; r < usedRows ; ++r){
+                            mLiveTextures[c * usedRows + r] = mLiveTextures[ (c + cShift) * usedRows + r];
                         }
-                    }
                 }
+            }    
+        }
+        
+        // Fill outdated data
+        for(int c = l; c < r ; ++c) {
+            for(int r = b; r < t ; ++r) {
+                int i = ((gC + c) % ghostCols) * ghostRows + ((gR + r) % ghostRows);
+                mLiveTextures[ c * usedRows + r ] = mGhostSurfaces[i];
             }
-            
-            console() << "col " << ghostCols << std::endl;
-            console() << "row " << ghostRows << std::endl;
-            
-            ghostWidth += 1024;
-            ghostCols += (1024 / TILE_WIDTH);
-            
-            
-            // loading buttons and surfaces
-            buttonSurface = gl::Texture(Surface( loadImage( loadResource( "Data.jpg"))));
-            selectedObject = gl::Texture(Surface(loadImage(loadResource("DataInverted.jpg"))));
-            pause = gl::Texture(Surface(loadImage(loadResource("PauseButton.jpg"))));
-            play = gl::Texture(Surface(loadImage(loadResource("PlayButton.jpg"))));
-            calibrate = gl::Texture(Surface(loadImage(loadResource("Calibrate.jpg"))));
-            switchPanorama = gl::Texture(Surface(loadImage(loadResource("SwitchPanorama.jpg"))));
-            
-            ISREADY = true;
-            enableRotation();
-        } 
+        }
         
-        // default is canopy
-        else {
-
-            gl::clear( Color( 0.0f, 0.0f, 0.0f ) );
-            
-            float pixelXOffset; //right tilt (- towards) (+ away)
-            float pixelYOffset; // top tilt (+ towards) (- away)
-            float pitch; // center spin (+ clockwise) (- counter clockwise)
-            
-            
-            // calculating change in gyro for Y direction, roll
-            pixelYOffset = -((rotation.z - modRoll + 3.1415/2) / (2 * 3.1415)) * ghostWidth - 1200.0f;
-            
-            //updates the actual X offset based on the difference between the past and current gyro reading
-            if(actuX == -1.0){
-                actuX = rotation.y;
-                currX = rotation.y;
-                prevX = rotation.y;
+        liveIndex = index;
+    }
+    
+    float actualCenterX = -1 * (pixelXOffset - (SCREEN_WIDTH / 2)); //determines what the center pixel on screen is in the canvas
+    float actualCenterY = -1 * (pixelYOffset - (SCREEN_HEIGHT / 2));//
+    
+    //creates a scannerX by scannerY rectangle scanning bound at the center of the screen
+    ScanView view;
+    view.pixelXOffset = pixelXOffset;
+    view.pixelYOffset = pixelYOffset;
+    view.screenWidth = 1024.0;
+    view.screenHeight = 768.0;
+    view.centerX = actualCenterX;
+    view.centerY = actualCenterY;
+    view.xHalfRange = scannerX / 2;
+    view.yHalfRange = scannerY / 2;
+    view.xBoxShift = 15.0; //the box is centered slightly off the object's corner
+    view.yBoxShift = 30.0;
+    
+    //finds which objects are on screen, which have the center in their scanning box and which of those is closest
+    int size = mPositions.size();
+    mVisible.resize(size);
+    mInBox.resize(size);
+    ScanResult scan;
+    scan.visibleCount = 0;
+    scan.nearest = -1;
+    if (size > 0){
+        scan = scanProjections(&mPositions.offX[0], &mPositions.offY[0], size, view, &mVisible[0], &mInBox[0]);
+    }
+    
+    if (scan.visibleCount > 0){
+        astralShiftX = pixelXOffset;
+        astralShiftY = pixelYOffset - SCREEN_HEIGHT;
+    }
+    
+    //counts the objects off each edge of the screen for the searching arrows
+    mDirections.count(pixelXOffset, pixelYOffset, ghostWidth/3, 1024.0, 768.0, top, bottom, left, right);
+    LOG_EVERY(LOG_LEVEL_TRACE, 1.0, "offset %.1f %.1f, %d visible, arrows t%d b%d l%d r%d", pixelXOffset, pixelYOffset, scan.visibleCount, top, bottom, left, right);
+    
+    //scanning only changes while something is on screen
+    showScanning = false;
+    if (scan.visibleCount > 0){
+        
+        //resets time and object being scanned if object leaves scanning box
+        if (objectScanned != -1 && !mInBox[objectScanned]){
+            oldTime = -1.0;
+            objectScanned = -1;
+            displayedObject = -1;
+            showScanBox = false;
+        }
+        
+        if (scan.nearest == -1){
+            //nothing is in the scanning box
+            oldTime = -1.0;
+            objectScanned = -1;
+            displayedObject = -1;
+            showScanBox = false;
+        }
+        else{
+            //selects object closet to center while scanning
+            objectScanned = scan.nearest;
+            dist = scan.nearestDist;
+            
+            //starts timer if no object is currently being scanned
+            if (oldTime == -1.0){ 
+                oldTime = mSimTime;
             }
+            
             else{
-                currX = rotation.y;
-                
-                if (prevX == currX){
-                    actuX = actuX;
-                }
-                else if (prevX > 0 && currX < 0){
-                    if(abs(prevX) < 0.5 && abs(currX) < 0.5){
-                        actuX -= abs(prevX + currX);
-                    }
-                    else{
-                        actuX += abs(prevX + currX);
-                    }
-                }
-                else if (prevX < 0 && currX < 0){
-                    if (prevX > currX){
-                        actuX -= abs(prevX - currX);
-                    }
-                    else if (prevX < currX){
-                        actuX += abs(prevX - currX);
-                    }
-                }
-                else if (prevX > 0 && currX > 0){
-                    if (prevX > currX){
-                        actuX -= abs(prevX - currX);
-                    }
-                    else if (prevX < currX){
-                        actuX += abs(prevX - currX);
-                    }
+                //displays event after SCAN_TIME seconds
+                if (SCAN_TIME < (mSimTime - oldTime)){ 
+                    displayedObject = objectScanned;
+                    showScanBox = false;
                 }
-                else if (prevX < 0 && currX > 0){
-                    if(abs(prevX) < 0.5 && abs(currX) < 0.5){
-                        actuX += abs(prevX + currX);
-                    }
-                    else{
-                        actuX -= abs(prevX + currX);
-                    }
+                //displays that an object is being scanned if less than SCAN_TIME seconds
+                else{
+                    showScanning = true;
+                    showScanBox = true;
                 }
-                
-                prevX = currX;
             }
-            
-            // calculating change in gyro for X direction (ipad is being held sideways), yaw            
-            pixelXOffset = ((actuX - modYaw)  / (2 * 3.1415)) * ghostWidth;
-            
-            //Transfers view to other end of image if reaches the end
-            
-            while (pixelXOffset >= 0) { 
-                pixelXOffset -= (ghostWidth - SCREEN_WIDTH);
-                
-            }
-            while(pixelXOffset < -(ghostWidth -  SCREEN_WIDTH)){
-                pixelXOffset += (ghostWidth - SCREEN_WIDTH);
+        }
+    }
+    
+    if (recentlyTouched){ //displays screen buttons when screen is touched
+        if (getElapsedSeconds() - timeTouched < 1.0 || isPaused){
+            showScanBox = !isPaused;
+        }
+        else{ //takes displayed buttons away
+            recentlyTouched = false;
+            showScanBox = false;
+        }
+    }
+    
+    return xOffset != lastX || yOffset != lastY || zPitch != lastPitch || liveIndex != lastIndex || objectScanned != lastScanned ||
+           displayedObject != lastDisplayed || showScanBox != lastScanBox || showScanning != lastScanning;
+}
+
+//lists what the canopy view looks like after the last step
+void GhostsApp::buildDrawList()
+{
+    mDrawListRotation = rotation;
+    
+    CanopyPose pose;
+    pose.xOffset = xOffset;
+    pose.yOffset = yOffset;
+    pose.pitch = zPitch;
+    pose.baseRow = baseRow;
+    pose.baseCol = baseCol;
+    
+    CanopyOverlays overlays;
+    overlays.count = mPositions.size();
+    overlays.offX = overlays.count > 0 ? &mPositions.offX[0] : 0;
+    overlays.offY = overlays.count > 0 ? &mPositions.offY[0] : 0;
+    overlays.data = overlays.count > 0 ? &mPositions.data[0] : 0;
+    overlays.visible = overlays.count > 0 ? &mVisible[0] : 0;
+    overlays.objectScanned = objectScanned;
+    overlays.displayedObject = displayedObject;
+    overlays.showScanning = showScanning;
+    overlays.showButtons = recentlyTouched;
+    overlays.paused = isPaused;
+    overlays.showScanBox = showScanBox;
+    overlays.scannerX = scannerX;
+    overlays.scannerY = scannerY;
+    overlays.top = top;
+    overlays.bottom = bottom;
+    overlays.left = left;
+    overlays.right = right;
+    
+    buildCanopyDrawList(mDrawList, canopyGrid(), pose, overlays);
+    if (CYLINDER_VIEW){
+        aimCylinder(pose);
+    }
+}
+
+//points mCam where the pose looks and culls the cylinder's tiles to what it sees
+void GhostsApp::aimCylinder(const CanopyPose &pose)
+{
+    CylinderCamera camera = cylinderCamera(mCylinder, canopyGrid(), pose);
+    mCam.setPerspective(camera.fov, getWindowWidth() / (float)getWindowHeight(), camera.nearClip, camera.farClip);
+    mCam.lookAt(Vec3f(camera.eye[0], camera.eye[1], camera.eye[2]), Vec3f(camera.target[0], camera.target[1], camera.target[2]),
+                Vec3f(camera.up[0], camera.up[1], camera.up[2]));
+    
+    Matrix44f viewProjection = mCam.getProjectionMatrix() * mCam.getModelViewMatrix();
+    cullCylinder(mCylinder, frustumFrom(viewProjection.m), mCylinderStrips);
+    LOG_EVERY(LOG_LEVEL_TRACE, 1.0, "cylinder: %d of %d tiles in view", (int)mCylinderStrips.size(), (int)mCylinder.tiles.size());
+}
+
+//draws the tiles mCam sees, each a strip of the cylinder's one vertex array
+void GhostsApp::drawCylinder()
+{
+    if (mCylinderStrips.empty()){
+        return;
+    }
+    gl::pushMatrices();
+    gl::setMatrices(mCam);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, &mCylinder.vertices[0]);
+    glTexCoordPointer(2, GL_FLOAT, 0, &mCylinder.coords[0]);
+    for (size_t i = 0; i < mCylinderStrips.size(); i++){
+        int s = mCylinderStrips[i];
+        const gl::Texture &tile = mGhostSurfaces[mCylinder.tiles[s]];
+        if (tile){
+            tile.enableAndBind();
+            glDrawArrays(GL_TRIANGLE_STRIP, mCylinder.first[s], mCylinder.count[s]);
+            tile.disable();
+        }
+    }
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    gl::popMatrices();
+}
+
+//draws an indicator where mCam sees its place on the cylinder, turned as the flat canvas would have it
+void GhostsApp::drawCylinderIndicator(const DrawItem &item)
+{
+    float point[3];
+    CanopyPose pose;
+    pose.xOffset = xOffset;
+    pose.yOffset = yOffset;
+    cylinderItemPoint(mCylinder, mDrawList, canopyGrid(), pose, item, point);
+    Vec3f world(point[0], point[1], point[2]);
+    if ((world - mCam.getEyePoint()).dot(mCam.getViewDirection()) <= 0.0f){
+        return; //behind the camera
+    }
+    Vec2f at = mCam.worldToScreen(world, getWindowWidth(), getWindowHeight());
+    glPushMatrix();
+    glTranslatef(at.x, at.y, 0.0f);
+    glRotatef(90 - mDrawList.pitch, 0.0, 0.0, 1.0);
+    gl::draw(item.texture ? selectedObject : buttonSurface, Vec2f(0.0f, 0.0f));
+    glPopMatrix();
+}
+
+//how the current canopy is cut into tiles
+CanopyGrid GhostsApp::canopyGrid()
+{
+    CanopyGrid grid;
+    grid.ghostWidth = ghostWidth;
+    grid.ghostHeight = ghostHeight;
+    grid.ghostRows = ghostRows;
+    grid.ghostCols = ghostCols;
+    grid.tileWidth = TILE_WIDTH;
+    grid.tileHeight = TILE_HEIGHT;
+    grid.screenWidth = SCREEN_WIDTH;
+    grid.screenHeight = SCREEN_HEIGHT;
+    grid.screenRows = SCREEN_ROWS;
+    grid.screenCols = SCREEN_COLS;
+    return grid;
+}
+
+//submits the draw list built by update()
+void GhostsApp::drawCanopy()
+{
+    gl::clear( Color( 0.0f, 0.0f, 0.0f ) );
+    if (CYLINDER_VIEW){
+        drawCylinder();
+    }
+    
+    bool onCanvas = false;
+    for (size_t i = 0; i < mDrawList.size(); i++){
+        const DrawItem &item = mDrawList[i];
+        
+        //on the cylinder the tiles are already drawn and the indicators are placed through the camera
+        if (CYLINDER_VIEW && item.onCanvas()){
+            if (item.kind == DrawItem::INDICATOR){
+                drawCylinderIndicator(item);
             }
-            
-            // calculating change in gyro for Z direction, pitch
-            pitch = (rotation.x - modPitch) / (2 * 3.1415) * 360.0f;
-            
-            if (isPaused){
-                pixelXOffset = xOffset;
-                pixelYOffset = yOffset;
-                pitch = zPitch;
+            continue;
+        }
+        
+        //tiles and indicators move with the canvas
+        if (item.onCanvas() != onCanvas){
+            onCanvas = item.onCanvas();
+            if (onCanvas){
+                glPushMatrix();
+                glRotatef(90 - mDrawList.pitch, 0.0, 0.0, 1.0);
+                glTranslatef(mDrawList.canvasX, mDrawList.canvasY, 0.0f );
             }
-            //Sets to a global variable
-            xOffset = pixelXOffset;
-            yOffset = pixelYOffset;
-            zPitch = pitch;
-            
-            // Figure out the base row / column to view
-            int gR = ghostRows - 1 - (((int)floor(pixelYOffset / TILE_HEIGHT) + ghostRows));
-            
-            LOWEST_ROW = floor(ghostHeight / TILE_HEIGHT);//Keeps iPad on the image
-            
-            if (gR < 0){
-                gR = 0;
+            else{
+                glPopMatrix();
             }
-            if (gR > LOWEST_ROW){
-                gR = LOWEST_ROW;
-            }                                           
-            
-            int gC = ghostCols - 1 - (((int)floor(pixelXOffset / TILE_WIDTH) + ghostCols));
-            
-            int usedRows = min(SCREEN_ROWS, ghostRows);
-            int usedCols = min(SCREEN_COLS, ghostCols);
-            
-            int index = gC * ghostRows + gR;
-            if(index != liveIndex) {
+        }
+        
+        //at lower quality the indicators are drawn together
+        if (item.kind == DrawItem::INDICATOR && mGovernor.level() >= BATCHED_INDICATORS){
+            i = drawIndicators(i) - 1;
+            continue;
+        }
+        
+        switch (item.kind){
+            case DrawItem::TILE:
+                gl::draw(mLiveTextures[item.texture], Rectf(item.x, item.y, item.x + item.width, item.y + item.height));
+                break;
                 
-                int b = 0;
-                int t = usedRows;
-                int l = 0;
-                int r = usedCols;
+            case DrawItem::INDICATOR:
+                gl::draw(item.texture ? selectedObject : buttonSurface, Vec2f(item.x, item.y));
+                break;
                 
-                if(liveIndex != -1) {
-                    // Calculate the amount shifted (on the entire canopy)
-                    int rShift = index % ghostRows - liveIndex % ghostRows;
-                    int cShift = (index - index % ghostRows)/ghostRows - (liveIndex - liveIndex % ghostRows)/ghostRows;
-                    
-                    // This covers an edge case where the "lip" is passed over
-                    if(abs(rShift) < usedRows && abs(cShift) < usedCols) {
-                        
-                        // Convert that to an amount shifted on the texture matrix
-                        rShift = rShift % usedRows;
-                        cShift = cShift % usedCols;
-                        
-                        if(cShift < 0) { // pan left (shift right)
-                            r = -cShift;
-                            for(int c = usedCols - 1; c >= -cShift; --c)
-                                for(int r = 0; r < usedRows ; ++r){
-                                    mLiveTextures[c * usedRows + r] = mLiveTextures[ (c + cShift) * usedRows + r];
-                                }
-                        }
-                        
-                        if(cShift > 0) { // pan right (shift left)
-                            l = usedCols - cShift;
-                            for(int c = 0; c < usedCols - cShift ; ++c)
-                                for(int r = 0; r < usedRows ; ++r){
-                                    mLiveTextures[c * usedRows + r] = mLiveTextures[ (c + cShift) * usedRows + r];
-                                }
-                        }
-                    }    
-                }
-                
-                // Fill outdated data
-                for(int c = l; c < r ; ++c) {
-                    for(int r = b; r < t ; ++r) {
-                        int i = ((gC + c) % ghostCols) * ghostRows + ((gR + r) % ghostRows);
-                        mLiveTextures[ c * usedRows + r ] = mGhostSurfaces[i];
-                    }
+            case DrawItem::SCANNING:
+                glPushMatrix();
+                glRotatef(90.0, 0.0, 0.0, 1.0);
+                {
+                    FontLock lock;
+                    gl::drawString("Scanning...", Vec2f(item.x, item.y),ColorA(1,1,1,1.0), Font("Arial", 55));
                 }
+                glPopMatrix();
+                break;
                 
-                liveIndex = index;
-            }
-            
-            glPushMatrix();
-            
-            int relXOffset = (int) pixelXOffset % TILE_WIDTH;
-            int relYOffset = (int) pixelYOffset % TILE_HEIGHT - SCREEN_HEIGHT;
-            
-            // move the picture in accordance to gyro readings
-            glRotatef(90 - pitch, 0.0, 0.0, 1.0);
-            glTranslatef(relXOffset, relYOffset, 0.0f );
-            
-            for(int c = 0; c < usedCols ; ++c) {                                                                          
-                for(int r = 0; r < usedRows ; ++r) {
-                    int gH = min(TILE_HEIGHT, ghostHeight - TILE_HEIGHT * ((gR + r)));
-                    int gW = min(TILE_WIDTH, ghostWidth - TILE_WIDTH * ((gC + c)));
-                    
-                    glPushMatrix();
-                    glTranslatef(c * TILE_WIDTH, r * TILE_HEIGHT, 0.0f );
-                    gl::draw(mLiveTextures[ c * usedRows + r ], Rectf(0.0f, 0.0f, (float)gW, (float)gH));
-                    glPopMatrix();
-                }
+            case DrawItem::BUTTON: {
+                gl::Texture *buttons[] = { &pause, &play, &calibrate, &switchPanorama };
+                gl::draw(*buttons[item.texture], Rectf(item.x, item.y, item.x + item.width, item.y + item.height));
+                break;
             }
-            
-            // drawing notices on objects and displays text/picture if an object has been scanned
-            int size = mProjections.size();
-            for (int i = 0; i < size; ++i) {
                 
-                //only displays objects that at on the screen (not off)
-                if(-mProjections[i].offY < pixelYOffset && -mProjections[i].offY > (pixelYOffset - 768.0)){
-                    if (-mProjections[i].offX < pixelXOffset && -mProjections[i].offX > (pixelXOffset - 1024.0)){
-                        
-                        if(displayedObject != i){
-                            if (objectScanned == i){
-                                glPushMatrix();
-                                glTranslatef(mProjections[i].offX + pixelXOffset - relXOffset, mProjections[i].offY + pixelYOffset - relYOffset - SCREEN_HEIGHT, 0.0f);
-                                gl::draw(selectedObject);//changes indicators icon if being scanned (pre-display)
-                                glPopMatrix();
-                            }
-                            else{
-                                //doesnt display indicator if object is being displayed
-                                glPushMatrix();
-                                glTranslatef(mProjections[i].offX + pixelXOffset - relXOffset, mProjections[i].offY + pixelYOffset - relYOffset - SCREEN_HEIGHT, 0.0f);
-                                gl::draw(gl::Texture(buttonSurface));
-                                glPopMatrix();
-                            }
-                        }
-                        astralShiftX = pixelXOffset;
-                        astralShiftY = pixelYOffset - SCREEN_HEIGHT;
-                    }
-                }
-                
-                if (abs(mProjections[i].offX + pixelXOffset) < ghostWidth/3){
-                    
-                    console() << pixelXOffset << endl;
-                    console() << mProjections[i].offX << endl;
-                    
-                    if (pixelXOffset > -mProjections[i].offX && pixelXOffset - SCREEN_WIDTH < -mProjections[i].offX){
-                        if (-mProjections[i].offY > pixelYOffset){
-                            top++;
-                        }
-                        else if ((-mProjections[i].offY) < pixelYOffset - 768.0){
-                            bottom++;
-                        }
-                    }
-                    
-                    if (-mProjections[i].offX > pixelXOffset){
-                        left++;
-                    }
-                    
-                    else if (-mProjections[i].offX < pixelXOffset - 1024){
-                        right++;
-                    }
-                    
-                }
+            case DrawItem::SCAN_BOX: {
+                float x1 = item.x;
+                float y1 = item.y;
+                float x2 = item.x + item.width;
+                float y2 = item.y + item.height;
+                gl::drawLine(Vec2f(x1, y2), Vec2f(x1, y1));
+                gl::drawLine(Vec2f(x1, y1), Vec2f(x2, y1));
+                gl::drawLine(Vec2f(x2, y1), Vec2f(x2, y2));
+                gl::drawLine(Vec2f(x2, y2), Vec2f(x1, y2));
+                break;
             }
-            
-            glPopMatrix();
-            
-            float actualCenterX = -1 * (pixelXOffset - (SCREEN_WIDTH / 2)); //determines what the center pixel on screen is in the canvas
-            float actualCenterY = -1 * (pixelYOffset - (SCREEN_HEIGHT / 2));//
-            
-            float objectX;//currently scanned object's X coordinate
-            float objectY;//currently scanned object's Y coordinate
-            
-            //creates a scannerX by scannerY rectangle scanning bound at the center of the screen
-            float xHalfRange = scannerX / 2; 
-            float yHalfRange = scannerY / 2; 
-            
-            for (int object = 0; object < size; object++){
                 
-                if(-mProjections[object].offY < pixelYOffset && -mProjections[object].offY > (pixelYOffset - 768.0)){
-                    if (-mProjections[object].offX < pixelXOffset && -mProjections[object].offX > (pixelXOffset - 1024.0)){
-                        
-                        if (objectScanned != -1){    //if something is being scanned, set the coordinates to that object
-                            objectX = mProjections[objectScanned].offX;
-                            objectY = mProjections[objectScanned].offY;
-                        }
-                        else{
-                            objectX = mProjections[object].offX; //if nothing is being scanned, set the coordinates to the current object
-                            objectY = mProjections[object].offY;
-                        }
-                        
-                        //find the bounds the center has to be in the scan the current object
-                        float xMax = (objectX + xHalfRange) + 15.0;
-                        float xMin = (objectX - xHalfRange) + 15.0;
-                        float yMax = (objectY + yHalfRange) + 30.0;
-                        float yMin = (objectY - yHalfRange) + 30.0;
-                        
-                        //checks to see if the object's x and y are in the rectange scanning bounds
-                        if (actualCenterX <= xMax && actualCenterX >= xMin){   
-                            if (actualCenterY <= yMax && actualCenterY >= yMin){
-                                
-                                if (objectScanned == -1){ //checks to see if an object is currently being scanned (-1 means no)
-                                    objectScanned = object;
-                                }
-                                else{
-                                    float objectDist = pow((actualCenterX - mProjections[object].offX),2) + pow((actualCenterY - mProjections[object].offY),2);//selects object closet to center while scanning                       
-                                    dist = pow((actualCenterX - objectX),2) + pow((actualCenterY - objectY),2);
-                                    
-                                    if(objectDist < dist){
-                                        dist = objectDist;
-                                        objectScanned = object;
-                                    }
-                                }
-                                
-                                //starts timer if no object is currently being scanned
-                                if (oldTime == -1.0){ 
-                                    oldTime = getElapsedSeconds();
-                                }
-                                
-                                else{
-                                    //displays event after SCAN_TIME seconds
-                                    if (SCAN_TIME < (getElapsedSeconds() - oldTime)){ 
-                                        displayedObject = objectScanned;
-                                        showScanBox = false;
-                                    }
-                                    //displays that an object is being scanned if less than SCAN_TIME seconds
-                                    else{
-                                        glPushMatrix();
-                                        glRotatef(90.0, 0.0, 0.0, 1.0);
-                                        //glTranslatef(780.0, -100.0, 0.0);
-                                        gl::drawString("Scanning...", Vec2f(750.0f,-90.0f),ColorA(1,1,1,1.0), Font("Arial", 55));
-                                        glPopMatrix();
-                                        showScanBox = true;
-                                    }
-                                }
-                            }
-                            else{
-                                //resets time and object being scanned if object leaves scanning box
-                                oldTime = -1.0; 
-                                objectScanned = -1;
-                                displayedObject = -1;
-                                showScanBox = false;
-                            }
-                            
-                        }
-                        else{
-                            //resets time and object being scanned if object leaves scanning box
-                            oldTime = -1.0; 
-                            objectScanned = -1;
-                            displayedObject = -1;
-                            showScanBox = false;
-                        }
-                    }
-                }
-            }
-            
-            if (recentlyTouched){ //displays screen buttons when screen is touched
-                if (getElapsedSeconds() - timeTouched < 1.0 || isPaused){
-                    
-                    if (isPaused){
-                        gl::draw(play, Rectf(0, 20.0f, 768.0f, 120.0f));
-                        gl::draw(switchPanorama, Rectf(0, 924, 100, 1024));
-                        showScanBox = false;
-                    }
-                    else{
-                        gl::draw(pause, Rectf(0.0f, 20.0f, 768.0f, 120.0f));
-                        gl::draw(calibrate, Rectf(668, 924, 768, 1024));
-                        gl::draw(switchPanorama, Rectf(0, 924, 100, 1024));
-                        showScanBox = true;
-                    }
-                }
-                else{ //takes displayed buttons away
-                    recentlyTouched = false;
-                    showScanBox = false;
-                }
-            }
-            
-            if (showScanBox){ //shows the scanning box
-                gl::drawLine(Vec2f(SCREEN_HEIGHT/2 - scannerY/2, SCREEN_WIDTH/2 + scannerX/2), Vec2f(SCREEN_HEIGHT/2 - scannerY/2, SCREEN_WIDTH/2 - scannerX/2));
-                gl::drawLine(Vec2f(SCREEN_HEIGHT/2 - scannerY/2, SCREEN_WIDTH/2 - scannerX/2), Vec2f(SCREEN_HEIGHT/2 + scannerY/2, SCREEN_WIDTH/2 - scannerX/2));
-                gl::drawLine(Vec2f(SCREEN_HEIGHT/2 + scannerY/2, SCREEN_WIDTH/2 - scannerX/2), Vec2f(SCREEN_HEIGHT/2 + scannerY/2, SCREEN_WIDTH/2 + scannerX/2));
-                gl::drawLine(Vec2f(SCREEN_HEIGHT/2 + scannerY/2, SCREEN_WIDTH/2 + scannerX/2), Vec2f(SCREEN_HEIGHT/2 - scannerY/2, SCREEN_WIDTH/2 + scannerX/2));
-            }
-            
-            //prevents duplication when going too low
-            if (pixelYOffset < -ghostHeight){
+            case DrawItem::TOO_LOW:
                 gl::clear( Color( 0.0f, 0.0f, 0.0f ) );
                 glPushMatrix();
                 glRotatef(90.0, 0.0, 0.0, 1.0);
-                gl::drawStringCentered("Too Low: Tilt Up", Vec2f(700.0f,-150.0f),ColorA(0,0,1,1), Font("Arial", 90));
+                {
+                    FontLock lock;
+                    gl::drawStringCentered("Too Low: Tilt Up", Vec2f(item.x, item.y),ColorA(0,0,1,1), Font("Arial", 90));
+                }
                 glPopMatrix();  
-            }
-            //prevents duplicaiton when going too high
-            if (pixelYOffset > ghostHeight){
+                break;
+                
+            case DrawItem::TOO_HIGH:
                 gl::clear( Color( 0.0f, 0.0f, 0.0f ) ); 
                 glPushMatrix();
                 glRotatef(90.0, 0.0, 0.0, 1.0);
-                gl::drawStringCentered("Too High: Tilt Down", Vec2f(700.0f,-818.0f),ColorA(1,0,0,1), Font("Arial", 90));
+                {
+                    FontLock lock;
+                    gl::drawStringCentered("Too High: Tilt Down", Vec2f(item.x, item.y),ColorA(1,0,0,1), Font("Arial", 90));
+                }
                 glPopMatrix();              
-            }
-        }
-        
-        if (displayedObject != -1){// if an object is being displayed, display text/pic
-            
-            glPushMatrix();
-            glTranslatef(500, 500, 0.0f);
-            glRotatef(90, 0, 0, 1);
-            
-            gl::enableAlphaBlending();//enables transparency
-            
-            //draws the text to the right of the object with an arrow pointing to it
-            glPushMatrix();
-            glTranslatef(150.0f, -100.0f, 0.0f);
-            gl::draw(mProjections[displayedObject].infoImage);
-            gl::drawVector(Vec3f(0.0f,50.0f,0.0f), Vec3f(-100.0f, 125.0f, 0.0f), 10.0f, 5.0f);
-            
-            //displays image gotten from server to the left of the object
-            if (mProjections[displayedObject].hasImage){
-                glPushMatrix();
+                break;
                 
+            case DrawItem::OVERLAY:
+                drawOverlay(item);
+                break;
                 
-                gl::draw(mProjections[displayedObject].captionImage, Vec2f(-(200.0 + mProjections[displayedObject].imageFile.getWidth()), mProjections[displayedObject].imageFile.getHeight()));//draws the caption text
-                
-                //draws the image
-                gl::draw(mProjections[displayedObject].imageFile, Vec2f(-(200.0 + mProjections[displayedObject].imageFile.getWidth()), 0.0));
-                
+            case DrawItem::ARROW:
+                glPushMatrix();
+                glTranslatef(item.x, item.y, 0.0);
+                glRotatef(item.angle, 0.0, 0.0, 1.0);
+                gl::drawSolidCircle(Vec2f(0.0, 0.0f), 20.0f, 4);
                 glPopMatrix();
-            }
-            
-            glPopMatrix();
-            
-            glPopMatrix();
+                break;
         }
-        
-        //searching arrows to indicate where projections are
-        if (right > 0){
-            glPushMatrix();
-            glTranslatef(384.0, 1000.0, 0.0);
-            glRotatef(90.0, 0.0, 0.0, 1.0);
-            gl::drawSolidCircle(Vec2f(0.0, 0.0f), 20.0f, 4);
-            glPopMatrix();
-        }
-        if (left > 0){
-            glPushMatrix();
-            glTranslatef(384.0, 44.0, 0.0);
-            glRotatef(-90.0, 0.0, 0.0, 1.0);
-            gl::drawSolidCircle(Vec2f(0.0, 0.0f), 20.0f, 4);
-            glPopMatrix();
+    }
+    if (onCanvas){
+        glPopMatrix();
+    }
+    
+    //remembers what this frame was drawn from so static frames can be skipped
+    lastDrawnRotation = mDrawListRotation;
+    frameDirty = false;
+    
+    //the frame's cost against its budget, which is longer while the frame rate is halved
+    if (GOVERN_QUALITY && mFrameStart != 0.0){
+        double budget = FRAME_BUDGET_MS / 1000.0 * ACTIVE_FRAME_RATE / activeFrameRate();
+        mGovernor.addFrame(Log::now(), (Log::now() - mFrameStart) / budget);
+        if (mGovernor.changed()){
+            applyQuality();
         }
-        if (top > 0){
-            glPushMatrix();
-            glTranslatef(744.0, 512, 0.0);
-            gl::drawSolidCircle(Vec2f(0.0, 0.0f), 20.0f, 4);
-            
-            glPopMatrix();
+    }
+}
+
+//draws the run of indicators starting at first with one call per icon, returns the item after the run
+size_t GhostsApp::drawIndicators(size_t first)
+{
+    size_t end = first;
+    while (end < mDrawList.size() && mDrawList[end].kind == DrawItem::INDICATOR){
+        end++;
+    }
+    
+    gl::Texture *icons[] = { &buttonSurface, &selectedObject };
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    for (int icon = 0; icon < 2; icon++){
+        const gl::Texture &texture = *icons[icon];
+        Rectf coords = texture.getAreaTexCoords(texture.getCleanBounds());
+        mIndicatorVertices.clear();
+        mIndicatorCoords.clear();
+        for (size_t i = first; i < end; i++){
+            if (mDrawList[i].texture != icon){
+                continue;
+            }
+            float x1 = mDrawList[i].x;
+            float y1 = mDrawList[i].y;
+            float x2 = x1 + texture.getWidth();
+            float y2 = y1 + texture.getHeight();
+            float quad[] = { x1, y1, x2, y1, x2, y2, x1, y1, x2, y2, x1, y2 };
+            float quadCoords[] = { coords.x1, coords.y1, coords.x2, coords.y1, coords.x2, coords.y2,
+                                   coords.x1, coords.y1, coords.x2, coords.y2, coords.x1, coords.y2 };
+            mIndicatorVertices.insert(mIndicatorVertices.end(), quad, quad + 12);
+            mIndicatorCoords.insert(mIndicatorCoords.end(), quadCoords, quadCoords + 12);
         }
-        if (bottom > 0){
-            glPushMatrix();
-            glTranslatef(24.0, 512.0, 0.0);
-            glRotatef(180.0, 0.0, 0.0, 1.0);
-            gl::drawSolidCircle(Vec2f(0.0, 0.0f), 20.0f, 4);
-            glPopMatrix();
+        if (mIndicatorVertices.empty()){
+            continue;
         }
-        
-        //resets count
-        top = 0;
-        bottom = 0;
-        right = 0;
-        left = 0;
+        texture.enableAndBind();
+        glVertexPointer(2, GL_FLOAT, 0, &mIndicatorVertices[0]);
+        glTexCoordPointer(2, GL_FLOAT, 0, &mIndicatorCoords[0]);
+        glDrawArrays(GL_TRIANGLES, 0, mIndicatorVertices.size() / 2);
+        texture.disable();
+    }
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    return end;
+}
+
+//the frame rate while the view is changing
+float GhostsApp::activeFrameRate()
+{
+    return mGovernor.level() >= HALF_FRAME_RATE ? ACTIVE_FRAME_RATE / 2.0f : ACTIVE_FRAME_RATE;
+}
+
+//how many times larger portal images are drawn than they are uploaded
+float GhostsApp::portalScale()
+{
+    return mGovernor.level() >= HALF_PORTAL_IMAGES ? 2.0f : 1.0f;
+}
+
+//puts a new quality level from the frame governor into effect
+void GhostsApp::applyQuality()
+{
+    //portal images are uploaded again at the new size when they are next needed
+    for (int n = 0; n < mPortalTextures.size(); n++){
+        Projection &proj = mProjections[mPortalTextures[n]];
+        mBudget.remove(MemoryBudget::PORTAL_IMAGES, portalBytes(proj.imageTexture));
+        proj.imageTexture = gl::Texture();
+    }
+    mPortalTextures.clear();
+    
+    if (mBundle && mLoadState == VIEWING && bundleTileLevel() != mTileLevel){
+        uploadBundleTiles(bundleTileLevel());
+    }
+    if (!hasLastFrame){
+        setFrameRate(activeFrameRate());
     }
+    frameDirty = true;
 }
 
+//draws the description of the shown object, and its portal image and caption once the image has arrived
+void GhostsApp::drawOverlay(const DrawItem &item)
+{
+    Projection &shown = mProjections[item.texture];
+    const gl::Texture &image = shown.imageTexture; //uploaded by update(), left out until it is
+    
+    glPushMatrix();
+    glTranslatef(item.x, item.y, 0.0f);
+    glRotatef(90, 0, 0, 1);
+    
+    gl::enableAlphaBlending();//enables transparency
+    
+    //draws the text to the right of the object with an arrow pointing to it
+    glPushMatrix();
+    glTranslatef(150.0f, -100.0f, 0.0f);
+    gl::draw(shown.infoImage);
+    gl::drawVector(Vec3f(0.0f,50.0f,0.0f), Vec3f(-100.0f, 125.0f, 0.0f), 10.0f, 5.0f);
+    
+    //displays image gotten from server to the left of the object (once it has arrived)
+    if (shown.hasImage && image){
+        glPushMatrix();
+        
+        float imageWidth = image.getWidth() * portalScale();
+        float imageHeight = image.getHeight() * portalScale();
+        gl::draw(shown.captionImage, Vec2f(-(200.0 + imageWidth), imageHeight));//draws the caption text
+        
+        //draws the image
+        gl::draw(image, Rectf(-(200.0 + imageWidth), 0.0, -200.0, imageHeight));
+        
+        glPopMatrix();
+    }
+    
+    glPopMatrix();
+    
+    glPopMatrix();
+}
 
 CINDER_APP_COCOA_TOUCH( GhostsApp, RendererGl )
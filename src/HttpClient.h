@@ -0,0 +1,527 @@
+#pragma once
+
+//HTTP/1.1 client for the canopy services
+//  - keeps connections open and reuses them for later requests to the same server
+//  - concurrent requests for the same URL share one fetch
+//  - connect/read timeouts, and bounded retries with exponential backoff on network errors and 5xx
+//  - counts requests, bytes and latency
+//Failures are reported through the return value and HttpResponse::error, never thrown.
+
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "Log.h"
+
+struct HttpResponse {
+    int status; //HTTP status, 0 if no response was received
+    std::string body;
+    std::map<std::string, std::string> headers; //names are lower case
+    std::string error; //why the request failed
+    double seconds; //time taken, including retries
+
+    HttpResponse() : status(0), seconds(0.0) {}
+
+    std::string header(const std::string &name) const {
+        std::map<std::string, std::string>::const_iterator found = headers.find(name);
+        return found != headers.end() ? found->second : std::string();
+    }
+};
+
+class HttpClient {
+public:
+    struct Stats {
+        unsigned requests;          //calls to get()
+        unsigned coalesced;         //calls that waited on an identical request instead of fetching
+        unsigned failures;          //calls that gave up
+        unsigned retries;           //extra attempts after an error
+        unsigned connectionsOpened;
+        unsigned connectionsReused;
+        double bytesReceived;
+        double totalSeconds;        //summed latency of fetched requests
+        double slowestSeconds;
+
+        Stats() : requests(0), coalesced(0), failures(0), retries(0), connectionsOpened(0), connectionsReused(0),
+                  bytesReceived(0.0), totalSeconds(0.0), slowestSeconds(0.0) {}
+    };
+
+    HttpClient() : timeout(15.0), maxRetries(3), backoff(0.5), maxIdlePerHost(4) {
+        pthread_mutex_init(&mutex, 0);
+    }
+
+    ~HttpClient() {
+        closeIdle();
+        pthread_mutex_destroy(&mutex);
+    }
+
+    //seconds allowed for connecting and for each read or write
+    void setTimeout(double seconds) {
+        timeout = seconds;
+    }
+
+    //retries after the first attempt; the wait doubles from backoffSeconds each time
+    void setRetries(int retries, double backoffSeconds) {
+        maxRetries = retries;
+        backoff = backoffSeconds;
+    }
+
+    //fetches url; true if a 2xx or 304 response was received
+    bool get(const std::string &url, HttpResponse &response, const std::map<std::string, std::string> &extraHeaders = std::map<std::string, std::string>()) {
+        //joins an identical request that is already running
+        std::string key = url + requestKey(extraHeaders);
+        pthread_mutex_lock(&mutex);
+        stats.requests++;
+        std::map<std::string, InFlight *>::iterator running = inFlight.find(key);
+        if (running != inFlight.end()){
+            InFlight *shared = running->second;
+            shared->waiters++;
+            stats.coalesced++;
+            while (!shared->done){
+                pthread_cond_wait(&shared->finished, &mutex);
+            }
+            response = shared->response;
+            bool ok = shared->ok;
+            if (--shared->waiters == 0){
+                delete shared;
+            }
+            pthread_mutex_unlock(&mutex);
+            return ok;
+        }
+        InFlight *mine = new InFlight();
+        inFlight[key] = mine;
+        pthread_mutex_unlock(&mutex);
+
+        double start = Log::now();
+        bool ok = fetchWithRetries(url, extraHeaders, response);
+        response.seconds = Log::now() - start;
+
+        pthread_mutex_lock(&mutex);
+        if (ok){
+            stats.bytesReceived += response.body.size();
+            stats.totalSeconds += response.seconds;
+            stats.slowestSeconds = std::max(stats.slowestSeconds, response.seconds);
+        }
+        else{
+            stats.failures++;
+        }
+        inFlight.erase(key);
+        mine->response = response;
+        mine->ok = ok;
+        mine->done = true;
+        pthread_cond_broadcast(&mine->finished);
+        if (--mine->waiters == 0){
+            delete mine;
+        }
+        pthread_mutex_unlock(&mutex);
+        return ok;
+    }
+
+    Stats getStats() {
+        pthread_mutex_lock(&mutex);
+        Stats copy = stats;
+        pthread_mutex_unlock(&mutex);
+        return copy;
+    }
+
+    //closes every pooled connection
+    void closeIdle() {
+        pthread_mutex_lock(&mutex);
+        for (std::map<std::string, std::vector<int> >::iterator i = idle.begin(); i != idle.end(); ++i){
+            for (size_t c = 0; c < i->second.size(); c++){
+                close(i->second[c]);
+            }
+        }
+        idle.clear();
+        pthread_mutex_unlock(&mutex);
+    }
+
+private:
+    struct InFlight {
+        bool done;
+        bool ok;
+        int waiters;
+        HttpResponse response;
+        pthread_cond_t finished;
+
+        InFlight() : done(false), ok(false), waiters(1) {
+            pthread_cond_init(&finished, 0);
+        }
+        ~InFlight() {
+            pthread_cond_destroy(&finished);
+        }
+    };
+
+    struct Target {
+        std::string host;
+        std::string port;
+        std::string path;
+    };
+
+    static std::string requestKey(const std::map<std::string, std::string> &headers) {
+        std::string key;
+        for (std::map<std::string, std::string>::const_iterator i = headers.begin(); i != headers.end(); ++i){
+            key += "\n" + i->first + ": " + i->second;
+        }
+        return key;
+    }
+
+    static bool parseUrl(const std::string &url, Target &target) {
+        const std::string scheme = "http://";
+        if (url.compare(0, scheme.size(), scheme) != 0){
+            return false;
+        }
+        size_t hostStart = scheme.size();
+        size_t pathStart = url.find('/', hostStart);
+        std::string hostPort = url.substr(hostStart, pathStart == std::string::npos ? std::string::npos : pathStart - hostStart);
+        target.path = pathStart == std::string::npos ? "/" : url.substr(pathStart);
+        size_t colon = hostPort.find(':');
+        target.host = hostPort.substr(0, colon);
+        target.port = colon == std::string::npos ? "80" : hostPort.substr(colon + 1);
+        return !target.host.empty();
+    }
+
+    bool fetchWithRetries(const std::string &url, const std::map<std::string, std::string> &extraHeaders, HttpResponse &response) {
+        Target target;
+        if (!parseUrl(url, target)){
+            response.error = "unsupported url " + url;
+            return false;
+        }
+
+        for (int attempt = 0; ; attempt++){
+            response = HttpResponse();
+            bool received = fetchOnce(target, extraHeaders, response);
+            bool ok = received && ((response.status >= 200 && response.status < 300) || response.status == 304);
+            if (ok){
+                return true;
+            }
+            if (received && response.error.empty()){
+                char text[64];
+                snprintf(text, sizeof(text), "HTTP status %d", response.status);
+                response.error = text;
+            }
+
+            //client errors won't change by asking again
+            bool retryable = !received || response.status >= 500;
+            if (!retryable || attempt >= maxRetries){
+                return false;
+            }
+
+            pthread_mutex_lock(&mutex);
+            stats.retries++;
+            pthread_mutex_unlock(&mutex);
+
+            double wait = backoff * (1 << attempt) * (0.75 + 0.5 * (rand() / (double)RAND_MAX));
+            usleep((useconds_t)(wait * 1000000.0));
+        }
+    }
+
+    //one request; a pooled connection the server has since closed is replaced once without counting as a retry
+    bool fetchOnce(const Target &target, const std::map<std::string, std::string> &extraHeaders, HttpResponse &response) {
+        std::string hostKey = target.host + ":" + target.port;
+        for (int pass = 0; pass < 2; pass++){
+            bool reused = false;
+            int fd = takeIdle(hostKey);
+            if (fd != -1){
+                reused = true;
+            }
+            else{
+                fd = connectTo(target, response.error);
+                if (fd == -1){
+                    return false;
+                }
+            }
+
+            pthread_mutex_lock(&mutex);
+            if (reused){
+                stats.connectionsReused++;
+            }
+            else{
+                stats.connectionsOpened++;
+            }
+            pthread_mutex_unlock(&mutex);
+
+            std::string request = "GET " + target.path + " HTTP/1.1\r\nHost: " + target.host +
+                                  "\r\nConnection: keep-alive\r\nAccept-Encoding: identity\r\n";
+            for (std::map<std::string, std::string>::const_iterator i = extraHeaders.begin(); i != extraHeaders.end(); ++i){
+                request += i->first + ": " + i->second + "\r\n";
+            }
+            request += "\r\n";
+
+            bool gotAnything = false;
+            bool keepAlive = false;
+            if (sendAll(fd, request) && readResponse(fd, response, gotAnything, keepAlive)){
+                if (keepAlive){
+                    giveIdle(hostKey, fd);
+                }
+                else{
+                    close(fd);
+                }
+                return true;
+            }
+            close(fd);
+
+            if (!(reused && !gotAnything)){
+                if (response.error.empty()){
+                    response.error = "connection to " + hostKey + " failed";
+                }
+                return false;
+            }
+            response = HttpResponse();
+        }
+        return false;
+    }
+
+    int takeIdle(const std::string &hostKey) {
+        int fd = -1;
+        pthread_mutex_lock(&mutex);
+        std::vector<int> &pool = idle[hostKey];
+        if (!pool.empty()){
+            fd = pool.back();
+            pool.pop_back();
+        }
+        pthread_mutex_unlock(&mutex);
+        return fd;
+    }
+
+    void giveIdle(const std::string &hostKey, int fd) {
+        pthread_mutex_lock(&mutex);
+        std::vector<int> &pool = idle[hostKey];
+        if ((int)pool.size() < maxIdlePerHost){
+            pool.push_back(fd);
+            fd = -1;
+        }
+        pthread_mutex_unlock(&mutex);
+        if (fd != -1){
+            close(fd);
+        }
+    }
+
+    int connectTo(const Target &target, std::string &error) {
+        addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo *addresses = 0;
+        if (getaddrinfo(target.host.c_str(), target.port.c_str(), &hints, &addresses) != 0 || !addresses){
+            error = "can't resolve " + target.host;
+            return -1;
+        }
+
+        int fd = -1;
+        for (addrinfo *a = addresses; a && fd == -1; a = a->ai_next){
+            fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+            if (fd == -1){
+                continue;
+            }
+
+            //connects without blocking so the timeout applies
+            int flags = fcntl(fd, F_GETFL, 0);
+            fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+            int result = connect(fd, a->ai_addr, a->ai_addrlen);
+            if (result != 0 && errno == EINPROGRESS){
+                fd_set writable;
+                FD_ZERO(&writable);
+                FD_SET(fd, &writable);
+                timeval limit = toTimeval(timeout);
+                if (select(fd + 1, 0, &writable, 0, &limit) == 1){
+                    int socketError = 0;
+                    socklen_t length = sizeof(socketError);
+                    getsockopt(fd, SOL_SOCKET, SO_ERROR, &socketError, &length);
+                    result = socketError == 0 ? 0 : -1;
+                }
+                else{
+                    result = -1;
+                }
+            }
+            if (result != 0){
+                close(fd);
+                fd = -1;
+                continue;
+            }
+            fcntl(fd, F_SETFL, flags);
+
+            timeval limit = toTimeval(timeout);
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &limit, sizeof(limit));
+            setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &limit, sizeof(limit));
+            int yes = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+#ifdef SO_NOSIGPIPE
+            setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &yes, sizeof(yes));
+#endif
+        }
+        freeaddrinfo(addresses);
+
+        if (fd == -1){
+            error = "can't connect to " + target.host + ":" + target.port;
+        }
+        return fd;
+    }
+
+    static timeval toTimeval(double seconds) {
+        timeval tv;
+        tv.tv_sec = (long)seconds;
+        tv.tv_usec = (long)((seconds - tv.tv_sec) * 1000000.0);
+        return tv;
+    }
+
+    static bool sendAll(int fd, const std::string &data) {
+#ifdef MSG_NOSIGNAL
+        const int flags = MSG_NOSIGNAL;
+#else
+        const int flags = 0;
+#endif
+        size_t sent = 0;
+        while (sent < data.size()){
+            ssize_t n = send(fd, data.data() + sent, data.size() - sent, flags);
+            if (n < 0 && errno == EINTR){
+                continue;
+            }
+            if (n <= 0){
+                return false;
+            }
+            sent += n;
+        }
+        return true;
+    }
+
+    //reads more of the response into buffer; false on error, timeout or a closed connection
+    static bool readMore(int fd, std::string &buffer) {
+        char chunk[16384];
+        for (;;){
+            ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+            if (n < 0 && errno == EINTR){
+                continue;
+            }
+            if (n <= 0){
+                return false;
+            }
+            buffer.append(chunk, n);
+            return true;
+        }
+    }
+
+    bool readResponse(int fd, HttpResponse &response, bool &gotAnything, bool &keepAlive) {
+        std::string buffer;
+        size_t headerEnd;
+        while ((headerEnd = buffer.find("\r\n\r\n")) == std::string::npos){
+            if (!readMore(fd, buffer)){
+                response.error = buffer.empty() ? "no response" : "response cut off";
+                gotAnything = !buffer.empty();
+                return false;
+            }
+            gotAnything = true;
+        }
+
+        //status line and headers
+        std::string head = buffer.substr(0, headerEnd);
+        buffer.erase(0, headerEnd + 4);
+        size_t lineEnd = head.find("\r\n");
+        std::string statusLine = head.substr(0, lineEnd);
+        size_t space = statusLine.find(' ');
+        response.status = space == std::string::npos ? 0 : atoi(statusLine.c_str() + space + 1);
+        bool http11 = statusLine.compare(0, 8, "HTTP/1.1") == 0;
+        while (lineEnd != std::string::npos){
+            size_t start = lineEnd + 2;
+            lineEnd = head.find("\r\n", start);
+            std::string line = head.substr(start, lineEnd == std::string::npos ? std::string::npos : lineEnd - start);
+            size_t colon = line.find(':');
+            if (colon == std::string::npos){
+                continue;
+            }
+            std::string name = line.substr(0, colon);
+            std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+            size_t valueStart = line.find_first_not_of(" \t", colon + 1);
+            response.headers[name] = valueStart == std::string::npos ? "" : line.substr(valueStart);
+        }
+
+        std::string connection = response.header("connection");
+        std::transform(connection.begin(), connection.end(), connection.begin(), ::tolower);
+        keepAlive = http11 ? connection != "close" : connection == "keep-alive";
+
+        //body
+        bool noBody = response.status == 204 || response.status == 304 || (response.status >= 100 && response.status < 200);
+        std::string transfer = response.header("transfer-encoding");
+        std::transform(transfer.begin(), transfer.end(), transfer.begin(), ::tolower);
+        if (noBody){
+            response.body.clear();
+        }
+        else if (transfer.find("chunked") != std::string::npos){
+            if (!readChunked(fd, buffer, response.body)){
+                response.error = "chunked body cut off";
+                return false;
+            }
+        }
+        else if (!response.header("content-length").empty()){
+            size_t length = strtoul(response.header("content-length").c_str(), 0, 10);
+            response.body.swap(buffer);
+            response.body.reserve(length);
+            while (response.body.size() < length){
+                if (!readMore(fd, response.body)){
+                    response.error = "body cut off";
+                    return false;
+                }
+            }
+            response.body.resize(length);
+        }
+        else{
+            //no length: the body runs until the server closes the connection
+            response.body.swap(buffer);
+            while (readMore(fd, response.body)){
+            }
+            keepAlive = false;
+        }
+        return true;
+    }
+
+    static bool readChunked(int fd, std::string &buffer, std::string &body) {
+        for (;;){
+            size_t lineEnd;
+            while ((lineEnd = buffer.find("\r\n")) == std::string::npos){
+                if (!readMore(fd, buffer)){
+                    return false;
+                }
+            }
+            size_t size = strtoul(buffer.c_str(), 0, 16);
+            buffer.erase(0, lineEnd + 2);
+            if (size == 0){
+                //skips trailers up to the final blank line
+                while (buffer.find("\r\n") == std::string::npos || (buffer.compare(0, 2, "\r\n") != 0 && buffer.find("\r\n\r\n") == std::string::npos)){
+                    if (!readMore(fd, buffer)){
+                        return false;
+                    }
+                }
+                return true;
+            }
+            while (buffer.size() < size + 2){
+                if (!readMore(fd, buffer)){
+                    return false;
+                }
+            }
+            body.append(buffer, 0, size);
+            buffer.erase(0, size + 2);
+        }
+    }
+
+    double timeout;
+    int maxRetries;
+    double backoff;
+    int maxIdlePerHost;
+
+    pthread_mutex_t mutex; //guards everything below
+    Stats stats;
+    std::map<std::string, std::vector<int> > idle; //open connections by host:port
+    std::map<std::string, InFlight *> inFlight; //requests being fetched by URL
+};
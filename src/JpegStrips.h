@@ -0,0 +1,523 @@
+#pragma once
+
+//A baseline JPEG decoder that hands the image out a row of MCUs (8 or 16 pixel rows) at a time, without Cinder or libjpeg
+//  - only one row of MCUs is decoded at a time, so the image is never whole in memory
+//  - the entropy coded data is read straight out of the downloaded bytes
+//  - decodes what the canopy services send: 8 bit baseline (and extended Huffman) JPEGs, grey or YCbCr, any sampling, restart markers
+//  - progressive, arithmetic coded, 12 bit and CMYK JPEGs aren't decoded: open() returns false and they are decoded whole elsewhere
+//Chroma is upsampled by repeating samples rather than by libjpeg's interpolation.
+//
+//  JpegStrips jpeg;
+//  if (jpeg.open(bytes, size)){
+//      while (jpeg.decodeRows()){
+//          for (int i = 0; i < jpeg.rows(); i++) jpeg.convertRow(i, out + (jpeg.top() + i) * rowBytes);
+//      }
+//  }
+
+#include <string.h>
+#include <vector>
+#include <stdexcept>
+#include <algorithm>
+
+class JpegStrips {
+public:
+    JpegStrips() : imageWidth(0), imageHeight(0), restartInterval(0), at(0), end(0), mcuRow(0), mcuRows(0), mcuCols(0), mcuWidth(8), mcuHeight(8),
+                   maxH(1), maxV(1), bitBuffer(0), bitCount(0), hitMarker(false), untilRestart(0) {
+        memset(tableLoaded, 0, sizeof(tableLoaded));
+    }
+
+    //reads the headers up to the image data, false if it isn't a JPEG this can decode
+    bool open(const unsigned char *bytes, size_t size) {
+        if (size < 4 || bytes[0] != 0xff || bytes[1] != 0xd8){
+            return false;
+        }
+        size_t p = 2;
+        for (;;){
+            if (p + 4 > size || bytes[p] != 0xff){
+                return false;
+            }
+            int marker = bytes[p + 1];
+            if (marker == 0xff){ //fill byte
+                p++;
+                continue;
+            }
+            p += 2;
+            if (marker == 0x01 || (marker >= 0xd0 && marker <= 0xd8)){ //markers without a segment
+                continue;
+            }
+            if (marker == 0xd9){
+                return false;
+            }
+            size_t length = bytes[p] << 8 | bytes[p + 1];
+            if (length < 2 || p + length > size){
+                return false;
+            }
+            const unsigned char *segment = bytes + p + 2;
+            size_t segmentLength = length - 2;
+            p += length;
+
+            if (marker == 0xdb){
+                if (!readQuantization(segment, segmentLength)){
+                    return false;
+                }
+            }
+            else if (marker == 0xc4){
+                if (!readHuffman(segment, segmentLength)){
+                    return false;
+                }
+            }
+            else if (marker == 0xc0 || marker == 0xc1){
+                if (!readFrame(segment, segmentLength)){
+                    return false;
+                }
+            }
+            else if ((marker >= 0xc2 && marker <= 0xcf) && marker != 0xc4 && marker != 0xc8 && marker != 0xcc){
+                return false; //progressive, lossless or arithmetic coded
+            }
+            else if (marker == 0xdd){
+                if (segmentLength < 2){
+                    return false;
+                }
+                restartInterval = segment[0] << 8 | segment[1];
+            }
+            else if (marker == 0xda){
+                if (!readScan(segment, segmentLength)){
+                    return false;
+                }
+                at = bytes + p;
+                end = bytes + size;
+                return true;
+            }
+        }
+    }
+
+    int width() const {
+        return imageWidth;
+    }
+
+    int height() const {
+        return imageHeight;
+    }
+
+    //1 for grey, 3 for colour (convertRow() gives RGB)
+    int channels() const {
+        return components.size() == 1 ? 1 : 3;
+    }
+
+    //decodes the next row of MCUs, false once the whole image has been; throws if the data is broken
+    bool decodeRows() {
+        if (mcuRow >= mcuRows){
+            return false;
+        }
+        for (int mx = 0; mx < mcuCols; mx++){
+            if (restartInterval){
+                if (untilRestart == 0){
+                    restart();
+                }
+                untilRestart--;
+            }
+            for (int c = 0; c < (int)components.size(); c++){
+                Component &component = components[c];
+                for (int v = 0; v < component.v; v++){
+                    for (int h = 0; h < component.h; h++){
+                        int block[64];
+                        decodeBlock(component, block);
+                        idct(block, &component.samples[(size_t)v * 8 * component.stride + (mx * component.h + h) * 8], component.stride);
+                    }
+                }
+            }
+        }
+        mcuRow++;
+        return true;
+    }
+
+    //first image row of the rows decodeRows() decoded
+    int top() const {
+        return (mcuRow - 1) * mcuHeight;
+    }
+
+    int rows() const {
+        return std::min(mcuHeight, imageHeight - top());
+    }
+
+    //writes decoded row i (of rows()) as width() grey or RGB pixels
+    void convertRow(int i, unsigned char *out) const {
+        if (components.size() == 1){
+            memcpy(out, &components[0].samples[(size_t)i * components[0].stride], imageWidth);
+            return;
+        }
+        const Component &y = components[0];
+        const Component &cb = components[1];
+        const Component &cr = components[2];
+        const unsigned char *yRow = &y.samples[(size_t)(i * y.v / maxV) * y.stride];
+        const unsigned char *cbRow = &cb.samples[(size_t)(i * cb.v / maxV) * cb.stride];
+        const unsigned char *crRow = &cr.samples[(size_t)(i * cr.v / maxV) * cr.stride];
+        for (int x = 0; x < imageWidth; x++){
+            int luma = yRow[x * y.h / maxH] << 16;
+            int blue = cbRow[x * cb.h / maxH] - 128;
+            int red = crRow[x * cr.h / maxH] - 128;
+            out[0] = clamp((luma + 91881 * red + 32768) >> 16);
+            out[1] = clamp((luma - 22554 * blue - 46802 * red + 32768) >> 16);
+            out[2] = clamp((luma + 116130 * blue + 32768) >> 16);
+            out += 3;
+        }
+    }
+
+private:
+    struct Huffman {
+        unsigned short fast[512]; //length << 8 | symbol for codes up to 9 bits long, by their next 9 bits (0 if longer)
+        int maxCode[18]; //largest code of each length, -1 if none
+        int offset[18]; //code + offset is the index in symbols
+        unsigned char symbols[256];
+    };
+
+    struct Component {
+        int id;
+        int h;
+        int v;
+        int quantization;
+        int dcTable;
+        int acTable;
+        int predictor; //last DC value
+        int stride; //samples in a row of the buffer
+        std::vector<unsigned char> samples; //the component's part of a row of MCUs
+    };
+
+    bool readQuantization(const unsigned char *segment, size_t length) {
+        size_t p = 0;
+        while (p < length){
+            int precision = segment[p] >> 4;
+            int table = segment[p] & 15;
+            p++;
+            if (table > 3 || p + (precision ? 128 : 64) > length){
+                return false;
+            }
+            for (int k = 0; k < 64; k++){
+                quantization[table][k] = precision ? (segment[p + k * 2] << 8 | segment[p + k * 2 + 1]) : segment[p + k];
+            }
+            p += precision ? 128 : 64;
+        }
+        return true;
+    }
+
+    bool readHuffman(const unsigned char *segment, size_t length) {
+        size_t p = 0;
+        while (p + 17 <= length){
+            int tableClass = segment[p] >> 4;
+            int table = segment[p] & 15;
+            if (tableClass > 1 || table > 3){
+                return false;
+            }
+            const unsigned char *counts = segment + p + 1;
+            int total = 0;
+            for (int l = 0; l < 16; l++){
+                total += counts[l];
+            }
+            p += 17;
+            if (total > 256 || p + total > length){
+                return false;
+            }
+            Huffman &huffman = huffmans[tableClass * 4 + table];
+            memcpy(huffman.symbols, segment + p, total);
+            p += total;
+
+            //canonical codes: each length's codes follow the last length's, doubled
+            memset(huffman.fast, 0, sizeof(huffman.fast));
+            int code = 0;
+            int index = 0;
+            for (int l = 1; l <= 16; l++){
+                if (code + counts[l - 1] > 1 << l){
+                    return false; //more codes than there are l bit strings
+                }
+                huffman.offset[l] = index - code;
+                for (int i = 0; i < counts[l - 1]; i++, code++, index++){
+                    if (l <= 9){
+                        int first = code << (9 - l);
+                        for (int f = 0; f < 1 << (9 - l); f++){
+                            huffman.fast[first + f] = (unsigned short)(l << 8 | huffman.symbols[index]);
+                        }
+                    }
+                }
+                huffman.maxCode[l] = counts[l - 1] ? code - 1 : -1;
+                code <<= 1;
+            }
+            tableLoaded[tableClass * 4 + table] = true;
+        }
+        return true;
+    }
+
+    bool readFrame(const unsigned char *segment, size_t length) {
+        if (length < 6 || segment[0] != 8){
+            return false;
+        }
+        imageHeight = segment[1] << 8 | segment[2];
+        imageWidth = segment[3] << 8 | segment[4];
+        int count = segment[5];
+        if (imageWidth == 0 || imageHeight == 0 || (count != 1 && count != 3) || length < 6 + (size_t)count * 3){
+            return false;
+        }
+        components.resize(count);
+        for (int c = 0; c < count; c++){
+            Component &component = components[c];
+            component.id = segment[6 + c * 3];
+            component.h = segment[7 + c * 3] >> 4;
+            component.v = segment[7 + c * 3] & 15;
+            component.quantization = segment[8 + c * 3];
+            if (component.h < 1 || component.h > 4 || component.v < 1 || component.v > 4 || component.quantization > 3){
+                return false;
+            }
+            if (count == 1){
+                component.h = component.v = 1; //a scan of one component is read a block at a time, whatever its sampling
+            }
+        }
+        return true;
+    }
+
+    bool readScan(const unsigned char *segment, size_t length) {
+        if (components.empty() || length < 1 || segment[0] != (int)components.size() || length < 4 + components.size() * 2){
+            return false; //scans of some of the components (only possible for colour) aren't interleaved
+        }
+        for (int s = 0; s < (int)components.size(); s++){
+            int id = segment[1 + s * 2];
+            int tables = segment[2 + s * 2];
+            int c = 0;
+            while (c < (int)components.size() && components[c].id != id){
+                c++;
+            }
+            if (c == (int)components.size() || (tables >> 4) > 3 || (tables & 15) > 3){
+                return false;
+            }
+            components[c].dcTable = tables >> 4;
+            components[c].acTable = 4 + (tables & 15);
+            if (!tableLoaded[components[c].dcTable] || !tableLoaded[components[c].acTable]){
+                return false;
+            }
+        }
+
+        maxH = maxV = 1;
+        for (int c = 0; c < (int)components.size(); c++){
+            maxH = std::max(maxH, components[c].h);
+            maxV = std::max(maxV, components[c].v);
+        }
+        mcuWidth = 8 * maxH;
+        mcuHeight = 8 * maxV;
+        mcuCols = (imageWidth + mcuWidth - 1) / mcuWidth;
+        mcuRows = (imageHeight + mcuHeight - 1) / mcuHeight;
+        for (int c = 0; c < (int)components.size(); c++){
+            Component &component = components[c];
+            component.predictor = 0;
+            component.stride = mcuCols * component.h * 8;
+            component.samples.assign((size_t)component.stride * component.v * 8, 0);
+        }
+        mcuRow = 0;
+        untilRestart = restartInterval;
+        return true;
+    }
+
+    //makes sure there are at least 25 bits to read; past a marker (or the end) the bits are 0
+    void fill() {
+        while (bitCount <= 24){
+            unsigned byte = 0;
+            if (!hitMarker && at < end){
+                byte = *at;
+                if (byte == 0xff){
+                    if (at + 1 < end && at[1] == 0){
+                        at += 2; //a stuffed 0xff
+                    }
+                    else{
+                        hitMarker = true;
+                        byte = 0;
+                    }
+                }
+                else{
+                    at++;
+                }
+            }
+            bitBuffer |= byte << (24 - bitCount);
+            bitCount += 8;
+        }
+    }
+
+    int decodeSymbol(const Huffman &huffman) {
+        fill();
+        unsigned fast = huffman.fast[bitBuffer >> 23];
+        if (fast){
+            bitBuffer <<= fast >> 8;
+            bitCount -= fast >> 8;
+            return fast & 255;
+        }
+        for (int l = 10; l <= 16; l++){
+            int code = bitBuffer >> (32 - l);
+            if (code <= huffman.maxCode[l]){
+                bitBuffer <<= l;
+                bitCount -= l;
+                return huffman.symbols[code + huffman.offset[l]];
+            }
+        }
+        throw std::runtime_error("broken JPEG: bad Huffman code");
+    }
+
+    //the signed value of the next bits bits
+    int receive(int bits) {
+        if (bits == 0){
+            return 0;
+        }
+        fill();
+        int value = bitBuffer >> (32 - bits);
+        bitBuffer <<= bits;
+        bitCount -= bits;
+        return value < 1 << (bits - 1) ? value - (1 << bits) + 1 : value;
+    }
+
+    //skips to just past the next restart marker and starts the DC predictions over
+    void restart() {
+        if (mcuRow > 0 || untilRestart != restartInterval){
+            bitBuffer = 0;
+            bitCount = 0;
+            hitMarker = false;
+            while (at + 1 < end && !(at[0] == 0xff && at[1] >= 0xd0 && at[1] <= 0xd7)){
+                at++;
+            }
+            at = std::min(at + 2, end);
+            for (int c = 0; c < (int)components.size(); c++){
+                components[c].predictor = 0;
+            }
+        }
+        untilRestart = restartInterval;
+    }
+
+    //reads one 8x8 block's coefficients, dequantized and in natural order
+    void decodeBlock(Component &component, int block[64]) {
+        static const unsigned char zigzag[64] = {
+            0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5, 12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+            35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51, 58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63
+        };
+        const unsigned short *q = quantization[component.quantization];
+        memset(block, 0, 64 * sizeof(int));
+        int bits = decodeSymbol(huffmans[component.dcTable]);
+        if (bits > 11){
+            throw std::runtime_error("broken JPEG: bad DC difference");
+        }
+        component.predictor = saturate(component.predictor + receive(bits));
+        block[0] = dequantize(component.predictor, q[0]);
+        const Huffman &ac = huffmans[component.acTable];
+        for (int k = 1; k < 64;){
+            int symbol = decodeSymbol(ac);
+            int run = symbol >> 4;
+            bits = symbol & 15;
+            if (bits == 0){
+                if (run != 15){
+                    break; //end of block
+                }
+                k += 16;
+                continue;
+            }
+            k += run;
+            if (k > 63){
+                throw std::runtime_error("broken JPEG: coefficients past the end of a block");
+            }
+            block[zigzag[k]] = dequantize(receive(bits), q[k]);
+            k++;
+        }
+    }
+
+    //the 11 bits a coefficient of 8 bit samples needs; more only comes from broken data, which would overflow the IDCT
+    static int saturate(int value) {
+        return value < -2047 ? -2047 : value > 2047 ? 2047 : value;
+    }
+
+    static int dequantize(int value, int q) {
+        return saturate(saturate(value) * q);
+    }
+
+    static unsigned char clamp(int value) {
+        return (unsigned char)(value < 0 ? 0 : value > 255 ? 255 : value);
+    }
+
+    //the 1D inverse DCT's even and odd parts (jidctint's constants, scaled by 4096)
+    static void idctRow(int s0, int s1, int s2, int s3, int s4, int s5, int s6, int s7, int out[8]) {
+        int p1 = (s2 + s6) * 2217;
+        int t2 = p1 - s6 * 7568;
+        int t3 = p1 + s2 * 3135;
+        int t0 = (s0 + s4) * 4096;
+        int t1 = (s0 - s4) * 4096;
+        int x0 = t0 + t3;
+        int x3 = t0 - t3;
+        int x1 = t1 + t2;
+        int x2 = t1 - t2;
+
+        int o0 = s7;
+        int o1 = s5;
+        int o2 = s3;
+        int o3 = s1;
+        int p3 = o0 + o2;
+        int p4 = o1 + o3;
+        int p5 = (p3 + p4) * 4816;
+        p1 = p5 + (o0 + o3) * -3686;
+        int p2 = p5 + (o1 + o2) * -10498;
+        p3 *= -8035;
+        p4 *= -1598;
+        o0 = o0 * 1223 + p1 + p3;
+        o1 = o1 * 8410 + p2 + p4;
+        o2 = o2 * 12586 + p2 + p3;
+        o3 = o3 * 6149 + p1 + p4;
+
+        out[0] = x0 + o3;
+        out[7] = x0 - o3;
+        out[1] = x1 + o2;
+        out[6] = x1 - o2;
+        out[2] = x2 + o1;
+        out[5] = x2 - o1;
+        out[3] = x3 + o0;
+        out[4] = x3 - o0;
+    }
+
+    //turns a block of coefficients into 8x8 samples
+    static void idct(const int block[64], unsigned char *out, int stride) {
+        int columns[64];
+        for (int x = 0; x < 8; x++){
+            const int *d = block + x;
+            if (!d[8] && !d[16] && !d[24] && !d[32] && !d[40] && !d[48] && !d[56]){
+                for (int y = 0; y < 8; y++){
+                    columns[y * 8 + x] = d[0] * 4;
+                }
+                continue;
+            }
+            int column[8];
+            idctRow(d[0], d[8], d[16], d[24], d[32], d[40], d[48], d[56], column);
+            for (int y = 0; y < 8; y++){
+                columns[y * 8 + x] = (column[y] + 512) >> 10; //keeps 2 bits more than the input
+            }
+        }
+        for (int y = 0; y < 8; y++, out += stride){
+            const int *v = columns + y * 8;
+            int row[8];
+            idctRow(v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7], row);
+            for (int x = 0; x < 8; x++){
+                out[x] = clamp((row[x] + 65536 + (128 << 17)) >> 17);
+            }
+        }
+    }
+
+    int imageWidth;
+    int imageHeight;
+    int restartInterval; //MCUs between restart markers (0 if there are none)
+    unsigned short quantization[4][64]; //in zigzag order
+    Huffman huffmans[8]; //DC tables 0-3, then AC tables 0-3
+    bool tableLoaded[8];
+    std::vector<Component> components;
+
+    const unsigned char *at; //next byte of entropy coded data
+    const unsigned char *end;
+    int mcuRow; //next row of MCUs to decode
+    int mcuRows;
+    int mcuCols;
+    int mcuWidth;
+    int mcuHeight;
+    int maxH;
+    int maxV;
+    unsigned bitBuffer; //bits not read yet, from the top
+    int bitCount;
+    bool hitMarker;
+    int untilRestart; //MCUs left before the next restart marker
+};
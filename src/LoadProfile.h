@@ -0,0 +1,89 @@
+#pragma once
+
+//Times each stage of loading a canopy and reports per-run and total figures
+//The stages overlap on the loader's threads and the main thread, so a run's wall time is kept apart from their sum
+//
+//  mLoadProfile.startRun(); //the canopy is requested
+//  mLoadProfile.add(LoadProfile::PANORAMA, result.fetchSeconds + result.decodeSeconds);
+//  mLoadProfile.finishRun(); //logs this run and the totals so far
+
+#include "Log.h"
+#include <algorithm>
+
+class LoadProfile {
+public:
+    enum StageId {
+        LIST,          //canopy list fetch and parse
+        MANIFEST,      //canopy information fetch and parse
+        PORTAL_IMAGES, //portal image fetch and decode
+        TEXT,          //wrapping and rendering description/caption text
+        PREVIEW,       //low resolution panorama fetch and decode
+        PANORAMA,      //panorama fetch and decode
+        SLICING,       //cutting the panorama into tile textures
+        ASSETS,        //button and indicator images
+        STAGE_COUNT
+    };
+
+    static const char *name(int stage) {
+        static const char *names[] = { "list", "manifest", "portal images", "text", "preview", "panorama", "slicing", "assets" };
+        return names[stage];
+    }
+
+    LoadProfile() : runs(0), runStart(0.0), wallTotal(0.0) {
+        for (int i = 0; i < STAGE_COUNT; i++){
+            current[i] = 0.0;
+            total[i] = 0.0;
+            best[i] = 1e30;
+            worst[i] = 0.0;
+            calls[i] = 0;
+        }
+    }
+
+    void startRun() {
+        runStart = Log::now();
+    }
+
+    void add(StageId id, double seconds) {
+        current[id] += seconds;
+        calls[id]++;
+    }
+
+    //ends a run: logs its wall time, its stage times and the totals over all runs
+    void finishRun() {
+        runs++;
+        double wall = Log::now() - runStart;
+        wallTotal += wall;
+        double runTime = 0.0;
+        for (int i = 0; i < STAGE_COUNT; i++){
+            total[i] += current[i];
+            best[i] = std::min(best[i], current[i]);
+            worst[i] = std::max(worst[i], current[i]);
+            runTime += current[i];
+        }
+
+        LOG_INFO("load run %d: %.3f s (%.3f s of stage time)", runs, wall, runTime);
+        double allRuns = 0.0;
+        for (int i = 0; i < STAGE_COUNT; i++){
+            LOG_INFO("  %-14s %8.3f s  (mean %.3f, min %.3f, max %.3f, %d calls)", name(i), current[i], total[i] / runs, best[i], worst[i], calls[i]);
+            allRuns += total[i];
+            current[i] = 0.0;
+            calls[i] = 0;
+        }
+        LOG_INFO("  %-14s %8.3f s over %d runs (mean %.3f)", "stage time", allRuns, runs, allRuns / runs);
+        LOG_INFO("  %-14s %8.3f s over %d runs (mean %.3f)", "wall time", wallTotal, runs, wallTotal / runs);
+    }
+
+    int completedRuns() const {
+        return runs;
+    }
+
+private:
+    int runs;
+    double runStart; //when this run's canopy was requested
+    double wallTotal; //wall time of all finished runs
+    double current[STAGE_COUNT]; //this run
+    double total[STAGE_COUNT];   //all finished runs
+    double best[STAGE_COUNT];
+    double worst[STAGE_COUNT];
+    int calls[STAGE_COUNT];
+};
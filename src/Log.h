@@ -0,0 +1,200 @@
+#pragma once
+
+//Leveled logging that stays out of the frame loop
+//  - messages below GHOSTS_LOG_LEVEL are compiled out, messages below Log::setLevel() are skipped at runtime
+//  - messages are formatted into a fixed ring buffer and written out by a background thread
+//  - a full buffer drops messages (and counts them) instead of blocking the caller
+//  - LOG_EVERY limits a call site to one message per interval for per-frame logging
+//
+//  LOG_INFO("loading canopy %d", canopyID);
+//  LOG_EVERY(LOG_LEVEL_TRACE, 1.0, "x offset %f", pixelXOffset);
+
+#include <ostream>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#ifdef __APPLE__
+#include <mach/mach_time.h>
+#else
+#include <time.h>
+#endif
+
+#define LOG_LEVEL_TRACE 0
+#define LOG_LEVEL_DEBUG 1
+#define LOG_LEVEL_INFO  2
+#define LOG_LEVEL_WARN  3
+#define LOG_LEVEL_ERROR 4
+#define LOG_LEVEL_OFF   5
+
+//lowest level compiled into the app
+#ifndef GHOSTS_LOG_LEVEL
+#ifdef NDEBUG
+#define GHOSTS_LOG_LEVEL LOG_LEVEL_INFO
+#else
+#define GHOSTS_LOG_LEVEL LOG_LEVEL_TRACE
+#endif
+#endif
+
+class Log {
+public:
+    enum { SLOTS = 512, MESSAGE_LENGTH = 200 }; //SLOTS must be a power of two
+
+    //starts the thread that writes messages to sink (only the first call does anything)
+    static void start(std::ostream &sink) {
+        State &s = state();
+        if (__sync_bool_compare_and_swap(&s.started, 0, 1)){
+            s.sink = &sink;
+            pthread_t thread;
+            pthread_create(&thread, 0, &Log::drain, 0);
+            pthread_detach(thread);
+        }
+    }
+
+    static void setLevel(int level) {
+        state().level = level;
+    }
+
+    static bool enabled(int level) {
+        return level >= state().level;
+    }
+
+    //how many messages were lost because the buffer was full
+    static unsigned dropped() {
+        return state().dropped;
+    }
+
+    //seconds on a clock that only moves forward, unlike the time of day
+    static double now() {
+#ifdef __APPLE__
+        static mach_timebase_info_data_t timebase;
+        if (timebase.denom == 0){
+            mach_timebase_info(&timebase);
+        }
+        return mach_absolute_time() * (double)timebase.numer / timebase.denom / 1000000000.0;
+#else
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+#endif
+    }
+
+    //formats a message into the buffer, never blocks
+    static __attribute__((format(printf, 2, 3))) void write(int level, const char *format, ...) {
+        State &s = state();
+
+        //claims a slot
+        unsigned pos = s.enqueuePos;
+        Slot *slot;
+        for (;;){
+            slot = &s.slots[pos & (SLOTS - 1)];
+            int diff = (int)(slot->sequence - pos);
+            if (diff == 0){
+                if (__sync_bool_compare_and_swap(&s.enqueuePos, pos, pos + 1)){
+                    break;
+                }
+                pos = s.enqueuePos;
+            }
+            else if (diff < 0){ //full
+                __sync_fetch_and_add(&s.dropped, 1);
+                return;
+            }
+            else{
+                pos = s.enqueuePos;
+            }
+        }
+
+        slot->level = level;
+        slot->time = now();
+        va_list args;
+        va_start(args, format);
+        vsnprintf(slot->text, MESSAGE_LENGTH, format, args);
+        va_end(args);
+
+        //publishes it to the writer thread
+        __sync_synchronize();
+        slot->sequence = pos + 1;
+    }
+
+private:
+    struct Slot {
+        volatile unsigned sequence;
+        int level;
+        double time;
+        char text[MESSAGE_LENGTH];
+    };
+
+    struct State {
+        Slot slots[SLOTS];
+        volatile unsigned enqueuePos;
+        unsigned dequeuePos;
+        volatile unsigned dropped;
+        volatile int started;
+        volatile int level;
+        std::ostream *sink;
+
+        State() : enqueuePos(0), dequeuePos(0), dropped(0), started(0), level(GHOSTS_LOG_LEVEL), sink(0) {
+            for (unsigned i = 0; i < SLOTS; i++){
+                slots[i].sequence = i;
+            }
+        }
+    };
+
+    static State &state() {
+        static State s;
+        return s;
+    }
+
+    //writer thread: empties the buffer, then sleeps a little
+    static void *drain(void *) {
+        static const char *names[] = { "TRACE", "DEBUG", "INFO", "WARN", "ERROR" };
+        State &s = state();
+        unsigned reportedDrops = 0;
+        for (;;){
+            bool wrote = false;
+            for (;;){
+                Slot &slot = s.slots[s.dequeuePos & (SLOTS - 1)];
+                if ((int)(slot.sequence - (s.dequeuePos + 1)) != 0){
+                    break;
+                }
+                __sync_synchronize();
+                *s.sink << "[" << names[slot.level] << " " << (long)(slot.time * 1000.0) % 100000000 << "] " << slot.text << "\n";
+                __sync_synchronize();
+                slot.sequence = s.dequeuePos + SLOTS;
+                s.dequeuePos++;
+                wrote = true;
+            }
+            if (s.dropped != reportedDrops){
+                reportedDrops = s.dropped;
+                *s.sink << "[WARN] log buffer full, " << reportedDrops << " messages dropped so far\n";
+                wrote = true;
+            }
+            if (wrote){
+                s.sink->flush();
+            }
+            usleep(10000);
+        }
+        return 0;
+    }
+};
+
+#define LOG_AT(level, ...) do { if ((level) >= GHOSTS_LOG_LEVEL && Log::enabled(level)) Log::write((level), __VA_ARGS__); } while (0)
+
+#define LOG_TRACE(...) LOG_AT(LOG_LEVEL_TRACE, __VA_ARGS__)
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define LOG_INFO(...)  LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_WARN(...)  LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+
+//logs from this call site at most once every `seconds`
+#define LOG_EVERY(level, seconds, ...) do { \
+        if ((level) >= GHOSTS_LOG_LEVEL && Log::enabled(level)){ \
+            static double logLastTime = 0.0; \
+            double logNow = Log::now(); \
+            if (logNow - logLastTime >= (seconds)){ \
+                logLastTime = logNow; \
+                Log::write((level), __VA_ARGS__); \
+            } \
+        } \
+    } while (0)
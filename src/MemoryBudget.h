@@ -0,0 +1,143 @@
+#pragma once
+
+//Keeps count of the memory held by images and textures against a limit
+//  - every surface or texture the app keeps is added when created and removed when released
+//  - pressure() says when the app should start giving memory back (HIGH) or is over the limit (CRITICAL)
+//  - the app decides what to give back; this only does the accounting
+//Used from the main thread only.
+//
+//  mBudget.add(MemoryBudget::PORTAL_IMAGES, surfaceBytes(proj.imageFile));
+//  if (mBudget.pressure() != MemoryBudget::NORMAL) ...evict...
+
+#include <stddef.h>
+#include <unistd.h>
+#include <algorithm>
+#ifdef __APPLE__
+#include <sys/types.h>
+#include <sys/sysctl.h>
+#endif
+#include "Log.h"
+
+class MemoryBudget {
+public:
+    enum Category {
+        FULL_TILES,    //full resolution panorama tiles
+        PREVIEW_TILES, //tiles cut from the low resolution preview
+        PANORAMA,      //decoded panoramas waiting to be cut into tiles
+        PORTAL_IMAGES, //images shown next to data objects
+        TEXT,          //rendered description and caption text
+        INTERFACE,     //buttons, indicators, number pad and table of contents
+        CATEGORY_COUNT
+    };
+
+    enum Pressure {
+        NORMAL,  //below the high water mark
+        HIGH,    //above the high water mark, cold memory should be given back
+        CRITICAL //over the limit
+    };
+
+    static const char *name(int category) {
+        static const char *names[] = { "full tiles", "preview tiles", "panorama", "portal images", "text", "interface" };
+        return names[category];
+    }
+
+    MemoryBudget() : limitBytes(256 << 20), highWaterShare(0.8f), peakBytes(0) {
+        clear();
+    }
+
+    void setLimit(size_t bytes) {
+        limitBytes = bytes;
+    }
+
+    //share of the limit above which pressure is HIGH
+    void setHighWater(float share) {
+        highWaterShare = share;
+    }
+
+    size_t limit() const {
+        return limitBytes;
+    }
+
+    size_t highWater() const {
+        return (size_t)(limitBytes * highWaterShare);
+    }
+
+    void add(Category category, size_t bytes) {
+        counts[category] += bytes;
+        total += bytes;
+        peakBytes = std::max(peakBytes, total);
+    }
+
+    void remove(Category category, size_t bytes) {
+        bytes = std::min(bytes, counts[category]);
+        counts[category] -= bytes;
+        total -= bytes;
+    }
+
+    //forgets everything (the peak is kept)
+    void clear() {
+        for (int i = 0; i < CATEGORY_COUNT; i++){
+            counts[i] = 0;
+        }
+        total = 0;
+    }
+
+    size_t used() const {
+        return total;
+    }
+
+    size_t used(Category category) const {
+        return counts[category];
+    }
+
+    size_t peak() const {
+        return peakBytes;
+    }
+
+    //bytes that can be added before reaching the high water mark
+    size_t available() const {
+        return total < highWater() ? highWater() - total : 0;
+    }
+
+    bool fits(size_t bytes) const {
+        return bytes <= available();
+    }
+
+    Pressure pressure() const {
+        if (total > limitBytes){
+            return CRITICAL;
+        }
+        return total > highWater() ? HIGH : NORMAL;
+    }
+
+    void log() const {
+        LOG_INFO("memory: %.1f of %.1f MB (peak %.1f MB)", total / 1048576.0, limitBytes / 1048576.0, peakBytes / 1048576.0);
+        for (int i = 0; i < CATEGORY_COUNT; i++){
+            LOG_INFO("  %-14s %8.1f MB", name(i), counts[i] / 1048576.0);
+        }
+    }
+
+    //how much memory the device has (0 if it can't be found)
+    static size_t physicalMemory() {
+#ifdef __APPLE__
+        int name[2] = { CTL_HW, HW_MEMSIZE };
+        unsigned long long bytes = 0;
+        size_t length = sizeof(bytes);
+        if (sysctl(name, 2, &bytes, &length, 0, 0) == 0){
+            return (size_t)bytes;
+        }
+        return 0;
+#else
+        long pages = sysconf(_SC_PHYS_PAGES);
+        long pageSize = sysconf(_SC_PAGESIZE);
+        return pages > 0 && pageSize > 0 ? (size_t)pages * pageSize : 0;
+#endif
+    }
+
+private:
+    size_t limitBytes;
+    float highWaterShare;
+    size_t counts[CATEGORY_COUNT];
+    size_t total;
+    size_t peakBytes;
+};
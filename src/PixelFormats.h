@@ -0,0 +1,316 @@
+#pragma once
+
+//Compact pixel formats for textures, without Cinder or GL
+//  - RGB565 halves the memory and upload size of full colour, dithered so skies don't band
+//  - L8 keeps one channel, for canopies that are black and white photographs
+//  - ETC1 is a quarter of RGB565, encoded in software, on GPUs that have GL_OES_compressed_ETC1_RGB8_texture
+//Shared by the app and tools/headless_render, which measures what each format costs.
+//
+//  PixelFormat format = isGrayscale(pixels, rowBytes, 4, 0, 1, 2, w, h) ? PIXELS_L8 : PIXELS_RGB565;
+//  packPixels(pixels, rowBytes, 4, 0, 1, 2, w, h, format, packed);
+//  PixelUpload upload = pixelUpload(packed.format);
+//  glTexImage2D(GL_TEXTURE_2D, 0, upload.format, w, h, 0, upload.format, upload.type, &packed.data[0]);
+
+#include <stddef.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+enum PixelFormat {
+    PIXELS_RGBA,   //8 bits a channel, as Cinder uploads a Surface
+    PIXELS_RGB565, //16 bits a pixel
+    PIXELS_L8,     //grey, 8 bits a pixel
+    PIXELS_ETC1,   //4 bits a pixel, compressed 4x4 blocks
+    PIXELS_AUTO    //picked for each canopy: L8 if it is grey, RGB565 otherwise
+};
+
+inline const char *pixelFormatName(PixelFormat format)
+{
+    static const char *names[] = { "RGBA", "RGB565", "L8", "ETC1", "auto" };
+    return names[format];
+}
+
+//memory a texture of this size takes in the format
+inline size_t pixelFormatBytes(PixelFormat format, int width, int height)
+{
+    switch (format){
+        case PIXELS_RGB565: return (size_t)width * height * 2;
+        case PIXELS_L8: return (size_t)width * height;
+        case PIXELS_ETC1: return (size_t)((width + 3) / 4) * ((height + 3) / 4) * 8;
+        default: return (size_t)width * height * 4;
+    }
+}
+
+//What to pass glTexImage2D (or glCompressedTexImage2D if compressed), as numbers so no GL header is needed
+struct PixelUpload {
+    unsigned format; //also the internal format
+    unsigned type;
+    bool compressed;
+};
+
+inline PixelUpload pixelUpload(PixelFormat format)
+{
+    PixelUpload upload = { 0x1908, 0x1401, false }; //GL_RGBA, GL_UNSIGNED_BYTE
+    if (format == PIXELS_RGB565){
+        upload.format = 0x1907; //GL_RGB
+        upload.type = 0x8363; //GL_UNSIGNED_SHORT_5_6_5
+    }
+    else if (format == PIXELS_L8){
+        upload.format = 0x1909; //GL_LUMINANCE
+    }
+    else if (format == PIXELS_ETC1){
+        upload.format = 0x8D64; //GL_ETC1_RGB8_OES
+        upload.compressed = true;
+    }
+    return upload;
+}
+
+//if name is one of the space separated extensions (as glGetString(GL_EXTENSIONS) lists them)
+inline bool hasGlExtension(const char *extensions, const char *name)
+{
+    if (!extensions){
+        return false;
+    }
+    size_t length = strlen(name);
+    for (const char *at = strstr(extensions, name); at; at = strstr(at + 1, name)){
+        if ((at == extensions || at[-1] == ' ') && (at[length] == ' ' || at[length] == '\0')){
+            return true;
+        }
+    }
+    return false;
+}
+
+//GL_UNPACK_ROW_LENGTH (GL_UNPACK_ROW_LENGTH_EXT on GLES 2), to upload part of a bigger image straight from it
+const unsigned UNPACK_ROW_LENGTH = 0x0CF2;
+
+//if GL takes a row length for uploads (as glGetString(GL_VERSION) and GL_EXTENSIONS give them): desktop GL, GLES 3 or GL_EXT_unpack_subimage
+inline bool hasUnpackRowLength(const char *version, const char *extensions)
+{
+    if (!version){
+        return false;
+    }
+    if (strncmp(version, "OpenGL ES", 9) != 0){
+        return true;
+    }
+    return strncmp(version, "OpenGL ES 3", 11) == 0 || hasGlExtension(extensions, "GL_EXT_unpack_subimage");
+}
+
+//if pixels (channels at offsets r, g and b of each pixelBytes) are already laid out as the format uploads them,
+//so they can go to GL without being packed (RGBA keeps the alpha it has, the images tiles come from are opaque)
+inline bool uploadsAsIs(PixelFormat format, int pixelBytes, int r, int g, int b)
+{
+    return (format == PIXELS_RGBA && pixelBytes == 4 && r == 0 && g == 1 && b == 2) || (format == PIXELS_L8 && pixelBytes == 1);
+}
+
+//if (nearly) every pixel has equal red, green and blue, checked on every step-th pixel of every step-th row
+//a few coloured pixels are allowed for dust and scanner noise, a tinted (sepia) photograph is not grey
+inline bool isGrayscale(const unsigned char *pixels, int rowBytes, int pixelBytes, int r, int g, int b, int width, int height,
+                        int tolerance = 8, int step = 7)
+{
+    int checked = 0;
+    int coloured = 0;
+    for (int y = 0; y < height; y += step){
+        const unsigned char *row = pixels + (size_t)y * rowBytes;
+        for (int x = 0; x < width; x += step){
+            const unsigned char *p = row + x * pixelBytes;
+            int high = std::max(p[r], std::max(p[g], p[b]));
+            int low = std::min(p[r], std::min(p[g], p[b]));
+            coloured += high - low > tolerance;
+            checked++;
+        }
+    }
+    return coloured * 100 <= checked;
+}
+
+//Pixels packed in a PixelFormat, rows tightly packed (upload with GL_UNPACK_ALIGNMENT 1)
+struct PackedPixels {
+    PixelFormat format;
+    int width;
+    int height;
+    std::vector<unsigned char> data;
+};
+
+//ETC1's intensity modifiers, by table then by pixel index (the index is msb * 2 + lsb)
+static const int etc1Modifiers[8][4] = {
+    { 2, 8, -2, -8 },
+    { 5, 17, -5, -17 },
+    { 9, 29, -9, -29 },
+    { 13, 42, -13, -42 },
+    { 18, 60, -18, -60 },
+    { 24, 80, -24, -80 },
+    { 33, 106, -33, -106 },
+    { 47, 183, -47, -183 }
+};
+
+//Picks the table and per pixel modifiers for one half of an ETC1 block around a base colour
+//pixel i of the half is block pixel index[i] (x * 4 + y, as are rgb and the bits); returns the squared error and ors the pixel bits into bits
+inline int etc1EncodeHalf(const unsigned char rgb[16][3], const int index[8], const int base[3], int &table, unsigned &bits)
+{
+    int bestError = 0x7fffffff;
+    unsigned bestBits = 0;
+    for (int t = 0; t < 8; t++){
+        int error = 0;
+        unsigned tableBits = 0;
+        for (int i = 0; i < 8; i++){
+            const unsigned char *p = rgb[index[i]];
+            int bestPixel = 0x7fffffff;
+            int bestModifier = 0;
+            for (int m = 0; m < 4; m++){
+                int pixelError = 0;
+                for (int c = 0; c < 3; c++){
+                    int d = std::max(0, std::min(255, base[c] + etc1Modifiers[t][m])) - p[c];
+                    pixelError += d * d;
+                }
+                if (pixelError < bestPixel){
+                    bestPixel = pixelError;
+                    bestModifier = m;
+                }
+            }
+            error += bestPixel;
+            tableBits |= (unsigned)(bestModifier & 1) << index[i];
+            tableBits |= (unsigned)(bestModifier >> 1) << (index[i] + 16);
+        }
+        if (error < bestError){
+            bestError = error;
+            bestBits = tableBits;
+            table = t;
+        }
+    }
+    bits |= bestBits;
+    return bestError;
+}
+
+//encodes a 4x4 block of RGB pixels (row by row) as 8 bytes of ETC1, trying both ways of splitting it
+//and the differential mode whenever the halves' colours are close enough for it
+inline void etc1EncodeBlock(const unsigned char rgb[16][3], unsigned char out[8])
+{
+    unsigned char columns[16][3];
+    for (int i = 0; i < 16; i++){
+        memcpy(columns[(i % 4) * 4 + i / 4], rgb[i], 3);
+    }
+    int bestError = 0x7fffffff;
+    unsigned bestHigh = 0;
+    unsigned bestLow = 0;
+    for (int flip = 0; flip < 2; flip++){
+        //flipped halves are the top and bottom two rows, otherwise the left and right two columns
+        //the block is stored column by column, so pixels are numbered x * 4 + y
+        int index[2][8];
+        int sum[2][3] = { { 0, 0, 0 }, { 0, 0, 0 } };
+        for (int h = 0; h < 2; h++){
+            for (int i = 0; i < 8; i++){
+                int x = flip ? (i >> 1) : h * 2 + (i >> 2);
+                int y = flip ? h * 2 + (i & 1) : (i & 3);
+                index[h][i] = x * 4 + y;
+                for (int c = 0; c < 3; c++){
+                    sum[h][c] += rgb[y * 4 + x][c];
+                }
+            }
+        }
+
+        for (int differential = 0; differential < 2; differential++){
+            int quantized[2][3];
+            int base[2][3];
+            bool fits = true;
+            for (int h = 0; h < 2; h++){
+                for (int c = 0; c < 3; c++){
+                    int levels = differential ? 31 : 15;
+                    quantized[h][c] = (sum[h][c] * levels + 8 * 255 / 2) / (8 * 255);
+                    base[h][c] = differential ? (quantized[h][c] << 3) | (quantized[h][c] >> 2) : quantized[h][c] * 17;
+                }
+            }
+            if (differential){
+                for (int c = 0; c < 3; c++){
+                    int d = quantized[1][c] - quantized[0][c];
+                    fits = fits && d >= -4 && d <= 3;
+                }
+                if (!fits){
+                    continue;
+                }
+            }
+
+            int tables[2] = { 0, 0 };
+            unsigned low = 0;
+            int error = etc1EncodeHalf(columns, index[0], base[0], tables[0], low) + etc1EncodeHalf(columns, index[1], base[1], tables[1], low);
+            if (error >= bestError){
+                continue;
+            }
+            unsigned high = 0;
+            for (int c = 0; c < 3; c++){
+                int shift = 24 - c * 8;
+                if (differential){
+                    high |= (unsigned)quantized[0][c] << (shift + 3);
+                    high |= (unsigned)((quantized[1][c] - quantized[0][c]) & 7) << shift;
+                }
+                else{
+                    high |= (unsigned)quantized[0][c] << (shift + 4);
+                    high |= (unsigned)quantized[1][c] << shift;
+                }
+            }
+            high |= (unsigned)tables[0] << 5 | (unsigned)tables[1] << 2 | (unsigned)differential << 1 | (unsigned)flip;
+            bestError = error;
+            bestHigh = high;
+            bestLow = low;
+        }
+    }
+    for (int i = 0; i < 4; i++){
+        out[i] = (unsigned char)(bestHigh >> (24 - i * 8));
+        out[i + 4] = (unsigned char)(bestLow >> (24 - i * 8));
+    }
+}
+
+//packs width x height pixels (channels at offsets r, g and b of each pixelBytes) into the format
+inline void packPixels(const unsigned char *pixels, int rowBytes, int pixelBytes, int r, int g, int b, int width, int height,
+                       PixelFormat format, PackedPixels &packed)
+{
+    packed.format = format;
+    packed.width = width;
+    packed.height = height;
+    packed.data.resize(pixelFormatBytes(format, width, height));
+    unsigned char *out = packed.data.empty() ? 0 : &packed.data[0];
+
+    //ordered dither thresholds, in sixteenths of a quantization step
+    static const int bayer[4][4] = { { 0, 8, 2, 10 }, { 12, 4, 14, 6 }, { 3, 11, 1, 9 }, { 15, 7, 13, 5 } };
+
+    if (format == PIXELS_ETC1){
+        for (int by = 0; by < height; by += 4){
+            for (int bx = 0; bx < width; bx += 4){
+                //blocks past the edge repeat the last row and column
+                unsigned char block[16][3];
+                for (int y = 0; y < 4; y++){
+                    const unsigned char *row = pixels + (size_t)std::min(by + y, height - 1) * rowBytes;
+                    for (int x = 0; x < 4; x++){
+                        const unsigned char *p = row + std::min(bx + x, width - 1) * pixelBytes;
+                        block[y * 4 + x][0] = p[r];
+                        block[y * 4 + x][1] = p[g];
+                        block[y * 4 + x][2] = p[b];
+                    }
+                }
+                etc1EncodeBlock(block, out);
+                out += 8;
+            }
+        }
+        return;
+    }
+
+    for (int y = 0; y < height; y++){
+        const unsigned char *p = pixels + (size_t)y * rowBytes;
+        for (int x = 0; x < width; x++, p += pixelBytes){
+            if (format == PIXELS_RGB565){
+                int d = bayer[y & 3][x & 3] * 255;
+                unsigned short pixel = (unsigned short)(((p[r] * 31 * 16 + d) / 4080) << 11 | ((p[g] * 63 * 16 + d) / 4080) << 5 | ((p[b] * 31 * 16 + d) / 4080));
+                memcpy(out, &pixel, 2); //native order, as GL_UNSIGNED_SHORT_5_6_5 reads it
+                out += 2;
+            }
+            else if (format == PIXELS_L8){
+                *out++ = (unsigned char)((p[r] * 77 + p[g] * 150 + p[b] * 29 + 128) >> 8);
+            }
+            else{
+                out[0] = p[r];
+                out[1] = p[g];
+                out[2] = p[b];
+                out[3] = 255; //tiles and portal images are opaque
+                out += 4;
+            }
+        }
+    }
+}
@@ -0,0 +1,268 @@
+#pragma once
+
+//Batch tests run on every projection position each frame:
+//  - visibility: is the object on screen
+//  - scan box:   is the center of the screen inside the object's scanning box
+//  - nearest:    which visible object in its scanning box is closest to the center
+//Vectorized for NEON (iPad) and SSE2 (simulator), with a scalar fallback that gives identical results.
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define GHOSTS_SIMD_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define GHOSTS_SIMD_SSE 1
+#endif
+
+//The view the tests are run against
+struct ScanView {
+    float pixelXOffset; //global X location of the top left corner of the screen
+    float pixelYOffset; //global Y location of the top left corner of the screen
+    float screenWidth;  //width of the area an object counts as visible in
+    float screenHeight; //height of the area an object counts as visible in
+    float centerX;      //center pixel of the screen on the canvas
+    float centerY;
+    float xHalfRange;   //half the width of the scanning box
+    float yHalfRange;   //half the height of the scanning box
+    float xBoxShift;    //where the scanning box sits relative to the object
+    float yBoxShift;
+};
+
+//What a pass over the projections found
+struct ScanResult {
+    int visibleCount; //how many objects are on screen
+    int nearest; //visible object in its scanning box closest to the center (-1 if none)
+    float nearestDist; //squared distance of that object from the center
+};
+
+//Reference version, one object at a time
+inline ScanResult scanProjectionsScalar(const int *offX, const int *offY, int count, const ScanView &view, unsigned char *visible, unsigned char *inBox)
+{
+    ScanResult result;
+    result.visibleCount = 0;
+    result.nearest = -1;
+    result.nearestDist = 0.0f;
+
+    for (int i = 0; i < count; i++){
+        float x = (float)offX[i];
+        float y = (float)offY[i];
+
+        bool onScreen = -y < view.pixelYOffset && -y > view.pixelYOffset - view.screenHeight &&
+                        -x < view.pixelXOffset && -x > view.pixelXOffset - view.screenWidth;
+
+        float dx = view.centerX - (x + view.xBoxShift);
+        float dy = view.centerY - (y + view.yBoxShift);
+        bool boxed = (dx < 0 ? -dx : dx) <= view.xHalfRange && (dy < 0 ? -dy : dy) <= view.yHalfRange;
+
+        visible[i] = onScreen;
+        inBox[i] = boxed;
+
+        if (onScreen){
+            result.visibleCount++;
+            if (boxed){
+                float dist = (view.centerX - x) * (view.centerX - x) + (view.centerY - y) * (view.centerY - y);
+                if (result.nearest == -1 || dist < result.nearestDist){
+                    result.nearest = i;
+                    result.nearestDist = dist;
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+#if GHOSTS_SIMD_NEON || GHOSTS_SIMD_SSE
+
+//Picks the best of the per-lane nearest candidates (lowest distance, then lowest index, like the scalar loop)
+inline void reduceNearestLanes(const float *laneDist, const int *laneIndex, ScanResult &result)
+{
+    for (int lane = 0; lane < 4; lane++){
+        if (laneIndex[lane] == -1){
+            continue;
+        }
+        if (result.nearest == -1 || laneDist[lane] < result.nearestDist ||
+            (laneDist[lane] == result.nearestDist && laneIndex[lane] < result.nearest)){
+            result.nearest = laneIndex[lane];
+            result.nearestDist = laneDist[lane];
+        }
+    }
+}
+
+#endif
+
+#if GHOSTS_SIMD_SSE
+
+inline ScanResult scanProjections(const int *offX, const int *offY, int count, const ScanView &view, unsigned char *visible, unsigned char *inBox)
+{
+    const __m128 pX = _mm_set1_ps(view.pixelXOffset);
+    const __m128 pY = _mm_set1_ps(view.pixelYOffset);
+    const __m128 pXMin = _mm_set1_ps(view.pixelXOffset - view.screenWidth);
+    const __m128 pYMin = _mm_set1_ps(view.pixelYOffset - view.screenHeight);
+    const __m128 cX = _mm_set1_ps(view.centerX);
+    const __m128 cY = _mm_set1_ps(view.centerY);
+    const __m128 boxCX = _mm_set1_ps(view.centerX - view.xBoxShift);
+    const __m128 boxCY = _mm_set1_ps(view.centerY - view.yBoxShift);
+    const __m128 xHalf = _mm_set1_ps(view.xHalfRange);
+    const __m128 yHalf = _mm_set1_ps(view.yHalfRange);
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 zero = _mm_setzero_ps();
+
+    __m128i visibleTotal = _mm_setzero_si128();
+    __m128 bestDist = _mm_set1_ps(3.4e38f);
+    __m128i bestIndex = _mm_set1_epi32(-1);
+    __m128i index = _mm_setr_epi32(0, 1, 2, 3);
+    const __m128i four = _mm_set1_epi32(4);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4){
+        __m128 x = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)(offX + i)));
+        __m128 y = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)(offY + i)));
+        __m128 negX = _mm_sub_ps(zero, x);
+        __m128 negY = _mm_sub_ps(zero, y);
+
+        __m128 onScreen = _mm_and_ps(_mm_and_ps(_mm_cmplt_ps(negY, pY), _mm_cmpgt_ps(negY, pYMin)),
+                                     _mm_and_ps(_mm_cmplt_ps(negX, pX), _mm_cmpgt_ps(negX, pXMin)));
+
+        __m128 dx = _mm_and_ps(_mm_sub_ps(boxCX, x), absMask);
+        __m128 dy = _mm_and_ps(_mm_sub_ps(boxCY, y), absMask);
+        __m128 boxed = _mm_and_ps(_mm_cmple_ps(dx, xHalf), _mm_cmple_ps(dy, yHalf));
+
+        int visibleBits = _mm_movemask_ps(onScreen);
+        int boxedBits = _mm_movemask_ps(boxed);
+        for (int lane = 0; lane < 4; lane++){
+            visible[i + lane] = (visibleBits >> lane) & 1;
+            inBox[i + lane] = (boxedBits >> lane) & 1;
+        }
+        visibleTotal = _mm_sub_epi32(visibleTotal, _mm_castps_si128(onScreen));
+
+        //squared distance from the center, only kept for visible objects in their box that beat the lane's best
+        __m128 ex = _mm_sub_ps(cX, x);
+        __m128 ey = _mm_sub_ps(cY, y);
+        __m128 dist = _mm_add_ps(_mm_mul_ps(ex, ex), _mm_mul_ps(ey, ey));
+        __m128 better = _mm_and_ps(_mm_and_ps(onScreen, boxed), _mm_cmplt_ps(dist, bestDist));
+        bestDist = _mm_or_ps(_mm_and_ps(better, dist), _mm_andnot_ps(better, bestDist));
+        __m128i betterI = _mm_castps_si128(better);
+        bestIndex = _mm_or_si128(_mm_and_si128(betterI, index), _mm_andnot_si128(betterI, bestIndex));
+
+        index = _mm_add_epi32(index, four);
+    }
+
+    int laneVisible[4];
+    float laneDist[4];
+    int laneIndex[4];
+    _mm_storeu_si128((__m128i *)laneVisible, visibleTotal);
+    _mm_storeu_ps(laneDist, bestDist);
+    _mm_storeu_si128((__m128i *)laneIndex, bestIndex);
+
+    ScanResult result;
+    result.visibleCount = laneVisible[0] + laneVisible[1] + laneVisible[2] + laneVisible[3];
+    result.nearest = -1;
+    result.nearestDist = 0.0f;
+    reduceNearestLanes(laneDist, laneIndex, result);
+
+    //leftover objects that don't fill a batch
+    if (i < count){
+        ScanResult rest = scanProjectionsScalar(offX + i, offY + i, count - i, view, visible + i, inBox + i);
+        result.visibleCount += rest.visibleCount;
+        if (rest.nearest != -1 && (result.nearest == -1 || rest.nearestDist < result.nearestDist)){
+            result.nearest = rest.nearest + i;
+            result.nearestDist = rest.nearestDist;
+        }
+    }
+
+    return result;
+}
+
+#elif GHOSTS_SIMD_NEON
+
+inline ScanResult scanProjections(const int *offX, const int *offY, int count, const ScanView &view, unsigned char *visible, unsigned char *inBox)
+{
+    const float32x4_t pX = vdupq_n_f32(view.pixelXOffset);
+    const float32x4_t pY = vdupq_n_f32(view.pixelYOffset);
+    const float32x4_t pXMin = vdupq_n_f32(view.pixelXOffset - view.screenWidth);
+    const float32x4_t pYMin = vdupq_n_f32(view.pixelYOffset - view.screenHeight);
+    const float32x4_t cX = vdupq_n_f32(view.centerX);
+    const float32x4_t cY = vdupq_n_f32(view.centerY);
+    const float32x4_t boxCX = vdupq_n_f32(view.centerX - view.xBoxShift);
+    const float32x4_t boxCY = vdupq_n_f32(view.centerY - view.yBoxShift);
+    const float32x4_t xHalf = vdupq_n_f32(view.xHalfRange);
+    const float32x4_t yHalf = vdupq_n_f32(view.yHalfRange);
+
+    uint32x4_t visibleTotal = vdupq_n_u32(0);
+    float32x4_t bestDist = vdupq_n_f32(3.4e38f);
+    int32x4_t bestIndex = vdupq_n_s32(-1);
+    static const int firstIndex[4] = {0, 1, 2, 3};
+    int32x4_t index = vld1q_s32(firstIndex);
+    const int32x4_t four = vdupq_n_s32(4);
+    const uint32x4_t one = vdupq_n_u32(1);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4){
+        float32x4_t x = vcvtq_f32_s32(vld1q_s32(offX + i));
+        float32x4_t y = vcvtq_f32_s32(vld1q_s32(offY + i));
+        float32x4_t negX = vnegq_f32(x);
+        float32x4_t negY = vnegq_f32(y);
+
+        uint32x4_t onScreen = vandq_u32(vandq_u32(vcltq_f32(negY, pY), vcgtq_f32(negY, pYMin)),
+                                        vandq_u32(vcltq_f32(negX, pX), vcgtq_f32(negX, pXMin)));
+
+        float32x4_t dx = vabsq_f32(vsubq_f32(boxCX, x));
+        float32x4_t dy = vabsq_f32(vsubq_f32(boxCY, y));
+        uint32x4_t boxed = vandq_u32(vcleq_f32(dx, xHalf), vcleq_f32(dy, yHalf));
+
+        uint32_t visibleLanes[4];
+        uint32_t boxedLanes[4];
+        vst1q_u32(visibleLanes, vandq_u32(onScreen, one));
+        vst1q_u32(boxedLanes, vandq_u32(boxed, one));
+        for (int lane = 0; lane < 4; lane++){
+            visible[i + lane] = visibleLanes[lane];
+            inBox[i + lane] = boxedLanes[lane];
+        }
+        visibleTotal = vaddq_u32(visibleTotal, vandq_u32(onScreen, one));
+
+        //squared distance from the center, only kept for visible objects in their box that beat the lane's best
+        float32x4_t ex = vsubq_f32(cX, x);
+        float32x4_t ey = vsubq_f32(cY, y);
+        float32x4_t dist = vmlaq_f32(vmulq_f32(ex, ex), ey, ey);
+        uint32x4_t better = vandq_u32(vandq_u32(onScreen, boxed), vcltq_f32(dist, bestDist));
+        bestDist = vbslq_f32(better, dist, bestDist);
+        bestIndex = vbslq_s32(better, index, bestIndex);
+
+        index = vaddq_s32(index, four);
+    }
+
+    uint32_t laneVisible[4];
+    float laneDist[4];
+    int laneIndex[4];
+    vst1q_u32(laneVisible, visibleTotal);
+    vst1q_f32(laneDist, bestDist);
+    vst1q_s32(laneIndex, bestIndex);
+
+    ScanResult result;
+    result.visibleCount = laneVisible[0] + laneVisible[1] + laneVisible[2] + laneVisible[3];
+    result.nearest = -1;
+    result.nearestDist = 0.0f;
+    reduceNearestLanes(laneDist, laneIndex, result);
+
+    //leftover objects that don't fill a batch
+    if (i < count){
+        ScanResult rest = scanProjectionsScalar(offX + i, offY + i, count - i, view, visible + i, inBox + i);
+        result.visibleCount += rest.visibleCount;
+        if (rest.nearest != -1 && (result.nearest == -1 || rest.nearestDist < result.nearestDist)){
+            result.nearest = rest.nearest + i;
+            result.nearestDist = rest.nearestDist;
+        }
+    }
+
+    return result;
+}
+
+#else
+
+inline ScanResult scanProjections(const int *offX, const int *offY, int count, const ScanView &view, unsigned char *visible, unsigned char *inBox)
+{
+    return scanProjectionsScalar(offX, offY, count, view, visible, inBox);
+}
+
+#endif
@@ -0,0 +1,62 @@
+#pragma once
+
+//Bounded queue between exactly one producer thread and one consumer thread, without locks
+//  - push() fails instead of waiting when the queue is full, pop() fails when it is empty
+//  - a popped slot is reset to T() so the queue doesn't keep what the item held alive
+//
+//  SpscQueue<LoadJob> jobs(256);
+//  jobs.push(job);          //producer thread
+//  while (jobs.pop(job)){}  //consumer thread
+
+#include <vector>
+
+template <typename T>
+class SpscQueue {
+public:
+    //capacity must be a power of two
+    explicit SpscQueue(unsigned capacity) : slots(capacity), mask(capacity - 1), head(0), tail(0) {}
+
+    //producer only
+    bool push(const T &item) {
+        unsigned t = tail;
+        if (t - head == slots.size()){
+            return false;
+        }
+        slots[t & mask] = item;
+        __sync_synchronize(); //the item is written before it is published
+        tail = t + 1;
+        return true;
+    }
+
+    //consumer only
+    bool pop(T &item) {
+        unsigned h = head;
+        if (h == tail){
+            return false;
+        }
+        __sync_synchronize(); //reads the item published with tail
+        item = slots[h & mask];
+        slots[h & mask] = T();
+        __sync_synchronize(); //the slot is finished with before the producer may reuse it
+        head = h + 1;
+        return true;
+    }
+
+    bool empty() const {
+        return head == tail;
+    }
+
+    unsigned size() const {
+        return tail - head;
+    }
+
+private:
+    SpscQueue(const SpscQueue &);
+    SpscQueue &operator=(const SpscQueue &);
+
+    std::vector<T> slots;
+    unsigned mask;
+    volatile unsigned head; //next slot to pop, written by the consumer
+    char padding[64]; //keeps head and tail on separate cache lines
+    volatile unsigned tail; //next slot to push, written by the producer
+};
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+//Breaks a projection's description and caption into the lines shown in the overlay
+//Lines end at the first space after 40 characters, or are hyphenated at 45
+//Both lists grow by a shared count, so a short text can leave empty lines at the end
+inline void wrapProjectionText(const std::string &text, const std::string &caption,
+                               std::vector<std::string> &textLines, std::vector<std::string> &captionLines)
+{
+    //Lines used to store text/caption characters per TextLayout
+    std::string line = "";
+    std::string captionLine = "";
+    int place = 0;
+    int place2 = 0;
+    int textLength = text.size();
+    int captionLength = caption.size();
+
+    int tracker = 0;//keeps track of the current amount of characters in a line
+    int captionTracker = 0;//keeps track of current amount of characters in the caption
+    int resizer = 1;
+
+    textLines.clear();
+    captionLines.clear();
+    textLines.resize(resizer);
+    captionLines.resize(resizer);
+
+    //Adds text to the structure
+    for (int q = 0; q < textLength || q < captionLength; q++){
+
+        //Cuts down information text
+        if (q < textLength){
+            line.append(text,q,1);//adds a character to the current line
+
+            if (tracker < 40){//if the line is shorter than 40, keep adding to the line
+                if (q == textLength - 1){//if the end of the text has been reached, add the line to be displayed
+                    textLines[place] = line;
+                    place++;
+                }
+                tracker++;
+            }
+            else{
+                if (text.compare(q,1, " ") == 0){//if after a set of 40 characters there is a space, go to the next line
+                    resizer++;
+                    textLines.resize(resizer);
+                    textLines[place] = line;
+                    place++;
+                    line = "";
+                    tracker = 0;
+                }
+                else if (tracker == 45){//if the last word goes over the limit for a line, it is broken up with a "-"
+                    resizer++;
+                    textLines.resize(resizer);
+                    line.append("-");
+                    textLines[place] = line;
+                    place++;
+                    line = "";
+                    tracker = 0;
+                }
+                else{//if still on a word but less than 4 characters, keep adding characters
+                    tracker++;
+                }
+            }
+        }
+
+        //Cuts down caption text
+        if (q < captionLength){
+            captionLine.append(caption,q,1);//adds a character to the current line
+
+            if (captionTracker < 40){//if the line is shorter than 40, keep adding to the line
+                if (q == captionLength - 1){//if the end of the text has been reached, add the line to be displayed
+                    if (place2 >= (int)captionLines.size()){
+                        captionLines.resize(place2 + 1);
+                    }
+                    captionLines[place2] = captionLine;
+                    place2++;
+                }
+                captionTracker++;
+            }
+            else{
+                if (caption.compare(q,1, " ") == 0){//if after a set of 40 characters there is a space, go to the next line
+                    resizer++;
+                    captionLines.resize(resizer > place2 ? resizer : place2 + 1);
+                    captionLines[place2] = captionLine;
+                    place2++;
+                    captionLine = "";
+                    captionTracker = 0;
+                }
+                else if (captionTracker == 45){//if the last word goes over the limit for a line, it is broken up with a "-"
+                    captionLines.resize(resizer > place2 ? resizer : place2 + 1);
+                    captionLine.append("-");
+                    captionLines[place2] = captionLine;
+                    place2++;
+                    captionLine = "";
+                    captionTracker = 0;
+                }
+                else{//if still on a word but less than 4 characters, keep adding characters
+                    captionTracker++;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,210 @@
+#pragma once
+
+//Cuts a panorama into packed tiles while it is decoded, without Cinder or GL
+//  - decoded rows go into a strip only as tall as a row of tiles
+//  - as soon as the strip holds a row of tiles they are packed (see PixelFormats.h) and the strip's rows are reused
+//so the whole panorama is never in memory at once: the peak is one strip plus the packed tiles.
+//streamJpegTiles() decodes baseline JPEGs a row of MCUs at a time (see JpegStrips.h); for other kinds of image
+//the whole decoded image is cut with cutImage().
+//
+//  TileStream stream;
+//  if (!streamJpegTiles(bytes, size, cut, stream)){
+//      ...decode the whole image...
+//      stream.begin(cut, width, height, 4, 0, 1, 2);
+//      stream.cutImage(pixels, rowBytes);
+//  }
+//  ...upload stream.tiles[t]...
+
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <algorithm>
+#include "CanopyView.h"
+#include "PixelFormats.h"
+#include "Trace.h"
+#include "JpegStrips.h"
+
+//How a panorama is cut into tiles
+struct TileCut {
+    std::vector<TileArea> areas; //on the panorama at full size (the image may be a smaller copy of it)
+    int panoramaWidth; //without the copied edge
+    int panoramaHeight;
+    PixelFormat format; //PIXELS_AUTO: L8 if the image is grey, RGB565 otherwise
+
+    TileCut() : panoramaWidth(0), panoramaHeight(0), format(PIXELS_AUTO) {}
+};
+
+class TileStream {
+public:
+    std::vector<PackedPixels> tiles; //in the order of the cut's areas
+    PixelFormat format; //what the tiles were packed in
+    size_t stripBytes; //largest the strip grew to (0 if a whole image was cut)
+
+    TileStream() : format(PIXELS_AUTO), stripBytes(0), width(0), height(0), pixelBytes(0), r(0), g(0), b(0), rowBytes(0), nextTile(0), stripTop(0) {}
+
+    //for an image of width x height pixels, pixelBytes bytes each with their red, green and blue at r, g and b
+    void begin(const TileCut &cut, int imageWidth, int imageHeight, int imagePixelBytes, int red, int green, int blue) {
+        width = imageWidth;
+        height = imageHeight;
+        pixelBytes = imagePixelBytes;
+        r = red;
+        g = green;
+        b = blue;
+        rowBytes = width * pixelBytes;
+        format = cut.format;
+        tiles.assign(cut.areas.size(), PackedPixels());
+
+        //the part of the image each tile shows, scaled as the app cuts a smaller copy
+        float scaleX = width / (float)cut.panoramaWidth;
+        float scaleY = height / (float)cut.panoramaHeight;
+        areas.resize(cut.areas.size());
+        order.resize(cut.areas.size());
+        int tallest = 1;
+        for (int t = 0; t < (int)areas.size(); t++){
+            const TileArea &area = cut.areas[t];
+            areas[t].x1 = std::min((int)(area.x1 * scaleX), width - 1);
+            areas[t].y1 = std::min((int)(area.y1 * scaleY), height - 1);
+            areas[t].x2 = std::max(areas[t].x1 + 1, std::min((int)ceil(area.x2 * scaleX), width));
+            areas[t].y2 = std::max(areas[t].y1 + 1, std::min((int)ceil(area.y2 * scaleY), height));
+            order[t] = t;
+            tallest = std::max(tallest, areas[t].y2 - areas[t].y1);
+        }
+        std::sort(order.begin(), order.end(), EndsFirst(areas));
+        nextTile = 0;
+        stripTop = 0;
+        strip.clear();
+        strip.reserve((size_t)tallest * rowBytes);
+        stripBytes = 0;
+    }
+
+    //where image row y is written (rows come in order, the pointer is good until the next call)
+    unsigned char *row(int y) {
+        size_t end = (size_t)(y - stripTop + 1) * rowBytes;
+        if (strip.size() < end){
+            strip.resize(end);
+            stripBytes = std::max(stripBytes, strip.capacity());
+        }
+        return &strip[(size_t)(y - stripTop) * rowBytes];
+    }
+
+    //the rows before end have been written: packs the tiles they finish and drops the rows no tile needs any more
+    void rowsDone(int end) {
+        if (nextTile >= (int)order.size() || areas[order[nextTile]].y2 > end){
+            return;
+        }
+        if (format == PIXELS_AUTO){
+            format = isGrayscale(&strip[0], rowBytes, pixelBytes, r, g, b, width, end - stripTop) ? PIXELS_L8 : PIXELS_RGB565;
+        }
+        while (nextTile < (int)order.size() && areas[order[nextTile]].y2 <= end){
+            int t = order[nextTile++];
+            packTile(t, &strip[(size_t)(areas[t].y1 - stripTop) * rowBytes], rowBytes);
+        }
+
+        int top = end;
+        for (int i = nextTile; i < (int)order.size(); i++){
+            top = std::min(top, areas[order[i]].y1);
+        }
+        if (top > stripTop){
+            size_t dropped = std::min(strip.size(), (size_t)(top - stripTop) * rowBytes);
+            strip.erase(strip.begin(), strip.begin() + dropped);
+            stripTop = top;
+        }
+    }
+
+    //cuts every tile out of a whole decoded image
+    void cutImage(const unsigned char *pixels, int imageRowBytes) {
+        if (format == PIXELS_AUTO){
+            format = isGrayscale(pixels, imageRowBytes, pixelBytes, r, g, b, width, height) ? PIXELS_L8 : PIXELS_RGB565;
+        }
+        for (int t = 0; t < (int)areas.size(); t++){
+            packTile(t, pixels + (size_t)areas[t].y1 * imageRowBytes, imageRowBytes);
+        }
+        nextTile = order.size();
+    }
+
+    bool finished() const {
+        return nextTile == (int)order.size();
+    }
+
+    //memory the packed tiles hold
+    size_t bytes() const {
+        size_t total = 0;
+        for (int t = 0; t < (int)tiles.size(); t++){
+            total += tiles[t].data.size();
+        }
+        return total;
+    }
+
+private:
+    //orders tiles by the row they end on
+    struct EndsFirst {
+        const std::vector<TileArea> &areas;
+        EndsFirst(const std::vector<TileArea> &areas) : areas(areas) {}
+        bool operator()(int a, int b) const {
+            return areas[a].y2 < areas[b].y2 || (areas[a].y2 == areas[b].y2 && a < b);
+        }
+    };
+
+    //packs tile t from rows starting at its first
+    void packTile(int t, const unsigned char *firstRow, int firstRowBytes) {
+        TRACE_SPAN_ARG("pack tile", t);
+        const TileArea &area = areas[t];
+        packPixels(firstRow + area.x1 * pixelBytes, firstRowBytes, pixelBytes, r, g, b, area.x2 - area.x1, area.y2 - area.y1, format, tiles[t]);
+    }
+
+    int width;
+    int height;
+    int pixelBytes;
+    int r;
+    int g;
+    int b;
+    int rowBytes;
+    std::vector<TileArea> areas; //on the image
+    std::vector<int> order; //tiles by the row they end on
+    int nextTile; //in order, the first not packed yet
+    std::vector<unsigned char> strip; //decoded rows from stripTop on
+    int stripTop;
+};
+
+//memory the decoder holds while an image of width x height is cut into tiles tileHeight tall: a baseline JPEG's strip and row of MCUs
+inline size_t tileDecodeBytes(int width, int height, int tileHeight)
+{
+    return (size_t)width * std::min(height, tileHeight + 16) * 3;
+}
+
+//decodes a JPEG a row of MCUs at a time straight into the stream's strip, packing tiles as it goes
+//false (with nothing done) if it isn't a baseline JPEG; throws if the JPEG is broken
+inline bool streamJpegTiles(const unsigned char *bytes, size_t size, const TileCut &cut, TileStream &stream)
+{
+    JpegStrips jpeg;
+    if (!jpeg.open(bytes, size)){
+        return false;
+    }
+    TRACE_SPAN("stream panorama");
+    bool grey = jpeg.channels() == 1;
+    TileCut streamCut = cut;
+    if (grey && streamCut.format == PIXELS_AUTO){
+        streamCut.format = PIXELS_L8; //a grey JPEG needs no looking at
+    }
+    if (grey){
+        stream.begin(streamCut, jpeg.width(), jpeg.height(), 1, 0, 0, 0);
+    }
+    else{
+        stream.begin(streamCut, jpeg.width(), jpeg.height(), 3, 0, 1, 2);
+    }
+    try{
+        while (jpeg.decodeRows()){
+            for (int i = 0; i < jpeg.rows(); i++){
+                int y = jpeg.top() + i;
+                jpeg.convertRow(i, stream.row(y));
+                stream.rowsDone(y + 1); //a row at a time, so the strip never outgrows a row of tiles
+            }
+        }
+    }
+    catch (std::exception &e){
+        throw std::runtime_error(std::string("couldn't decode the panorama: ") + e.what());
+    }
+    return true;
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+//Spans of work on any thread, written out as Chrome trace events (open in chrome://tracing or ui.perfetto.dev)
+//  - TRACE_SPAN times the enclosing scope; the name has to be a string literal (only the pointer is kept)
+//  - spans go into a fixed buffer without locks, a full buffer drops them (and counts them)
+//  - nothing is recorded until Trace::start(), so an idle span costs a branch
+//  - each thread gets a small id, and a name if it calls Trace::nameThread()
+//
+//  Trace::start();
+//  Trace::clear(); //a new load begins
+//  { TRACE_SPAN_ARG("portal fetch", proj.id); ...download... }
+//  Trace::write(path);
+
+#include <stdio.h>
+#include <pthread.h>
+#include <string>
+#include <algorithm>
+#include "Log.h"
+
+class Trace {
+public:
+    enum { EVENTS = 16384, THREADS = 32 };
+
+    //starts recording (the first call also sets time zero)
+    static void start() {
+        State &s = state();
+        if (s.origin == 0.0){
+            s.origin = Log::now();
+        }
+        s.enabled = 1;
+    }
+
+    static bool enabled() {
+        return state().enabled != 0;
+    }
+
+    //drops everything recorded so far (spans still open when this is called may land in the next trace)
+    static void clear() {
+        State &s = state();
+        __sync_fetch_and_add(&s.trace, 1);
+        s.next = 0;
+        s.dropped = 0;
+    }
+
+    //names the calling thread in the viewer
+    static void nameThread(const char *name) {
+        int thread = threadId();
+        if (thread < THREADS){
+            state().threadNames[thread] = name;
+        }
+    }
+
+    //records a finished span
+    static void add(const char *name, double start, double end, int arg) {
+        State &s = state();
+        unsigned trace = s.trace;
+        unsigned index = __sync_fetch_and_add(&s.next, 1);
+        if (index >= EVENTS){
+            __sync_fetch_and_add(&s.dropped, 1);
+            return;
+        }
+        Event &event = s.events[index];
+        event.name = name;
+        event.start = start;
+        event.duration = end - start;
+        event.thread = threadId();
+        event.arg = arg;
+        __sync_synchronize(); //the event is filled in before it is marked as part of this trace
+        event.trace = trace;
+    }
+
+    //writes the spans recorded since the last clear() as a JSON trace, false if the file couldn't be written
+    static bool write(const std::string &path) {
+        State &s = state();
+        FILE *file = fopen(path.c_str(), "w");
+        if (!file){
+            return false;
+        }
+        fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        bool first = true;
+        int threads = std::min((int)s.threadCount, (int)THREADS);
+        for (int t = 0; t < threads; t++){
+            if (s.threadNames[t]){
+                fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", first ? "" : ",\n", t,
+                        s.threadNames[t]);
+                first = false;
+            }
+        }
+        unsigned count = std::min((unsigned)s.next, (unsigned)EVENTS);
+        int written = 0;
+        for (unsigned i = 0; i < count; i++){
+            const Event &event = s.events[i];
+            if (event.trace != s.trace){
+                continue; //still being filled in, or left from an earlier trace
+            }
+            fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.1f,\"dur\":%.1f", first ? "" : ",\n", event.name, event.thread,
+                    (event.start - s.origin) * 1000000.0, event.duration * 1000000.0);
+            if (event.arg != NO_ARG){
+                fprintf(file, ",\"args\":{\"id\":%d}", event.arg);
+            }
+            fprintf(file, "}");
+            first = false;
+            written++;
+        }
+        fprintf(file, "\n]}\n");
+        bool ok = !ferror(file);
+        fclose(file);
+        LOG_INFO("trace: %d spans written to %s%s", written, path.c_str(), s.dropped ? " (the buffer was full, later spans were dropped)" : "");
+        return ok;
+    }
+
+    //times its scope
+    class Span {
+    public:
+        Span(const char *name, int arg = NO_ARG) : name(name), arg(arg), start(enabled() ? Log::now() : 0.0) {}
+        ~Span() {
+            if (start != 0.0){
+                add(name, start, Log::now(), arg);
+            }
+        }
+    private:
+        const char *name;
+        int arg;
+        double start;
+    };
+
+    static const int NO_ARG = -0x7fffffff;
+
+private:
+    struct Event {
+        const char *name;
+        double start;
+        double duration;
+        int thread;
+        int arg;
+        volatile unsigned trace; //trace the event belongs to, set last
+    };
+
+    struct State {
+        Event events[EVENTS];
+        volatile unsigned next;
+        volatile unsigned trace;
+        volatile unsigned dropped;
+        volatile int enabled;
+        double origin;
+        pthread_key_t threadKey;
+        volatile int threadCount;
+        const char *threadNames[THREADS];
+
+        State() : next(0), trace(1), dropped(0), enabled(0), origin(0.0), threadCount(0) {
+            for (int i = 0; i < EVENTS; i++){
+                events[i].trace = 0;
+            }
+            for (int i = 0; i < THREADS; i++){
+                threadNames[i] = 0;
+            }
+            pthread_key_create(&threadKey, 0);
+        }
+    };
+
+    static State &state() {
+        static State s;
+        return s;
+    }
+
+    //the calling thread's id, handed out in the order threads first ask
+    static int threadId() {
+        State &s = state();
+        void *id = pthread_getspecific(s.threadKey);
+        if (!id){
+            id = (void *)(long)(__sync_fetch_and_add(&s.threadCount, 1) + 1);
+            pthread_setspecific(s.threadKey, id);
+        }
+        return (int)(long)id - 1;
+    }
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+//times the rest of the enclosing scope
+#define TRACE_SPAN(name) Trace::Span TRACE_CONCAT(traceSpan, __LINE__)(name)
+#define TRACE_SPAN_ARG(name, arg) Trace::Span TRACE_CONCAT(traceSpan, __LINE__)(name, (arg))
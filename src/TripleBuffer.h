@@ -0,0 +1,44 @@
+#pragma once
+
+//Hands the latest value from one writer thread to one reader thread without locks or waiting
+//The writer fills its own buffer and publishes it; the reader swaps in the newest published one.
+//Values published between two reads are skipped, never queued.
+//
+//  view.write(state);          //writer thread
+//  if (view.update()) ...      //reader thread, then view.read()
+
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() : back(0), middle(1), front(2) {}
+
+    //writer only: publishes value as the newest
+    void write(const T &value) {
+        buffers[back] = value;
+        __sync_synchronize(); //the value is written before it is published
+        back = __sync_lock_test_and_set(&middle, back | FRESH) & INDEX;
+    }
+
+    //reader only: takes the newest published value, false if nothing new was published
+    bool update() {
+        if (!(middle & FRESH)){
+            return false;
+        }
+        front = __sync_lock_test_and_set(&middle, front) & INDEX;
+        __sync_synchronize(); //reads the value published with it
+        return true;
+    }
+
+    //reader only: the value taken by the last update()
+    const T &read() const {
+        return buffers[front];
+    }
+
+private:
+    enum { INDEX = 3, FRESH = 4 };
+
+    T buffers[3];
+    int back; //owned by the writer
+    volatile int middle; //last published buffer, with FRESH set until the reader takes it
+    int front; //owned by the reader
+};
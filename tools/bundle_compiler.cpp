@@ -0,0 +1,621 @@
+//Compiles a canopy into a bundle the app loads without the network (see src/CanopyBundle.h)
+//
+//Reads the canopy information, the panorama and the portal images from the services or from files, and writes:
+//  - the panorama cut into the app's tiles, at full size and at 1/2, 1/4, ... (the app uploads the largest that fits)
+//  - each projection's description and caption wrapped into the overlay's lines
+//  - each portal image shrunk to what the overlay shows
+//all as RGBA pixels, so loading a bundle is mapping it and uploading what it holds.
+//
+//Build from the repository root:
+//  c++ -O2 -I src tools/bundle_compiler.cpp -o bundle_compiler
+//Add -DBUNDLE_WITH_LIBJPEG -ljpeg to read JPEGs (the services send JPEGs; the stand-in server sends BMPs unless built with libjpeg).
+//
+//Run:
+//  ./bundle_compiler --server http://ghosts.slifty.com/services/ --canopy 3 --out canopy_3.bundle
+//  ./bundle_compiler --manifest canopy.xml --panorama panorama.ppm --portals images/ --out canopy_3.bundle
+//Copy the bundle into the app's Documents/bundles/ (iTunes file sharing) as canopy_<id>.bundle.
+//
+//Options:
+//  --server URL      services to download from, with --canopy N
+//  --manifest FILE   canopy information as getCanopyInformation.php gives it, with --panorama FILE and --portals DIR
+//                    (portal images are DIR/<projection id>.ppm, .bmp or .jpg)
+//  --out FILE        where to write the bundle
+//  --tile WxH        tile size; must match the app's TILE_WIDTH/TILE_HEIGHT (256x2048)
+//  --levels N        sizes stored: full, 1/2, ... 1/2^(N-1) (4)
+//  --portal-max WxH  largest portal image kept; the app's PORTAL_MAX_WIDTH/PORTAL_MAX_HEIGHT (450x450)
+
+#include "CanopyBundle.h"
+#include "CanopyView.h"
+#include "DiskCache.h"
+#include "HttpClient.h"
+#include "TextWrap.h"
+#include <vector>
+#include <string>
+#include <sstream>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef BUNDLE_WITH_LIBJPEG
+#include <jpeglib.h>
+#endif
+
+using namespace std;
+
+struct Image {
+    int width;
+    int height;
+    vector<unsigned char> rgba;
+
+    Image() : width(0), height(0) {}
+};
+
+struct SourceProjection {
+    int id;
+    int offX;
+    int offY;
+    int width;
+    int height;
+    string hash;
+    string description;
+    string caption;
+};
+
+//-------------------------------------------------------------------------------------------------
+// Reading
+
+static bool readFile(const string &path, string &bytes)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file){
+        return false;
+    }
+    char buffer[65536];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0){
+        bytes.append(buffer, n);
+    }
+    fclose(file);
+    return true;
+}
+
+static unsigned get32(const string &bytes, size_t at)
+{
+    return (unsigned char)bytes[at] | (unsigned char)bytes[at + 1] << 8 | (unsigned char)bytes[at + 2] << 16 | (unsigned)(unsigned char)bytes[at + 3] << 24;
+}
+
+//binary PPM (P6)
+static bool decodePpm(const string &bytes, Image &image)
+{
+    int maxValue = 0;
+    int headerLength = 0;
+    if (sscanf(bytes.c_str(), "P6 %d %d %d%n", &image.width, &image.height, &maxValue, &headerLength) != 3 || maxValue != 255 ||
+        image.width <= 0 || image.height <= 0 || bytes.size() < headerLength + 1 + (size_t)image.width * image.height * 3){
+        return false;
+    }
+    const unsigned char *rgb = (const unsigned char *)bytes.data() + headerLength + 1;
+    image.rgba.resize((size_t)image.width * image.height * 4);
+    for (size_t i = 0; i < (size_t)image.width * image.height; i++){
+        image.rgba[i * 4 + 0] = rgb[i * 3 + 0];
+        image.rgba[i * 4 + 1] = rgb[i * 3 + 1];
+        image.rgba[i * 4 + 2] = rgb[i * 3 + 2];
+        image.rgba[i * 4 + 3] = 255;
+    }
+    return true;
+}
+
+//uncompressed 24 or 32 bit BMP, bottom-up or top-down
+static bool decodeBmp(const string &bytes, Image &image)
+{
+    if (bytes.size() < 54){
+        return false;
+    }
+    unsigned dataOffset = get32(bytes, 10);
+    image.width = (int)get32(bytes, 18);
+    int height = (int)get32(bytes, 22);
+    int bits = (unsigned char)bytes[28] | (unsigned char)bytes[29] << 8;
+    unsigned compression = get32(bytes, 30);
+    image.height = abs(height);
+    int channels = bits / 8;
+    size_t rowBytes = ((size_t)image.width * channels + 3) & ~(size_t)3;
+    if ((bits != 24 && bits != 32) || (compression != 0 && compression != 3) || image.width <= 0 || image.height == 0 ||
+        bytes.size() < dataOffset + rowBytes * image.height){
+        return false;
+    }
+    image.rgba.resize((size_t)image.width * image.height * 4);
+    for (int y = 0; y < image.height; y++){
+        const unsigned char *row = (const unsigned char *)bytes.data() + dataOffset + rowBytes * (height > 0 ? image.height - 1 - y : y);
+        unsigned char *out = &image.rgba[(size_t)y * image.width * 4];
+        for (int x = 0; x < image.width; x++){
+            out[x * 4 + 0] = row[x * channels + 2];
+            out[x * 4 + 1] = row[x * channels + 1];
+            out[x * 4 + 2] = row[x * channels + 0];
+            out[x * 4 + 3] = 255;
+        }
+    }
+    return true;
+}
+
+#ifdef BUNDLE_WITH_LIBJPEG
+static bool decodeJpeg(const string &bytes, Image &image)
+{
+    jpeg_decompress_struct cinfo;
+    jpeg_error_mgr jerr;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, (unsigned char *)bytes.data(), bytes.size());
+    if (jpeg_read_header(&cinfo, TRUE) != JPEG_HEADER_OK){
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+    cinfo.out_color_space = JCS_RGB;
+    jpeg_start_decompress(&cinfo);
+    image.width = cinfo.output_width;
+    image.height = cinfo.output_height;
+    image.rgba.resize((size_t)image.width * image.height * 4);
+    vector<unsigned char> row(image.width * 3);
+    while (cinfo.output_scanline < cinfo.output_height){
+        unsigned char *out = &image.rgba[(size_t)cinfo.output_scanline * image.width * 4];
+        JSAMPROW rows[1] = { &row[0] };
+        jpeg_read_scanlines(&cinfo, rows, 1);
+        for (int x = 0; x < image.width; x++){
+            out[x * 4 + 0] = row[x * 3 + 0];
+            out[x * 4 + 1] = row[x * 3 + 1];
+            out[x * 4 + 2] = row[x * 3 + 2];
+            out[x * 4 + 3] = 255;
+        }
+    }
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    return true;
+}
+#endif
+
+static bool decodeImage(const string &bytes, Image &image)
+{
+    if (bytes.compare(0, 2, "P6") == 0){
+        return decodePpm(bytes, image);
+    }
+    if (bytes.compare(0, 2, "BM") == 0){
+        return decodeBmp(bytes, image);
+    }
+#ifdef BUNDLE_WITH_LIBJPEG
+    if (bytes.size() > 2 && (unsigned char)bytes[0] == 0xff && (unsigned char)bytes[1] == 0xd8){
+        return decodeJpeg(bytes, image);
+    }
+#endif
+    return false;
+}
+
+static string xmlUnescape(const string &text)
+{
+    string out;
+    for (size_t i = 0; i < text.size(); i++){
+        size_t end = text[i] == '&' ? text.find(';', i) : string::npos;
+        if (end == string::npos){
+            out += text[i];
+            continue;
+        }
+        string entity = text.substr(i + 1, end - i - 1);
+        if (entity == "amp") out += '&';
+        else if (entity == "lt") out += '<';
+        else if (entity == "gt") out += '>';
+        else if (entity == "quot") out += '"';
+        else if (entity == "apos") out += '\'';
+        else if (!entity.empty() && entity[0] == '#'){
+            unsigned code = entity.size() > 1 && entity[1] == 'x' ? strtoul(entity.c_str() + 2, 0, 16) : strtoul(entity.c_str() + 1, 0, 10);
+            if (code < 0x80){ //as UTF-8
+                out += (char)code;
+            }
+            else if (code < 0x800){
+                out += (char)(0xc0 | code >> 6);
+                out += (char)(0x80 | (code & 0x3f));
+            }
+            else{
+                out += (char)(0xe0 | code >> 12);
+                out += (char)(0x80 | ((code >> 6) & 0x3f));
+                out += (char)(0x80 | (code & 0x3f));
+            }
+        }
+        else{
+            out += text.substr(i, end - i + 1);
+        }
+        i = end;
+    }
+    return out;
+}
+
+//the text of the first <tag> in xml[from, to), false if there is none
+static bool xmlChild(const string &xml, size_t from, size_t to, const string &tag, string &value)
+{
+    size_t open = xml.find("<" + tag + ">", from);
+    if (open == string::npos || open >= to){
+        return false;
+    }
+    open += tag.size() + 2;
+    size_t close = xml.find("</" + tag + ">", open);
+    if (close == string::npos || close > to){
+        return false;
+    }
+    value = xmlUnescape(xml.substr(open, close - open));
+    return true;
+}
+
+//reads the canopy information the way CanopyLoader does
+static bool parseManifest(const string &xml, int &width, int &height, vector<SourceProjection> &projections)
+{
+    string value;
+    size_t at = xml.find("<projections>");
+    size_t canopyEnd = at != string::npos ? at : xml.size(); //the canopy's own size comes before its projections
+    if (!xmlChild(xml, 0, canopyEnd, "width", value) || (width = atoi(value.c_str())) <= 0 ||
+        !xmlChild(xml, 0, canopyEnd, "height", value) || (height = atoi(value.c_str())) <= 0){
+        return false;
+    }
+    while (at != string::npos && (at = xml.find("<projection>", at)) != string::npos){
+        size_t end = xml.find("</projection>", at);
+        if (end == string::npos){
+            return false;
+        }
+        SourceProjection p;
+        p.id = xmlChild(xml, at, end, "id", value) ? atoi(value.c_str()) : 0;
+        p.offX = xmlChild(xml, at, end, "offX", value) ? atoi(value.c_str()) : 0;
+        p.offY = xmlChild(xml, at, end, "offY", value) ? atoi(value.c_str()) : 0;
+        p.height = xmlChild(xml, at, end, "height", value) ? atoi(value.c_str()) : 0;
+        p.width = xmlChild(xml, at, end, "width", value) ? atoi(value.c_str()) : 0;
+        xmlChild(xml, at, end, "description", p.description);
+        if (p.width != 0){
+            xmlChild(xml, at, end, "caption", p.caption);
+        }
+        else{
+            p.caption = " ";
+        }
+        if (!xmlChild(xml, at, end, "hash", p.hash)){
+            p.hash = DiskCache::hash(p.description + '\0' + p.caption);
+        }
+        projections.push_back(p);
+        at = end;
+    }
+    return true;
+}
+
+//-------------------------------------------------------------------------------------------------
+// Resizing
+
+//averages the pixels each output pixel covers
+static Image shrink(const Image &source, int width, int height)
+{
+    Image out;
+    out.width = width;
+    out.height = height;
+    out.rgba.resize((size_t)width * height * 4);
+    for (int y = 0; y < height; y++){
+        int y1 = (int)((long long)y * source.height / height);
+        int y2 = max(y1 + 1, (int)((long long)(y + 1) * source.height / height));
+        for (int x = 0; x < width; x++){
+            int x1 = (int)((long long)x * source.width / width);
+            int x2 = max(x1 + 1, (int)((long long)(x + 1) * source.width / width));
+            unsigned sum[4] = { 0, 0, 0, 0 };
+            for (int sy = y1; sy < y2; sy++){
+                const unsigned char *p = &source.rgba[((size_t)sy * source.width + x1) * 4];
+                for (int sx = x1; sx < x2; sx++, p += 4){
+                    sum[0] += p[0];
+                    sum[1] += p[1];
+                    sum[2] += p[2];
+                    sum[3] += p[3];
+                }
+            }
+            unsigned count = (y2 - y1) * (x2 - x1);
+            for (int c = 0; c < 4; c++){
+                out.rgba[((size_t)y * width + x) * 4 + c] = (unsigned char)((sum[c] + count / 2) / count);
+            }
+        }
+    }
+    return out;
+}
+
+//-------------------------------------------------------------------------------------------------
+// Writing
+
+class BundleWriter {
+public:
+    BundleWriter() : file(0), at(0) {}
+
+    ~BundleWriter() {
+        if (file){
+            fclose(file);
+        }
+    }
+
+    bool open(const string &path) {
+        file = fopen(path.c_str(), "wb");
+        return file != 0;
+    }
+
+    //leaves room for the header and tables, written last by writeAt()
+    void reserve(uint64_t bytes) {
+        at = align(bytes);
+        fseek(file, at, SEEK_SET);
+    }
+
+    //appends data at the next 16 byte boundary, returning where it went
+    uint64_t append(const void *data, size_t size) {
+        uint64_t start = align(at);
+        if (start != at){
+            static const char zeros[16] = { 0 };
+            fwrite(zeros, 1, start - at, file);
+        }
+        fwrite(data, 1, size, file);
+        at = start + size;
+        return start;
+    }
+
+    void writeAt(uint64_t offset, const void *data, size_t size) {
+        fseek(file, offset, SEEK_SET);
+        fwrite(data, 1, size, file);
+        fseek(file, at, SEEK_SET);
+    }
+
+    bool close() {
+        bool ok = !ferror(file);
+        ok = fclose(file) == 0 && ok;
+        file = 0;
+        return ok;
+    }
+
+    uint64_t size() const {
+        return at;
+    }
+
+    static uint64_t align(uint64_t offset) {
+        return (offset + 15) & ~(uint64_t)15;
+    }
+
+private:
+    FILE *file;
+    uint64_t at;
+};
+
+//cuts one tile out of a level the way the app's tileFrom() does
+static Image cutTile(const Image &level, const TileArea &area, int panoramaWidth, int panoramaHeight)
+{
+    float scaleX = level.width / (float)panoramaWidth;
+    float scaleY = level.height / (float)panoramaHeight;
+    int x1 = min((int)(area.x1 * scaleX), level.width - 1);
+    int y1 = min((int)(area.y1 * scaleY), level.height - 1);
+    int x2 = max(x1 + 1, min((int)ceil(area.x2 * scaleX), level.width));
+    int y2 = max(y1 + 1, min((int)ceil(area.y2 * scaleY), level.height));
+
+    Image tile;
+    tile.width = x2 - x1;
+    tile.height = y2 - y1;
+    tile.rgba.resize((size_t)tile.width * tile.height * 4);
+    for (int y = 0; y < tile.height; y++){
+        memcpy(&tile.rgba[(size_t)y * tile.width * 4], &level.rgba[((size_t)(y1 + y) * level.width + x1) * 4], tile.width * 4);
+    }
+    return tile;
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: bundle_compiler (--server URL --canopy N | --manifest FILE --panorama FILE --portals DIR) --out FILE\n"
+                    "                       [--tile WxH] [--levels N] [--portal-max WxH]\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    string server, manifestPath, panoramaPath, portalsDir, outPath;
+    int canopy = -1;
+    int tileWidth = 256;
+    int tileHeight = 2048;
+    int levels = 4;
+    int portalMaxWidth = 450;
+    int portalMaxHeight = 450;
+
+    for (int i = 1; i < argc; i++){
+        string arg = argv[i];
+        if (i + 1 >= argc){
+            usage();
+        }
+        string value = argv[++i];
+        if (arg == "--server") server = value[value.size() - 1] == '/' ? value : value + "/";
+        else if (arg == "--canopy") canopy = atoi(value.c_str());
+        else if (arg == "--manifest") manifestPath = value;
+        else if (arg == "--panorama") panoramaPath = value;
+        else if (arg == "--portals") portalsDir = value[value.size() - 1] == '/' ? value : value + "/";
+        else if (arg == "--out") outPath = value;
+        else if (arg == "--tile") sscanf(value.c_str(), "%dx%d", &tileWidth, &tileHeight);
+        else if (arg == "--levels") levels = max(1, atoi(value.c_str()));
+        else if (arg == "--portal-max") sscanf(value.c_str(), "%dx%d", &portalMaxWidth, &portalMaxHeight);
+        else usage();
+    }
+    bool fromServer = !server.empty() && canopy >= 0;
+    if (outPath.empty() || (!fromServer && (manifestPath.empty() || panoramaPath.empty())) || tileWidth <= 0 || 1024 % tileWidth != 0 || tileHeight <= 0){
+        usage();
+    }
+
+    HttpClient client;
+    string manifestXml;
+    if (fromServer){
+        ostringstream url;
+        url << server << "getCanopyInformation.php?c=" << canopy;
+        HttpResponse response;
+        if (!client.get(url.str(), response) || response.status != 200){
+            fprintf(stderr, "couldn't download %s: %s\n", url.str().c_str(), response.error.c_str());
+            return 1;
+        }
+        manifestXml = response.body;
+    }
+    else if (!readFile(manifestPath, manifestXml)){
+        fprintf(stderr, "couldn't read %s\n", manifestPath.c_str());
+        return 1;
+    }
+
+    int width = 0;
+    int height = 0;
+    vector<SourceProjection> projections;
+    if (!parseManifest(manifestXml, width, height, projections)){
+        fprintf(stderr, "couldn't read the canopy information\n");
+        return 1;
+    }
+    if (width < 1024){
+        fprintf(stderr, "the panorama is %d pixels wide, the app needs at least 1024\n", width);
+        return 1;
+    }
+
+    string panoramaBytes;
+    if (fromServer){
+        ostringstream url;
+        url << server << "getCanopyImage.php?c=" << canopy << "&h=" << height << "&w=" << width << "&x=0&y=0";
+        HttpResponse response;
+        if (!client.get(url.str(), response) || response.status != 200){
+            fprintf(stderr, "couldn't download %s: %s\n", url.str().c_str(), response.error.c_str());
+            return 1;
+        }
+        panoramaBytes.swap(response.body);
+    }
+    else if (!readFile(panoramaPath, panoramaBytes)){
+        fprintf(stderr, "couldn't read %s\n", panoramaPath.c_str());
+        return 1;
+    }
+    Image panorama;
+    if (!decodeImage(panoramaBytes, panorama)){
+        fprintf(stderr, "couldn't decode the panorama (PPM and BMP are read, JPEG only when built with BUNDLE_WITH_LIBJPEG)\n");
+        return 1;
+    }
+    panoramaBytes.clear();
+    if (panorama.width != width || panorama.height != height){
+        printf("panorama is %dx%d, the canopy information says %dx%d; resizing\n", panorama.width, panorama.height, width, height);
+        panorama = shrink(panorama, width, height);
+    }
+
+    vector<TileArea> areas = canopyTileAreas(width, height, tileWidth, tileHeight);
+
+    BundleWriter writer;
+    if (!writer.open(outPath)){
+        fprintf(stderr, "couldn't write %s\n", outPath.c_str());
+        return 1;
+    }
+
+    //the header and tables go first, but are only known once everything after them is written
+    BundleHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BUNDLE_MAGIC, sizeof(header.magic));
+    header.version = BUNDLE_VERSION;
+    header.tileWidth = tileWidth;
+    header.tileHeight = tileHeight;
+    header.width = width;
+    header.height = height;
+    header.tileCount = areas.size();
+    header.levelCount = levels;
+    header.projectionCount = projections.size();
+    header.levelsOffset = BundleWriter::align(sizeof(BundleHeader));
+    uint64_t tablesAt = BundleWriter::align(header.levelsOffset + levels * sizeof(BundleLevel));
+    vector<BundleLevel> levelTable(levels);
+    for (int l = 0; l < levels; l++){
+        memset(&levelTable[l], 0, sizeof(BundleLevel));
+        levelTable[l].scale = 1 << l;
+        levelTable[l].tilesOffset = tablesAt;
+        tablesAt = BundleWriter::align(tablesAt + areas.size() * sizeof(BundleTile));
+    }
+    header.projectionsOffset = tablesAt;
+    writer.reserve(tablesAt + projections.size() * sizeof(BundleProjection));
+
+    //tiles, at the sizes the app would download the panorama at
+    for (int l = 0; l < levels; l++){
+        int scale = levelTable[l].scale;
+        Image shrunk;
+        if (scale > 1){
+            shrunk = shrink(panorama, max(1, width / scale), max(1, height / scale));
+        }
+        const Image &level = scale > 1 ? shrunk : panorama;
+        vector<BundleTile> tiles(areas.size());
+        for (size_t t = 0; t < areas.size(); t++){
+            Image tile = cutTile(level, areas[t], width, height);
+            memset(&tiles[t], 0, sizeof(BundleTile));
+            tiles[t].width = tile.width;
+            tiles[t].height = tile.height;
+            tiles[t].pixelsOffset = writer.append(&tile.rgba[0], tile.rgba.size());
+        }
+        writer.writeAt(levelTable[l].tilesOffset, &tiles[0], tiles.size() * sizeof(BundleTile));
+        printf("level 1/%d: %dx%d, %d tiles\n", scale, level.width, level.height, (int)tiles.size());
+    }
+
+    //projections: wrapped text and shrunk portal images
+    vector<BundleProjection> projectionTable(projections.size());
+    int images = 0;
+    for (size_t p = 0; p < projections.size(); p++){
+        const SourceProjection &source = projections[p];
+        BundleProjection &out = projectionTable[p];
+        memset(&out, 0, sizeof(out));
+        out.id = source.id;
+        out.offX = source.offX;
+        out.offY = source.offY;
+        out.width = source.width;
+        out.height = source.height;
+        out.hasImage = source.width != 0;
+        memcpy(out.hash, source.hash.data(), min(source.hash.size(), sizeof(out.hash)));
+
+        vector<string> textLines, captionLines;
+        wrapProjectionText(source.description, source.caption, textLines, captionLines);
+        string lines;
+        for (size_t i = 0; i < textLines.size() + captionLines.size(); i++){
+            const string &line = i < textLines.size() ? textLines[i] : captionLines[i - textLines.size()];
+            uint32_t length = line.size();
+            lines.append((const char *)&length, sizeof(length));
+            lines += line;
+        }
+        out.textLineCount = textLines.size();
+        out.captionLineCount = captionLines.size();
+        out.linesOffset = writer.append(lines.data(), lines.size());
+
+        if (!out.hasImage){
+            continue;
+        }
+        string imageBytes;
+        if (fromServer){
+            ostringstream url;
+            url << server << "getPortalImage.php?p=" << source.id;
+            HttpResponse response;
+            if (client.get(url.str(), response) && response.status == 200){
+                imageBytes.swap(response.body);
+            }
+        }
+        else{
+            ostringstream path;
+            path << portalsDir << source.id;
+            if (!readFile(path.str() + ".ppm", imageBytes) && !readFile(path.str() + ".bmp", imageBytes)){
+                readFile(path.str() + ".jpg", imageBytes);
+            }
+        }
+        Image image;
+        if (!decodeImage(imageBytes, image)){
+            printf("no portal image for projection %d, the app will show its text only\n", source.id);
+            continue;
+        }
+        float scale = min(portalMaxWidth / (float)image.width, portalMaxHeight / (float)image.height);
+        if (scale < 1.0f){
+            image = shrink(image, max(1, (int)(image.width * scale)), max(1, (int)(image.height * scale)));
+        }
+        out.imageWidth = image.width;
+        out.imageHeight = image.height;
+        out.imageOffset = writer.append(&image.rgba[0], image.rgba.size());
+        images++;
+    }
+    if (!projectionTable.empty()){
+        writer.writeAt(header.projectionsOffset, &projectionTable[0], projectionTable.size() * sizeof(BundleProjection));
+    }
+    writer.writeAt(header.levelsOffset, &levelTable[0], levelTable.size() * sizeof(BundleLevel));
+    writer.writeAt(0, &header, sizeof(header));
+
+    uint64_t size = writer.size();
+    if (!writer.close()){
+        fprintf(stderr, "couldn't write %s\n", outPath.c_str());
+        return 1;
+    }
+    printf("%s: %dx%d panorama, %d projections (%d portal images), %.1f MB\n", outPath.c_str(), width, height,
+           (int)projections.size(), images, size / 1048576.0);
+    return 0;
+}
@@ -0,0 +1,822 @@
+//Draws the canopy view offscreen for golden image and performance checks, without a device or a GPU
+//
+//Runs the app's view code (CanopyView.h, ProjectionKernels.h, DirectionIndex.h) over a scripted or recorded
+//orientation sequence and draws each DrawList with OpenGL on an EGL surfaceless context, so Mesa's
+//software rasterizer (llvmpipe) is enough. Frames can be written as PPMs, compared against a directory of
+//golden frames, and the time to build and draw each frame is reported.
+//
+//Build from the repository root:
+//  c++ -O2 -I src tools/headless_render.cpp -o headless_render -lEGL -lGL
+//
+//Run with a software rasterizer on a machine without a GPU:
+//  EGL_PLATFORM=surfaceless LIBGL_ALWAYS_SOFTWARE=1 ./headless_render --out frames --every 10
+//  ./headless_render --golden frames           (exits with 1 if a frame differs)
+//
+//Options:
+//  --frames N           frames to draw (600)
+//  --orientations FILE  gyro readings to replay, one "x y z" line (radians) per frame, instead of the sweep
+//  --panorama FILE      binary PPM (P6) to use as the panorama instead of a generated one
+//  --width N            generated panorama width (8000)
+//  --height N           generated panorama height (1024)
+//  --projections N      data objects placed on the canopy (20)
+//  --out DIR            writes frames there as frame_NNNN.ppm
+//  --every N            writes or compares every Nth frame (1)
+//  --golden DIR         compares frames with the ones of the same name there
+//  --tolerance N        largest difference in a channel that still counts as the same (2)
+//  --max-diff F         share of pixels that may differ before a frame fails (0.001)
+//  --format F           tile format: rgb, rgba, rgb565, l8 or etc1 (rgb); the upload time and memory are reported
+//  --cylinder           draws the panorama on a cylinder through a perspective camera (CylinderView.h), culling tiles
+
+#define GL_GLEXT_PROTOTYPES
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include "CanopyView.h"
+#include "ProjectionKernels.h"
+#include "DirectionIndex.h"
+#include "PixelFormats.h"
+#include "CylinderView.h"
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/time.h>
+
+using namespace std;
+
+//the app's screen: portrait, with the canopy drawn sideways
+const int WINDOW_WIDTH = 768;
+const int WINDOW_HEIGHT = 1024;
+
+const int TILE_WIDTH = 256;
+const int TILE_HEIGHT = 2048;
+const int SCREEN_WIDTH = 1024;
+const int SCREEN_HEIGHT = 768;
+const float SCAN_TIME = 1.0f;
+const float FRAME_SECONDS = 1.0f / 60.0f;
+
+static double now()
+{
+    timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+struct Image {
+    int width;
+    int height;
+    vector<unsigned char> rgb;
+
+    Image() : width(0), height(0) {}
+};
+
+static bool readPpm(const string &path, Image &image)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file){
+        return false;
+    }
+    int maxValue = 0;
+    bool ok = fscanf(file, "P6 %d %d %d", &image.width, &image.height, &maxValue) == 3 && maxValue == 255 && fgetc(file) != EOF;
+    if (ok){
+        image.rgb.resize((size_t)image.width * image.height * 3);
+        ok = fread(&image.rgb[0], 1, image.rgb.size(), file) == image.rgb.size();
+    }
+    fclose(file);
+    return ok;
+}
+
+static bool writePpm(const string &path, const Image &image)
+{
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file){
+        return false;
+    }
+    fprintf(file, "P6\n%d %d\n255\n", image.width, image.height);
+    bool ok = fwrite(&image.rgb[0], 1, image.rgb.size(), file) == image.rgb.size();
+    fclose(file);
+    return ok;
+}
+
+//a panorama that shows where every tile came from: hue bands across, a brightness ramp down and a grid
+static Image generatePanorama(int width, int height)
+{
+    Image image;
+    image.width = width;
+    image.height = height;
+    image.rgb.resize((size_t)width * height * 3);
+    for (int y = 0; y < height; y++){
+        for (int x = 0; x < width; x++){
+            unsigned char *p = &image.rgb[((size_t)y * width + x) * 3];
+            float band = x / (float)width * 6.2832f;
+            float light = 0.35f + 0.65f * y / height;
+            bool line = x % 128 == 0 || y % 128 == 0;
+            p[0] = line ? 255 : (unsigned char)(light * (127 + 127 * sinf(band)));
+            p[1] = line ? 255 : (unsigned char)(light * (127 + 127 * sinf(band + 2.094f)));
+            p[2] = line ? 255 : (unsigned char)(light * (127 + 127 * sinf(band + 4.189f)));
+        }
+    }
+    return image;
+}
+
+//cuts the panorama into tiles laid out as the app lays them out: the last 1024 pixels are copied in front
+//tiles are uploaded as plain RGB straight from the panorama's rows, or packed in format if there is one (format < 0 is none);
+//bytes is their memory
+static vector<GLuint> uploadTiles(const Image &panorama, CanopyGrid &grid, int format, size_t &bytes)
+{
+    grid.ghostHeight = panorama.height;
+    grid.ghostRows = (int)ceil(panorama.height / (float)TILE_HEIGHT);
+    grid.ghostCols = (int)ceil(panorama.width / (float)TILE_WIDTH) + 1024 / TILE_WIDTH;
+    grid.ghostWidth = panorama.width + 1024;
+
+    vector<GLuint> tiles(grid.ghostRows * grid.ghostCols);
+    glGenTextures(tiles.size(), &tiles[0]);
+    PackedPixels packed; //reused for every tile
+    bytes = 0;
+    for (int col = 0; col < grid.ghostCols; col++){
+        int x = col * TILE_WIDTH - 1024;
+        int w = min(TILE_WIDTH, panorama.width - x);
+        if (x < 0){
+            x += panorama.width;
+            w = TILE_WIDTH;
+        }
+        for (int row = 0; row < grid.ghostRows; row++){
+            int y = row * TILE_HEIGHT;
+            int h = min(TILE_HEIGHT, panorama.height - y);
+            const unsigned char *pixels = &panorama.rgb[((size_t)y * panorama.width + x) * 3]; //cut straight out of the panorama's rows
+            glBindTexture(GL_TEXTURE_2D, tiles[col * grid.ghostRows + row]);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            if (format < 0){
+                glPixelStorei(GL_UNPACK_ROW_LENGTH, panorama.width);
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, w, h, 0, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+                glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+                bytes += (size_t)w * h * 3;
+                continue;
+            }
+            packPixels(pixels, panorama.width * 3, 3, 0, 1, 2, w, h, (PixelFormat)format, packed);
+            PixelUpload upload = pixelUpload((PixelFormat)format);
+            if (upload.compressed){
+                glCompressedTexImage2D(GL_TEXTURE_2D, 0, upload.format, w, h, 0, packed.data.size(), &packed.data[0]);
+            }
+            else{
+                glTexImage2D(GL_TEXTURE_2D, 0, upload.format, w, h, 0, upload.format, upload.type, &packed.data[0]);
+            }
+            bytes += packed.data.size();
+        }
+    }
+    return tiles;
+}
+
+static void rect(float x1, float y1, float x2, float y2)
+{
+    glBegin(GL_QUADS);
+    glVertex2f(x1, y1);
+    glVertex2f(x2, y1);
+    glVertex2f(x2, y2);
+    glVertex2f(x1, y2);
+    glEnd();
+}
+
+static void texturedRect(GLuint texture, float x1, float y1, float x2, float y2)
+{
+    glEnable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glColor4f(1, 1, 1, 1);
+    glBegin(GL_QUADS);
+    glTexCoord2f(0, 0); glVertex2f(x1, y1);
+    glTexCoord2f(1, 0); glVertex2f(x2, y1);
+    glTexCoord2f(1, 1); glVertex2f(x2, y2);
+    glTexCoord2f(0, 1); glVertex2f(x1, y2);
+    glEnd();
+    glDisable(GL_TEXTURE_2D);
+}
+
+//stands in for a text label, which needs fonts this tool doesn't have
+static void label(float x, float y, float width, float height, float r, float g, float b)
+{
+    glPushMatrix();
+    glRotatef(90.0, 0.0, 0.0, 1.0);
+    glColor4f(r, g, b, 1);
+    rect(x - width / 2, y - height / 2, x + width / 2, y + height / 2);
+    glPopMatrix();
+}
+
+//The cylinder view of a frame: its camera as the app's CameraPersp would have it, and the tiles left after culling
+struct CylinderScene {
+    CylinderMesh mesh;
+    float projection[16]; //column major
+    float view[16];
+    vector<int> visible; //strips of the mesh
+};
+
+//a * b, column major
+static void multiply(const float a[16], const float b[16], float out[16])
+{
+    for (int c = 0; c < 4; c++){
+        for (int r = 0; r < 4; r++){
+            out[c * 4 + r] = 0.0f;
+            for (int k = 0; k < 4; k++){
+                out[c * 4 + r] += a[k * 4 + r] * b[c * 4 + k];
+            }
+        }
+    }
+}
+
+//aims the camera as GhostsApp::aimCylinder() does with CameraPersp::setPerspective() and lookAt(), then culls
+static void aimCylinder(CylinderScene &scene, const CanopyGrid &grid, const CanopyPose &pose)
+{
+    CylinderCamera camera = cylinderCamera(scene.mesh, grid, pose);
+
+    float f = 1.0f / tanf(camera.fov * (float)M_PI / 360.0f);
+    float aspect = WINDOW_WIDTH / (float)WINDOW_HEIGHT;
+    float n = camera.nearClip;
+    float z = camera.farClip;
+    float projection[16] = { f / aspect, 0, 0, 0, 0, f, 0, 0, 0, 0, (z + n) / (n - z), -1, 0, 0, 2 * z * n / (n - z), 0 };
+    memcpy(scene.projection, projection, sizeof(projection));
+
+    float forward[3], side[3], up[3];
+    for (int i = 0; i < 3; i++){
+        forward[i] = camera.target[i] - camera.eye[i];
+    }
+    side[0] = forward[1] * camera.up[2] - forward[2] * camera.up[1];
+    side[1] = forward[2] * camera.up[0] - forward[0] * camera.up[2];
+    side[2] = forward[0] * camera.up[1] - forward[1] * camera.up[0];
+    float length = sqrtf(side[0] * side[0] + side[1] * side[1] + side[2] * side[2]);
+    for (int i = 0; i < 3; i++){
+        side[i] /= length;
+    }
+    up[0] = side[1] * forward[2] - side[2] * forward[1];
+    up[1] = side[2] * forward[0] - side[0] * forward[2];
+    up[2] = side[0] * forward[1] - side[1] * forward[0];
+    float view[16] = { side[0], up[0], -forward[0], 0, side[1], up[1], -forward[1], 0, side[2], up[2], -forward[2], 0, 0, 0, 0, 1 };
+    memcpy(scene.view, view, sizeof(view));
+
+    float viewProjection[16];
+    multiply(scene.projection, scene.view, viewProjection);
+    cullCylinder(scene.mesh, frustumFrom(viewProjection), scene.visible);
+}
+
+//draws the tiles left after culling, one strip each out of the one vertex array
+static void drawCylinder(const CylinderScene &scene, const vector<GLuint> &tiles)
+{
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadMatrixf(scene.projection);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadMatrixf(scene.view);
+
+    glEnable(GL_TEXTURE_2D);
+    glColor4f(1, 1, 1, 1);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, &scene.mesh.vertices[0]);
+    glTexCoordPointer(2, GL_FLOAT, 0, &scene.mesh.coords[0]);
+    for (size_t v = 0; v < scene.visible.size(); v++){
+        int s = scene.visible[v];
+        glBindTexture(GL_TEXTURE_2D, tiles[scene.mesh.tiles[s]]);
+        glDrawArrays(GL_TRIANGLE_STRIP, scene.mesh.first[s], scene.mesh.count[s]);
+    }
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glDisable(GL_TEXTURE_2D);
+
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+}
+
+//where a point on the cylinder is in the window (false if it is behind the camera)
+static bool project(const CylinderScene &scene, const float point[3], float &x, float &y)
+{
+    float viewProjection[16];
+    multiply(scene.projection, scene.view, viewProjection);
+    float clip[4];
+    for (int r = 0; r < 4; r++){
+        clip[r] = viewProjection[r] * point[0] + viewProjection[4 + r] * point[1] + viewProjection[8 + r] * point[2] + viewProjection[12 + r];
+    }
+    if (clip[3] <= 0.0f){
+        return false;
+    }
+    x = (clip[0] / clip[3] + 1.0f) / 2.0f * WINDOW_WIDTH;
+    y = (1.0f - clip[1] / clip[3]) / 2.0f * WINDOW_HEIGHT;
+    return true;
+}
+
+//draws a DrawList the way GhostsApp::drawCanopy() does, with plain quads for textures and text it doesn't have
+//with a cylinder scene the tiles are drawn on the cylinder and the indicators where it puts them
+static void drawList(const DrawList &list, const CanopyGrid &grid, const CanopyPose &pose, const vector<GLuint> &tiles, const CylinderScene *cylinder)
+{
+    glClearColor(0, 0, 0, 1);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glDisable(GL_BLEND);
+    if (cylinder){
+        drawCylinder(*cylinder, tiles);
+    }
+
+    bool onCanvas = false;
+    for (size_t i = 0; i < list.size(); i++){
+        const DrawItem &item = list[i];
+
+        if (cylinder && item.kind == DrawItem::TILE){
+            continue;
+        }
+        if (cylinder && item.kind == DrawItem::INDICATOR){
+            float point[3], x, y;
+            cylinderItemPoint(cylinder->mesh, list, grid, pose, item, point);
+            if (project(*cylinder, point, x, y)){
+                glPushMatrix();
+                glTranslatef(x, y, 0.0f);
+                glRotatef(90 - list.pitch, 0.0, 0.0, 1.0);
+                glColor4f(item.texture ? 0.2f : 1.0f, item.texture ? 1.0f : 0.8f, 0.2f, 1);
+                rect(0, 0, 50, 50);
+                glPopMatrix();
+            }
+            continue;
+        }
+
+        //tiles and indicators move with the canvas
+        if (item.onCanvas() != onCanvas){
+            onCanvas = item.onCanvas();
+            if (onCanvas){
+                glPushMatrix();
+                glRotatef(90 - list.pitch, 0.0, 0.0, 1.0);
+                glTranslatef(list.canvasX, list.canvasY, 0.0f);
+            }
+            else{
+                glPopMatrix();
+            }
+        }
+
+        switch (item.kind){
+            case DrawItem::TILE:
+                texturedRect(tiles[liveTile(grid, pose, item.texture)], item.x, item.y, item.x + item.width, item.y + item.height);
+                break;
+
+            case DrawItem::INDICATOR:
+                glColor4f(item.texture ? 0.2f : 1.0f, item.texture ? 1.0f : 0.8f, 0.2f, 1);
+                rect(item.x, item.y, item.x + 50, item.y + 50);
+                break;
+
+            case DrawItem::SCANNING:
+                label(item.x, item.y, 280, 55, 1, 1, 1);
+                break;
+
+            case DrawItem::BUTTON:
+                glColor4f(0.3f + 0.15f * item.texture, 0.3f, 0.3f, 1);
+                rect(item.x, item.y, item.x + item.width, item.y + item.height);
+                break;
+
+            case DrawItem::SCAN_BOX:
+                glColor4f(1, 1, 1, 1);
+                glBegin(GL_LINE_LOOP);
+                glVertex2f(item.x, item.y + item.height);
+                glVertex2f(item.x, item.y);
+                glVertex2f(item.x + item.width, item.y);
+                glVertex2f(item.x + item.width, item.y + item.height);
+                glEnd();
+                break;
+
+            case DrawItem::TOO_LOW:
+                glClear(GL_COLOR_BUFFER_BIT);
+                label(item.x, item.y, 600, 90, 0, 0, 1);
+                break;
+
+            case DrawItem::TOO_HIGH:
+                glClear(GL_COLOR_BUFFER_BIT);
+                label(item.x, item.y, 700, 90, 1, 0, 0);
+                break;
+
+            case DrawItem::OVERLAY:
+                //the description box to the right of the object
+                glEnable(GL_BLEND);
+                glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+                glPushMatrix();
+                glTranslatef(item.x, item.y, 0.0f);
+                glRotatef(90, 0, 0, 1);
+                glColor4f(0, 0, 0, 0.5f);
+                rect(150, -100, 530, 100);
+                glPopMatrix();
+                break;
+
+            case DrawItem::ARROW:
+                glPushMatrix();
+                glTranslatef(item.x, item.y, 0.0);
+                glRotatef(item.angle, 0.0, 0.0, 1.0);
+                glColor4f(1, 1, 1, 1);
+                glBegin(GL_TRIANGLE_FAN);
+                glVertex2f(0, 0);
+                for (int s = 0; s <= 4; s++){
+                    glVertex2f(20.0f * cosf(s * 1.5708f), 20.0f * sinf(s * 1.5708f));
+                }
+                glEnd();
+                glPopMatrix();
+                break;
+        }
+    }
+    if (onCanvas){
+        glPopMatrix();
+    }
+}
+
+static Image readFrame()
+{
+    Image frame;
+    frame.width = WINDOW_WIDTH;
+    frame.height = WINDOW_HEIGHT;
+    frame.rgb.resize((size_t)frame.width * frame.height * 3);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, frame.width, frame.height, GL_RGB, GL_UNSIGNED_BYTE, &frame.rgb[0]);
+
+    //GL reads bottom up
+    size_t row = frame.width * 3;
+    vector<unsigned char> swap(row);
+    for (int y = 0; y < frame.height / 2; y++){
+        unsigned char *a = &frame.rgb[y * row];
+        unsigned char *b = &frame.rgb[(frame.height - 1 - y) * row];
+        memcpy(&swap[0], a, row);
+        memcpy(a, b, row);
+        memcpy(b, &swap[0], row);
+    }
+    return frame;
+}
+
+//share of pixels with a channel more than tolerance away from the golden frame (1 if the sizes differ)
+static double compareFrames(const Image &frame, const Image &golden, int tolerance)
+{
+    if (frame.width != golden.width || frame.height != golden.height){
+        return 1.0;
+    }
+    size_t differing = 0;
+    for (size_t p = 0; p < frame.rgb.size(); p += 3){
+        for (int c = 0; c < 3; c++){
+            if (abs(frame.rgb[p + c] - golden.rgb[p + c]) > tolerance){
+                differing++;
+                break;
+            }
+        }
+    }
+    return differing / (double)(frame.width * frame.height);
+}
+
+static bool startGl()
+{
+    EGLDisplay display = EGL_NO_DISPLAY;
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay){
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, 0);
+    }
+    if (display == EGL_NO_DISPLAY){
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)){
+        fprintf(stderr, "couldn't open an EGL display\n");
+        return false;
+    }
+    if (!eglBindAPI(EGL_OPENGL_API)){
+        fprintf(stderr, "EGL has no desktop OpenGL\n");
+        return false;
+    }
+
+    EGLint attributes[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+    EGLConfig config = 0;
+    EGLint configs = 0;
+    eglChooseConfig(display, attributes, &config, 1, &configs);
+    EGLContext context = eglCreateContext(display, configs > 0 ? config : (EGLConfig)0, EGL_NO_CONTEXT, 0);
+    if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)){
+        fprintf(stderr, "couldn't make a surfaceless OpenGL context (EGL 0x%x)\n", eglGetError());
+        return false;
+    }
+
+    //everything is drawn into a framebuffer object the size of the app's screen
+    GLuint framebuffer, color;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glGenRenderbuffers(1, &color);
+    glBindRenderbuffer(GL_RENDERBUFFER, color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, WINDOW_WIDTH, WINDOW_HEIGHT);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE){
+        fprintf(stderr, "couldn't make the framebuffer\n");
+        return false;
+    }
+
+    //the same window matrices as gl::setMatricesWindow(): pixels, origin at the top left
+    glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    glOrtho(0, WINDOW_WIDTH, WINDOW_HEIGHT, 0, -1, 1);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+
+    printf("renderer: %s (OpenGL %s)\n", (const char *)glGetString(GL_RENDERER), (const char *)glGetString(GL_VERSION));
+    return true;
+}
+
+static double percentile(vector<double> values, double share)
+{
+    if (values.empty()){
+        return 0.0;
+    }
+    sort(values.begin(), values.end());
+    return values[min(values.size() - 1, (size_t)(share * values.size()))];
+}
+
+static void report(const char *name, const vector<double> &seconds)
+{
+    double total = 0.0;
+    for (size_t i = 0; i < seconds.size(); i++){
+        total += seconds[i];
+    }
+    printf("%-6s mean %8.3f ms  p50 %8.3f ms  p95 %8.3f ms  max %8.3f ms\n", name,
+           seconds.empty() ? 0.0 : total / seconds.size() * 1000.0, percentile(seconds, 0.5) * 1000.0,
+           percentile(seconds, 0.95) * 1000.0, percentile(seconds, 1.0) * 1000.0);
+}
+
+int main(int argc, char **argv)
+{
+    int frames = 600;
+    int width = 8000;
+    int height = 1024;
+    int projections = 20;
+    int every = 1;
+    int tolerance = 2;
+    double maxDiff = 0.001;
+    int format = -1;
+    bool cylinder = false;
+    string orientationsPath, panoramaPath, outDir, goldenDir;
+
+    for (int i = 1; i < argc; i++){
+        string arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : "";
+        if (arg == "--frames") { frames = atoi(value); i++; }
+        else if (arg == "--orientations") { orientationsPath = value; i++; }
+        else if (arg == "--panorama") { panoramaPath = value; i++; }
+        else if (arg == "--width") { width = atoi(value); i++; }
+        else if (arg == "--height") { height = atoi(value); i++; }
+        else if (arg == "--projections") { projections = atoi(value); i++; }
+        else if (arg == "--out") { outDir = value; i++; }
+        else if (arg == "--every") { every = max(1, atoi(value)); i++; }
+        else if (arg == "--golden") { goldenDir = value; i++; }
+        else if (arg == "--tolerance") { tolerance = atoi(value); i++; }
+        else if (arg == "--max-diff") { maxDiff = atof(value); i++; }
+        else if (arg == "--cylinder") { cylinder = true; }
+        else if (arg == "--format"){
+            string name = value;
+            i++;
+            if (name == "rgb") format = -1;
+            else if (name == "rgba") format = PIXELS_RGBA;
+            else if (name == "rgb565") format = PIXELS_RGB565;
+            else if (name == "l8") format = PIXELS_L8;
+            else if (name == "etc1") format = PIXELS_ETC1;
+            else{
+                fprintf(stderr, "unknown format %s\n", value);
+                return 2;
+            }
+        }
+        else{
+            fprintf(stderr, "unknown option %s (see the top of headless_render.cpp)\n", arg.c_str());
+            return 2;
+        }
+    }
+
+    //orientations as rotated() gets them: pitch, yaw, roll
+    vector<float> readings;
+    bool sweep = false;
+    if (!orientationsPath.empty()){
+        FILE *file = fopen(orientationsPath.c_str(), "r");
+        if (!file){
+            fprintf(stderr, "couldn't open %s\n", orientationsPath.c_str());
+            return 2;
+        }
+        float x, y, z;
+        while (fscanf(file, "%f %f %f", &x, &y, &z) == 3){
+            readings.push_back(x);
+            readings.push_back(y);
+            readings.push_back(z);
+        }
+        fclose(file);
+        frames = readings.size() / 3;
+    }
+    else{
+        sweep = true;
+    }
+
+    Image panorama;
+    if (!panoramaPath.empty()){
+        if (!readPpm(panoramaPath, panorama)){
+            fprintf(stderr, "couldn't read %s (binary PPM expected)\n", panoramaPath.c_str());
+            return 2;
+        }
+    }
+    else{
+        panorama = generatePanorama(width, height);
+    }
+
+    if (!startGl()){
+        return 2;
+    }
+    if (format == PIXELS_ETC1 && !hasGlExtension((const char *)glGetString(GL_EXTENSIONS), "GL_OES_compressed_ETC1_RGB8_texture")){
+        fprintf(stderr, "this GL doesn't take ETC1 textures\n");
+        return 2;
+    }
+
+    CanopyGrid grid;
+    grid.tileWidth = TILE_WIDTH;
+    grid.tileHeight = TILE_HEIGHT;
+    grid.screenWidth = SCREEN_WIDTH;
+    grid.screenHeight = SCREEN_HEIGHT;
+    grid.screenRows = (int)ceil(SCREEN_HEIGHT / (float)TILE_HEIGHT) + 2;
+    grid.screenCols = (int)ceil(SCREEN_WIDTH / (float)TILE_WIDTH) + 2;
+    double uploadStart = now();
+    size_t tileBytes;
+    vector<GLuint> tiles = uploadTiles(panorama, grid, format, tileBytes);
+    glFinish();
+    printf("panorama %dx%d, %d tiles as %s (%.1f MB) packed and uploaded in %.1f ms\n", panorama.width, panorama.height, (int)tiles.size(),
+           format < 0 ? "RGB" : pixelFormatName((PixelFormat)format), tileBytes / 1048576.0, (now() - uploadStart) * 1000.0);
+
+    CylinderScene scene;
+    if (cylinder){
+        buildCylinderMesh(scene.mesh, canopyTileAreas(panorama.width, panorama.height, TILE_WIDTH, TILE_HEIGHT), grid.ghostRows * (1024 / TILE_WIDTH),
+                          panorama.width, panorama.height);
+    }
+    size_t culledTiles = 0;
+
+    //turns once around the canopy, nodding across the panorama's height and tilting a little
+    if (sweep){
+        for (int f = 0; f < frames; f++){
+            float t = f / (float)max(1, frames);
+            float yaw = fmodf(t * 6.2832f + 3.1416f, 6.2832f) - 3.1416f;
+            float yOffset = -max(0, panorama.height - SCREEN_HEIGHT) * (0.5f + 0.5f * sinf(t * 18.85f));
+            readings.push_back(0.05f * sinf(t * 12.566f));
+            readings.push_back(yaw);
+            readings.push_back(-(yOffset + 1200.0f) / grid.ghostWidth * 6.2832f - 1.5708f);
+        }
+    }
+
+    //data objects placed as the app places them, objects past the seam also at the beginning of the canvas
+    srand(7);
+    vector<int> offX, offY, copiedBy, data;
+    for (int p = 0; p < projections; p++){
+        int x = rand() % panorama.width + 1024;
+        int y = rand() % max(1, panorama.height - 100);
+        if (x >= panorama.width){
+            offX.push_back(x); offY.push_back(y); copiedBy.push_back(offX.size()); data.push_back(p);
+            offX.push_back(x - panorama.width); offY.push_back(y); copiedBy.push_back(-2); data.push_back(p);
+        }
+        else{
+            offX.push_back(x); offY.push_back(y); copiedBy.push_back(-1); data.push_back(p);
+        }
+    }
+    int count = offX.size();
+    DirectionIndex directions;
+    if (count > 0){
+        directions.build(&offX[0], &offY[0], &copiedBy[0], count, grid.ghostWidth - 1024);
+    }
+    vector<unsigned char> visible(count + 1), inBox(count + 1);
+
+    YawTracker yawTracker;
+    DrawList list;
+    int scanned = -1;
+    int displayed = -1;
+    float scanStarted = -1.0f;
+    vector<double> buildTimes, drawTimes;
+    unsigned sequenceHash = 2166136261u;
+    int written = 0;
+    int compared = 0;
+    int failed = 0;
+
+    for (int f = 0; f < frames; f++){
+        double start = now();
+
+        //the view step, as GhostsApp::stepView() does it
+        float pitch = readings[f * 3];
+        float yaw = yawTracker.follow(readings[f * 3 + 1]);
+        float roll = readings[f * 3 + 2];
+        CanopyPose pose = poseFor(grid, yaw, roll, pitch);
+
+        ScanView view;
+        view.pixelXOffset = pose.xOffset;
+        view.pixelYOffset = pose.yOffset;
+        view.screenWidth = SCREEN_WIDTH;
+        view.screenHeight = SCREEN_HEIGHT;
+        view.centerX = -(pose.xOffset - SCREEN_WIDTH / 2);
+        view.centerY = -(pose.yOffset - SCREEN_HEIGHT / 2);
+        view.xHalfRange = 150.0f;
+        view.yHalfRange = 100.0f;
+        view.xBoxShift = 15.0f;
+        view.yBoxShift = 30.0f;
+        ScanResult scan;
+        scan.visibleCount = 0;
+        scan.nearest = -1;
+        if (count > 0){
+            scan = scanProjections(&offX[0], &offY[0], count, view, &visible[0], &inBox[0]);
+        }
+
+        //the scan timer, on the same fixed frame time every run
+        float time = f * FRAME_SECONDS;
+        bool showScanning = false;
+        if (scan.visibleCount > 0){
+            if (scan.nearest == -1 || (scanned != -1 && !inBox[scanned])){
+                scanned = -1;
+                displayed = -1;
+                scanStarted = -1.0f;
+            }
+            if (scan.nearest != -1){
+                scanned = scan.nearest;
+                if (scanStarted == -1.0f){
+                    scanStarted = time;
+                }
+                else if (time - scanStarted > SCAN_TIME){
+                    displayed = scanned;
+                }
+                else{
+                    showScanning = true;
+                }
+            }
+        }
+
+        CanopyOverlays overlays;
+        overlays.offX = count > 0 ? &offX[0] : 0;
+        overlays.offY = count > 0 ? &offY[0] : 0;
+        overlays.data = count > 0 ? &data[0] : 0;
+        overlays.visible = &visible[0];
+        overlays.count = count;
+        overlays.objectScanned = scanned;
+        overlays.displayedObject = displayed;
+        overlays.showScanning = showScanning;
+        overlays.showButtons = false;
+        overlays.paused = false;
+        overlays.showScanBox = showScanning;
+        overlays.scannerX = 300;
+        overlays.scannerY = 200;
+        directions.count(pose.xOffset, pose.yOffset, grid.ghostWidth / 3, SCREEN_WIDTH, SCREEN_HEIGHT,
+                         overlays.top, overlays.bottom, overlays.left, overlays.right);
+        buildCanopyDrawList(list, grid, pose, overlays);
+        if (cylinder){
+            aimCylinder(scene, grid, pose);
+            culledTiles += scene.mesh.tiles.size() - scene.visible.size();
+        }
+        buildTimes.push_back(now() - start);
+
+        start = now();
+        drawList(list, grid, pose, tiles, cylinder ? &scene : 0);
+        glFinish();
+        drawTimes.push_back(now() - start);
+
+        unsigned frameHash = list.hash();
+        sequenceHash = (sequenceHash ^ frameHash) * 16777619u;
+
+        if (f % every != 0 || (outDir.empty() && goldenDir.empty())){
+            continue;
+        }
+        char name[32];
+        snprintf(name, sizeof(name), "frame_%04d.ppm", f);
+        Image frame = readFrame();
+        if (!outDir.empty()){
+            if (!writePpm(outDir + "/" + name, frame)){
+                fprintf(stderr, "couldn't write %s/%s\n", outDir.c_str(), name);
+                return 2;
+            }
+            written++;
+        }
+        if (!goldenDir.empty()){
+            Image golden;
+            if (!readPpm(goldenDir + "/" + name, golden)){
+                printf("%s: no golden frame\n", name);
+                failed++;
+                continue;
+            }
+            double diff = compareFrames(frame, golden, tolerance);
+            compared++;
+            if (diff > maxDiff){
+                printf("%s: %.4f%% of pixels differ\n", name, diff * 100.0);
+                failed++;
+            }
+        }
+    }
+
+    printf("frames %d, draw list hash %08x\n", frames, sequenceHash);
+    report("build", buildTimes);
+    report("draw", drawTimes);
+    if (cylinder){
+        printf("cylinder: %d tiles, %.1f culled a frame on average\n", (int)scene.mesh.tiles.size(), culledTiles / (double)max(1, frames));
+    }
+    if (written > 0){
+        printf("wrote %d frames to %s\n", written, outDir.c_str());
+    }
+    if (!goldenDir.empty()){
+        printf("compared %d frames with %s: %d failed\n", compared, goldenDir.c_str(), failed);
+    }
+    return failed == 0 ? 0 : 1;
+}
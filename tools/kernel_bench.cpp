@@ -0,0 +1,94 @@
+//Benchmarks the vectorized projection scan against the scalar version and checks they agree
+//
+//Build and run from the repository root:
+//  c++ -O2 -I src tools/kernel_bench.cpp -o kernel_bench && ./kernel_bench [projections] [frames]
+
+#include "ProjectionKernels.h"
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+using namespace std;
+
+static double now()
+{
+    timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+int main(int argc, char **argv)
+{
+    int count = argc > 1 ? atoi(argv[1]) : 500;
+    int frames = argc > 2 ? atoi(argv[2]) : 20000;
+    int ghostWidth = 20000;
+    int ghostHeight = 2048;
+
+    //a canopy with objects spread over the whole canvas
+    srand(7);
+    vector<int> offX(count);
+    vector<int> offY(count);
+    for (int i = 0; i < count; i++){
+        offX[i] = rand() % ghostWidth;
+        offY[i] = rand() % ghostHeight;
+    }
+
+    vector<unsigned char> visible(count), inBox(count);
+    vector<unsigned char> visibleRef(count), inBoxRef(count);
+
+    //views sweeping around the canopy, the same sequence for both versions
+    vector<ScanView> views(frames);
+    for (int f = 0; f < frames; f++){
+        ScanView &view = views[f];
+        view.pixelXOffset = -(float)((f * 37) % (ghostWidth - 1024));
+        view.pixelYOffset = (float)(768 + (f * 13) % (ghostHeight - 768));
+        view.screenWidth = 1024.0f;
+        view.screenHeight = 768.0f;
+        view.centerX = -(view.pixelXOffset - 512.0f);
+        view.centerY = -(view.pixelYOffset - 384.0f);
+        view.xHalfRange = 150.0f;
+        view.yHalfRange = 100.0f;
+        view.xBoxShift = 15.0f;
+        view.yBoxShift = 30.0f;
+    }
+
+    //both versions have to find the same objects
+    int mismatches = 0;
+    for (int f = 0; f < frames; f++){
+        ScanResult a = scanProjectionsScalar(&offX[0], &offY[0], count, views[f], &visibleRef[0], &inBoxRef[0]);
+        ScanResult b = scanProjections(&offX[0], &offY[0], count, views[f], &visible[0], &inBox[0]);
+        if (a.visibleCount != b.visibleCount || a.nearest != b.nearest || visible != visibleRef || inBox != inBoxRef){
+            mismatches++;
+        }
+    }
+
+    long checksum = 0;
+    double start = now();
+    for (int f = 0; f < frames; f++){
+        ScanResult r = scanProjectionsScalar(&offX[0], &offY[0], count, views[f], &visibleRef[0], &inBoxRef[0]);
+        checksum += r.visibleCount + r.nearest;
+    }
+    double scalarTime = now() - start;
+
+    start = now();
+    for (int f = 0; f < frames; f++){
+        ScanResult r = scanProjections(&offX[0], &offY[0], count, views[f], &visible[0], &inBox[0]);
+        checksum -= r.visibleCount + r.nearest;
+    }
+    double simdTime = now() - start;
+
+#if GHOSTS_SIMD_NEON
+    const char *kernel = "neon";
+#elif GHOSTS_SIMD_SSE
+    const char *kernel = "sse2";
+#else
+    const char *kernel = "scalar";
+#endif
+
+    printf("projections %d, frames %d, kernel %s\n", count, frames, kernel);
+    printf("scalar: %8.3f us/frame\n", scalarTime / frames * 1000000.0);
+    printf("simd:   %8.3f us/frame (%.2fx)\n", simdTime / frames * 1000000.0, scalarTime / simdTime);
+    printf("mismatched frames: %d (checksum %ld)\n", mismatches, checksum);
+    return mismatches == 0 && checksum == 0 ? 0 : 1;
+}
@@ -0,0 +1,567 @@
+//Local stand-in for the ghosts.slifty.com canopy services, serving synthetic canopies
+//
+//Serves the same four services the app uses under /services/:
+//  getCanopyList.php, getCanopyInformation.php?c=, getCanopyImage.php?c=&h=&w=, getPortalImage.php?p=
+//so a load can be timed reproducibly with a known canopy size, projection count, latency and bandwidth.
+//
+//Build from the repository root (add -DSTANDIN_WITH_LIBJPEG -ljpeg to serve JPEGs instead of BMPs):
+//  c++ -O2 -I src tools/standin_server.cpp -o standin_server -lpthread
+//
+//Then set SERVICES_URL in GhostsApp.cpp to "http://<this machine>:8080/services/" and BENCHMARK_RUNS
+//to the number of loads to time; the app logs each stage of every load and the totals.
+//
+//Options:
+//  --port N             port to listen on (8080)
+//  --canopies N         canopies listed (3)
+//  --width N            panorama width in pixels (8000)
+//  --height N           panorama height in pixels (1024)
+//  --projections N      projections per canopy (20)
+//  --portal WxH         portal image size (400x300)
+//  --latency MS         delay before every response (0)
+//  --bandwidth KBPS     per-connection bandwidth limit in kilobytes per second (0 is unlimited)
+//  --quality Q          JPEG quality when built with libjpeg (85)
+//  --edit-every S       edits one projection's caption every S seconds, as a curator would (0 never does)
+//
+//Responses carry an ETag and a matching If-None-Match gets "304 Not Modified"; the canopy information
+//gives each projection a <hash> of its text and an <imageHash> of its portal image.
+
+#include "DiskCache.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#ifdef STANDIN_WITH_LIBJPEG
+#include <jpeglib.h>
+#endif
+
+using namespace std;
+
+struct Config {
+    int port;
+    int canopies;
+    int width;
+    int height;
+    int projections;
+    int portalWidth;
+    int portalHeight;
+    int latencyMs;
+    int bandwidthKBps;
+    int quality;
+    int editSeconds;
+};
+
+static Config config;
+static double startTime;
+static pthread_mutex_t logMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static double now()
+{
+    timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+//-------------------------------------------------------------------------------------------------
+// Synthetic content
+
+//small deterministic generator so every request for the same canopy gives the same answer
+static unsigned nextRandom(unsigned &state)
+{
+    state = state * 1103515245 + 12345;
+    return (state >> 16) & 0x7fff;
+}
+
+static string words(unsigned &state, int length)
+{
+    static const char *vocabulary[] = { "the", "old", "market", "street", "was", "photographed", "here", "in", "1912",
+        "before", "fire", "tram", "line", "corner", "store", "families", "gathered", "each", "summer", "river" };
+    string text;
+    while ((int)text.size() < length){
+        if (!text.empty()){
+            text += " ";
+        }
+        text += vocabulary[nextRandom(state) % 20];
+    }
+    return text;
+}
+
+struct SyntheticProjection {
+    int id;
+    int offX;
+    int offY;
+    int width;
+    int height;
+    string description;
+    string caption;
+};
+
+static vector<SyntheticProjection> projectionsFor(int canopy)
+{
+    unsigned state = canopy * 7919 + 17;
+    vector<SyntheticProjection> result(config.projections);
+    for (int i = 0; i < config.projections; i++){
+        SyntheticProjection &p = result[i];
+        p.id = canopy * 1000 + i;
+        p.offX = nextRandom(state) * 4 % config.width;
+        p.offY = nextRandom(state) % max(1, config.height - 200);
+        bool hasImage = i % 5 != 4; //some objects only have text
+        p.width = hasImage ? config.portalWidth : 0;
+        p.height = hasImage ? config.portalHeight : 0;
+        p.description = words(state, 120 + nextRandom(state) % 300);
+        p.caption = words(state, 30 + nextRandom(state) % 60);
+    }
+
+    //each edit so far has changed the caption of the next projection round
+    int edits = config.editSeconds > 0 ? (int)((now() - startTime) / config.editSeconds) : 0;
+    for (int e = max(0, edits - config.projections); e < edits; e++){
+        ostringstream note;
+        note << " (edited " << e + 1 << ")";
+        result[e % config.projections].caption += note.str();
+    }
+    return result;
+}
+
+//one row of an image: a gradient with a grid, tinted per canopy/projection
+static void fillRow(int seed, int width, int height, int y, unsigned char *rgb)
+{
+    for (int x = 0; x < width; x++){
+        bool grid = x % 256 == 0 || y % 256 == 0;
+        rgb[x * 3 + 0] = grid ? 255 : (unsigned char)(x * 255 / max(1, width - 1));
+        rgb[x * 3 + 1] = grid ? 255 : (unsigned char)(y * 255 / max(1, height - 1));
+        rgb[x * 3 + 2] = grid ? 255 : (unsigned char)(seed * 53 + (x ^ y) % 64);
+    }
+}
+
+#ifndef STANDIN_WITH_LIBJPEG
+static void put16(string &s, int v)
+{
+    s += (char)(v & 0xff);
+    s += (char)((v >> 8) & 0xff);
+}
+
+static void put32(string &s, unsigned v)
+{
+    put16(s, v & 0xffff);
+    put16(s, v >> 16);
+}
+#endif
+
+#ifndef STANDIN_WITH_LIBJPEG
+static string encodeBmp(int seed, int width, int height)
+{
+    int rowBytes = (width * 3 + 3) & ~3;
+    string out;
+    out.reserve(54 + rowBytes * height);
+    out += "BM";
+    put32(out, 54 + rowBytes * height);
+    put32(out, 0);
+    put32(out, 54);
+    put32(out, 40);
+    put32(out, width);
+    put32(out, height);
+    put16(out, 1);
+    put16(out, 24);
+    put32(out, 0);
+    put32(out, rowBytes * height);
+    put32(out, 2835);
+    put32(out, 2835);
+    put32(out, 0);
+    put32(out, 0);
+
+    vector<unsigned char> row(rowBytes, 0);
+    for (int y = height - 1; y >= 0; y--){ //bottom-up, BGR
+        fillRow(seed, width, height, y, &row[0]);
+        for (int x = 0; x < width; x++){
+            swap(row[x * 3], row[x * 3 + 2]);
+        }
+        out.append((const char *)&row[0], rowBytes);
+    }
+    return out;
+}
+#endif
+
+#ifdef STANDIN_WITH_LIBJPEG
+static string encodeJpeg(int seed, int width, int height)
+{
+    jpeg_compress_struct cinfo;
+    jpeg_error_mgr jerr;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+
+    unsigned char *buffer = 0;
+    unsigned long size = 0;
+    jpeg_mem_dest(&cinfo, &buffer, &size);
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, config.quality, TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+
+    vector<unsigned char> row(width * 3);
+    while (cinfo.next_scanline < cinfo.image_height){
+        fillRow(seed, width, height, cinfo.next_scanline, &row[0]);
+        JSAMPROW rows[1] = { &row[0] };
+        jpeg_write_scanlines(&cinfo, rows, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+
+    string out((const char *)buffer, size);
+    free(buffer);
+    return out;
+}
+#endif
+
+//images are generated once and kept, so repeated loads measure the app rather than the generator
+static string image(int seed, int width, int height, string &contentType)
+{
+    static map<string, string> cache;
+    static pthread_mutex_t cacheMutex = PTHREAD_MUTEX_INITIALIZER;
+
+    ostringstream key;
+    key << seed << "/" << width << "x" << height;
+
+    pthread_mutex_lock(&cacheMutex);
+    map<string, string>::iterator found = cache.find(key.str());
+    if (found != cache.end()){
+        string result = found->second;
+        pthread_mutex_unlock(&cacheMutex);
+#ifdef STANDIN_WITH_LIBJPEG
+        contentType = "image/jpeg";
+#else
+        contentType = "image/bmp";
+#endif
+        return result;
+    }
+    pthread_mutex_unlock(&cacheMutex);
+
+#ifdef STANDIN_WITH_LIBJPEG
+    string encoded = encodeJpeg(seed, width, height);
+    contentType = "image/jpeg";
+#else
+    string encoded = encodeBmp(seed, width, height);
+    contentType = "image/bmp";
+#endif
+
+    pthread_mutex_lock(&cacheMutex);
+    cache[key.str()] = encoded;
+    pthread_mutex_unlock(&cacheMutex);
+    return encoded;
+}
+
+static string xmlEscape(const string &text)
+{
+    string out;
+    for (size_t i = 0; i < text.size(); i++){
+        switch (text[i]){
+            case '&': out += "&amp;"; break;
+            case '<': out += "&lt;"; break;
+            case '>': out += "&gt;"; break;
+            default: out += text[i];
+        }
+    }
+    return out;
+}
+
+static string canopyList()
+{
+    ostringstream xml;
+    xml << "<?xml version=\"1.0\"?>\n<canopies>\n";
+    for (int c = 1; c <= config.canopies; c++){
+        xml << "  <canopy><id>" << c << "</id><name>Synthetic canopy " << c << " (" << config.width << "x"
+            << config.height << ", " << config.projections << " projections)</name></canopy>\n";
+    }
+    xml << "</canopies>\n";
+    return xml.str();
+}
+
+static string canopyInformation(int canopy)
+{
+    vector<SyntheticProjection> projections = projectionsFor(canopy);
+    ostringstream xml;
+    xml << "<?xml version=\"1.0\"?>\n<canopy>\n  <id>" << canopy << "</id>\n  <height>" << config.height
+        << "</height>\n  <width>" << config.width << "</width>\n  <projections>\n";
+    for (size_t i = 0; i < projections.size(); i++){
+        const SyntheticProjection &p = projections[i];
+        ostringstream imageKey;
+        imageKey << p.id << "/" << config.portalWidth << "x" << config.portalHeight;
+        xml << "    <projection><id>" << p.id << "</id><offX>" << p.offX << "</offX><offY>" << p.offY
+            << "</offY><height>" << p.height << "</height><width>" << p.width << "</width><hash>"
+            << DiskCache::hash(p.description + '\0' + (p.width != 0 ? p.caption : string(" "))) << "</hash><imageHash>"
+            << DiskCache::hash(imageKey.str()) << "</imageHash><description>"
+            << xmlEscape(p.description) << "</description><caption>" << xmlEscape(p.caption) << "</caption></projection>\n";
+    }
+    xml << "  </projections>\n</canopy>\n";
+    return xml.str();
+}
+
+//-------------------------------------------------------------------------------------------------
+// HTTP
+
+static int queryInt(const string &query, const string &name, int fallback)
+{
+    string key = name + "=";
+    size_t start = 0;
+    while (start < query.size()){
+        size_t end = query.find('&', start);
+        if (end == string::npos){
+            end = query.size();
+        }
+        if (query.compare(start, key.size(), key) == 0){
+            return atoi(query.substr(start + key.size(), end - start - key.size()).c_str());
+        }
+        start = end + 1;
+    }
+    return fallback;
+}
+
+static bool sendAll(int fd, const char *data, size_t size)
+{
+    //the bandwidth limit is applied in 50ms slices
+    size_t slice = config.bandwidthKBps > 0 ? max(1, config.bandwidthKBps * 1024 / 20) : size;
+    while (size > 0){
+        double start = now();
+        size_t chunk = min(slice, size);
+        size_t sent = 0;
+        while (sent < chunk){
+            ssize_t n = send(fd, data + sent, chunk - sent, MSG_NOSIGNAL);
+            if (n <= 0){
+                if (n < 0 && errno == EINTR){
+                    continue;
+                }
+                return false;
+            }
+            sent += n;
+        }
+        data += chunk;
+        size -= chunk;
+        if (config.bandwidthKBps > 0 && size > 0){
+            double wait = 0.05 - (now() - start);
+            if (wait > 0){
+                usleep((useconds_t)(wait * 1000000.0));
+            }
+        }
+    }
+    return true;
+}
+
+static bool respond(int fd, int status, const string &contentType, const string &body, const string &etag, bool keepAlive)
+{
+    ostringstream head;
+    head << "HTTP/1.1 " << status << (status == 200 ? " OK" : status == 304 ? " Not Modified" : " Not Found") << "\r\n"
+         << "Content-Type: " << contentType << "\r\n";
+    if (!etag.empty()){
+        head << "ETag: " << etag << "\r\n";
+    }
+    if (status != 304){
+        head << "Content-Length: " << body.size() << "\r\n";
+    }
+    head
+         << "Connection: " << (keepAlive ? "keep-alive" : "close") << "\r\n\r\n";
+    string headText = head.str();
+    return sendAll(fd, headText.data(), headText.size()) && sendAll(fd, body.data(), body.size());
+}
+
+//the value of a request header, from headers already lowercased
+static string requestHeader(const string &headers, const string &name)
+{
+    size_t start = headers.find("\r\n" + name + ":");
+    if (start == string::npos){
+        return "";
+    }
+    start += name.size() + 3;
+    size_t end = headers.find("\r\n", start);
+    string value = headers.substr(start, end == string::npos ? string::npos : end - start);
+    size_t first = value.find_first_not_of(" \t");
+    return first == string::npos ? "" : value.substr(first);
+}
+
+static bool handle(int fd, const string &method, const string &target, const string &headers, bool keepAlive)
+{
+    double start = now();
+    string path = target;
+    string query;
+    size_t q = target.find('?');
+    if (q != string::npos){
+        path = target.substr(0, q);
+        query = target.substr(q + 1);
+    }
+
+    string contentType = "text/xml";
+    string body;
+    int status = 200;
+
+    if (path == "/services/getCanopyList.php"){
+        body = canopyList();
+    }
+    else if (path == "/services/getCanopyInformation.php"){
+        body = canopyInformation(queryInt(query, "c", 1));
+    }
+    else if (path == "/services/getCanopyImage.php"){
+        int w = min(queryInt(query, "w", config.width), config.width);
+        int h = min(queryInt(query, "h", config.height), config.height);
+        body = image(queryInt(query, "c", 1), max(1, w), max(1, h), contentType);
+    }
+    else if (path == "/services/getPortalImage.php"){
+        body = image(queryInt(query, "p", 0), config.portalWidth, config.portalHeight, contentType);
+    }
+    else{
+        status = 404;
+        contentType = "text/plain";
+        body = "not found\n";
+    }
+
+    if (config.latencyMs > 0){
+        usleep(config.latencyMs * 1000);
+    }
+    //unchanged content isn't sent again
+    string etag;
+    if (status == 200){
+        etag = "\"" + DiskCache::hash(body) + "\"";
+        if (requestHeader(headers, "if-none-match") == etag){
+            status = 304;
+        }
+    }
+    if (method == "HEAD" || status == 304){
+        body.clear();
+    }
+    bool ok = respond(fd, status, contentType, body, etag, keepAlive);
+
+    pthread_mutex_lock(&logMutex);
+    printf("%d %s %s %zu bytes %.1f ms\n", status, method.c_str(), target.c_str(), body.size(), (now() - start) * 1000.0);
+    fflush(stdout);
+    pthread_mutex_unlock(&logMutex);
+    return ok;
+}
+
+//serves requests on one connection until the client closes it or asks to
+static void *serveConnection(void *arg)
+{
+    int fd = (int)(long)arg;
+    string buffer;
+    char chunk[4096];
+
+    for (;;){
+        size_t end;
+        while ((end = buffer.find("\r\n\r\n")) == string::npos){
+            ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+            if (n <= 0){
+                close(fd);
+                return 0;
+            }
+            buffer.append(chunk, n);
+        }
+
+        string head = buffer.substr(0, end);
+        buffer.erase(0, end + 4);
+
+        istringstream lines(head);
+        string method, target, version;
+        lines >> method >> target >> version;
+
+        bool keepAlive = version == "HTTP/1.1";
+        string lowered = head;
+        for (size_t i = 0; i < lowered.size(); i++){
+            lowered[i] = tolower(lowered[i]);
+        }
+        if (lowered.find("connection: close") != string::npos){
+            keepAlive = false;
+        }
+        else if (lowered.find("connection: keep-alive") != string::npos){
+            keepAlive = true;
+        }
+
+        if (!handle(fd, method, target, lowered, keepAlive) || !keepAlive){
+            break;
+        }
+    }
+    close(fd);
+    return 0;
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: standin_server [--port N] [--canopies N] [--width N] [--height N] [--projections N]\n"
+                    "                      [--portal WxH] [--latency MS] [--bandwidth KBPS] [--quality Q] [--edit-every S]\n");
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    config.port = 8080;
+    config.canopies = 3;
+    config.width = 8000;
+    config.height = 1024;
+    config.projections = 20;
+    config.portalWidth = 400;
+    config.portalHeight = 300;
+    config.latencyMs = 0;
+    config.bandwidthKBps = 0;
+    config.quality = 85;
+    config.editSeconds = 0;
+    startTime = now();
+
+    for (int i = 1; i < argc; i++){
+        string arg = argv[i];
+        if (i + 1 >= argc){
+            usage();
+        }
+        string value = argv[++i];
+        if (arg == "--port") config.port = atoi(value.c_str());
+        else if (arg == "--canopies") config.canopies = atoi(value.c_str());
+        else if (arg == "--width") config.width = atoi(value.c_str());
+        else if (arg == "--height") config.height = atoi(value.c_str());
+        else if (arg == "--projections") config.projections = atoi(value.c_str());
+        else if (arg == "--portal") sscanf(value.c_str(), "%dx%d", &config.portalWidth, &config.portalHeight);
+        else if (arg == "--latency") config.latencyMs = atoi(value.c_str());
+        else if (arg == "--bandwidth") config.bandwidthKBps = atoi(value.c_str());
+        else if (arg == "--quality") config.quality = atoi(value.c_str());
+        else if (arg == "--edit-every") config.editSeconds = atoi(value.c_str());
+        else usage();
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    int yes = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(config.port);
+    if (bind(listener, (sockaddr *)&address, sizeof(address)) != 0 || listen(listener, 64) != 0){
+        perror("standin_server");
+        return 1;
+    }
+
+    printf("serving %d canopies (%dx%d, %d projections) on port %d, latency %d ms, bandwidth %d KB/s (0 is unlimited)\n",
+           config.canopies, config.width, config.height, config.projections, config.port, config.latencyMs, config.bandwidthKBps);
+    fflush(stdout);
+
+    for (;;){
+        int fd = accept(listener, 0, 0);
+        if (fd < 0){
+            continue;
+        }
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+        pthread_t thread;
+        pthread_create(&thread, 0, serveConnection, (void *)(long)fd);
+        pthread_detach(thread);
+    }
+}